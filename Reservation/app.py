@@ -7,6 +7,7 @@ from reservation_logic import (
 )
 from reservation_logic import confirm_reservation
 from reservation_logic import is_raining
+import qr_token
 
 
 app = Flask(__name__)
@@ -18,6 +19,8 @@ CORS(app, resources={r"/*": {"origins": "*"}})
 @app.post("/reserve")
 def reserve():
     data = request.get_json(force=True)
+    if not isinstance(data, dict):
+        return jsonify({"error": "JSON object expected"}), 400
 
     block_id = data.get("block_id")
     user_type = data.get("user_type", "NORMAL")
@@ -25,7 +28,23 @@ def reserve():
     if not block_id:
         return jsonify({"error": "block_id missing"}), 400
 
+    # Checked before a spot is taken: both go into the QR token
+    user = data.get("user")
+    ttl_s = data.get("ttl_s")
+    if user is not None and not isinstance(user, str):
+        return jsonify({"error": "user must be a string"}), 400
+    if ttl_s is not None and (isinstance(ttl_s, bool) or not isinstance(ttl_s, int)):
+        return jsonify({"error": "ttl_s must be an integer (seconds)"}), 400
+
     result = find_best_spot(block_id, user_type)
+
+    # Signed gate QR (see qr_token.py); absent when no QR_KEYS are configured
+    if "spot_id" in result:
+        token, exp = qr_token.issue(result["spot_id"], user, ttl_s)
+        if token:
+            result["qr_token"] = token
+            result["qr_expires_at"] = exp
+
     return jsonify(result)
 
 # ============================================================
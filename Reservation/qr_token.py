@@ -0,0 +1,68 @@
+import base64
+import hashlib
+import hmac
+import os
+import time
+
+# ============================================================
+# Signed gate QR tokens (v2), verified by the ESP32 gate:
+#   OPK2|<kid>|<slot>|<exp>|<user>|<tag>
+# tag = base64url(HMAC-SHA256(key[kid], "OPK2|<kid>|<slot>|<exp>|<user>")[:16])
+# Layout must match esp32/components/optipark_core/include/qr.h
+# ============================================================
+PREFIX = "OPK2"
+TAG_LEN = 16
+USER_MAX_LEN = 32          # bytes; the gate LCD shows 16 chars anyway
+DEFAULT_TTL_S = 2 * 3600
+MAX_TTL_S = 6 * 3600
+
+
+def parse_keys(spec):
+    """'1:<64 hex>,2:<64 hex>' -> {1: bytes, 2: bytes}"""
+    keys = {}
+    for item in (spec or "").split(","):
+        item = item.strip()
+        if not item:
+            continue
+        kid, hexkey = item.split(":", 1)
+        kid = int(kid)
+        key = bytes.fromhex(hexkey.strip())
+        if not 0 <= kid <= 255 or len(key) != 32:
+            raise ValueError(f"QR key {kid}: need kid 0..255 and a 32-byte key")
+        keys[kid] = key
+    return keys
+
+
+# Keys are provisioned on the gates in NVS (namespace "qrkeys", blob "k<kid>").
+# Rotation: add the new key on every gate, then switch QR_ACTIVE_KID, then
+# remove the old key once the last token signed with it has expired.
+KEYS = parse_keys(os.environ.get("QR_KEYS", ""))
+ACTIVE_KID = int(os.environ.get("QR_ACTIVE_KID") or (max(KEYS) if KEYS else 0))
+
+
+def enabled():
+    return ACTIVE_KID in KEYS
+
+
+def _clean_user(user):
+    # '|' is the field separator; keep the payload short for the QR.
+    user = (user or "User").replace("|", "/").strip() or "User"
+    return user.encode("utf-8")[:USER_MAX_LEN].decode("utf-8", "ignore")
+
+
+def sign(slot_id, user, exp, kid=None, keys=None):
+    keys = KEYS if keys is None else keys
+    kid = ACTIVE_KID if kid is None else kid
+    body = f"{PREFIX}|{kid}|{slot_id}|{int(exp)}|{_clean_user(user)}"
+    mac = hmac.new(keys[kid], body.encode("utf-8"), hashlib.sha256).digest()[:TAG_LEN]
+    tag = base64.urlsafe_b64encode(mac).decode("ascii").rstrip("=")
+    return f"{body}|{tag}"
+
+
+def issue(slot_id, user, ttl_s=None):
+    """Token for a fresh reservation: (token, exp) or (None, None) without keys."""
+    if not enabled():
+        return None, None
+    ttl = DEFAULT_TTL_S if ttl_s is None else max(60, min(int(ttl_s), MAX_TTL_S))
+    exp = int(time.time()) + ttl
+    return sign(slot_id, user, exp), exp
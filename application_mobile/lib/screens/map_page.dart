@@ -201,6 +201,8 @@ class _MapPageScreenState extends State<MapPageScreen> {
       block: widget.classroom,
       ev: widget.ev,
       handicap: widget.handicap,
+      user: widget.fullName,
+      ttlSeconds: finalEta! * 60,
     );
 
     if (backend.containsKey("error")) {
@@ -226,6 +228,7 @@ class _MapPageScreenState extends State<MapPageScreen> {
           "timestamp": Timestamp.fromDate(now),
           "expiresAt": Timestamp.fromDate(expiresAt),
           "qrData": "OPTIPARK:$reservedPlace:${widget.fullName}",
+          "qrToken": backend["qr_token"],
           "arrived": false,
         });
 
@@ -263,8 +263,12 @@ class _QrPageState extends State<QrPage> {
       return const Scaffold(body: Center(child: CircularProgressIndicator()));
     }
 
+    // Signed token from the reservation API; the static signature is only a
+    // fallback for backends without QR keys (gates may reject it).
     const qrSig = "OPK_V1_20JA02";
-    final qrData = "$qrSig|OPTIPARK:${widget.reservedPlace}:${widget.fullName}";
+    final data = _reservation.data() as Map<String, dynamic>?;
+    final qrToken = data?["qrToken"] as String?;
+    final qrData = qrToken ?? "$qrSig|OPTIPARK:${widget.reservedPlace}:${widget.fullName}";
     final expired = secondsLeft <= 0;
 
     return WillPopScope(
@@ -18,13 +18,21 @@ class ReservationAPI {
     required String block,
     required bool ev,
     required bool handicap,
+    String? user,
+    int? ttlSeconds,
   }) async {
     final baseUrl = await _baseUrl();
     final url = Uri.parse("$baseUrl/reserve");
 
     final String userType = handicap ? "PMR" : (ev ? "EV" : "NORMAL");
 
-    final body = {"block_id": block, "user_type": userType};
+    // user + ttl_s go into the signed gate QR (qr_token in the response)
+    final body = {
+      "block_id": block,
+      "user_type": userType,
+      if (user != null) "user": user,
+      if (ttlSeconds != null) "ttl_s": ttlSeconds,
+    };
 
     final response = await http.post(
       url,
@@ -0,0 +1,161 @@
+/**
+ * Gate allowlist publisher (kafka/schemas/wire-format-v2.md, "Gate allowlist").
+ *
+ * Follows the active reservations in Firestore and pushes, per zone, a
+ * retained binary snapshot to parking/<parking_id>/allowlist plus small deltas
+ * to parking/<parking_id>/allowlist/delta. The gate keeps the set in RAM and
+ * admits a signed QR token without asking the backend.
+ *
+ * A reservation is identified by the first 8 bytes of its QR token tag
+ * (Reservation/qr_token.py); reservations without a signed token are skipped.
+ */
+
+const mqtt = require("mqtt");
+
+const MARKER_V1 = 0xb1;
+const TYPE_SNAPSHOT = 0x10;
+const TYPE_DELTA = 0x11;
+const SNAP_TRUNCATED = 0x01;
+
+const MAX_ENTRIES = 256; // ALLOW_MAX on the gate
+const ENTRY_LEN = 12;
+const OP_LEN = 13;
+const MAX_OPS = 255;
+
+/**
+ * { zone, id: Buffer(8), exp } for an "OPK2|kid|slot|exp|user|tag" token, or null.
+ */
+function tokenEntry(token) {
+  if (typeof token !== "string") return null;
+  const parts = token.split("|");
+  if (parts.length < 6 || parts[0] !== "OPK2") return null;
+
+  const zone = parts[2].split("-")[0];
+  const exp = parseInt(parts[3], 10);
+  const tag = Buffer.from(parts[parts.length - 1], "base64url");
+  if (!zone || !Number.isFinite(exp) || tag.length < 8) return null;
+  return { zone, id: tag.subarray(0, 8), exp };
+}
+
+function encodeSnapshot(seq, entries, truncated) {
+  const buf = Buffer.alloc(9 + entries.length * ENTRY_LEN);
+  buf[0] = MARKER_V1;
+  buf[1] = TYPE_SNAPSHOT;
+  buf.writeUInt32LE(seq >>> 0, 2);
+  buf[6] = truncated ? SNAP_TRUNCATED : 0;
+  buf.writeUInt16LE(entries.length, 7);
+  entries.forEach((e, i) => {
+    const off = 9 + i * ENTRY_LEN;
+    e.id.copy(buf, off);
+    buf.writeUInt32LE(e.exp >>> 0, off + 8);
+  });
+  return buf;
+}
+
+function encodeDelta(seq, ops) {
+  const buf = Buffer.alloc(7 + ops.length * OP_LEN);
+  buf[0] = MARKER_V1;
+  buf[1] = TYPE_DELTA;
+  buf.writeUInt32LE(seq >>> 0, 2);
+  buf[6] = ops.length;
+  ops.forEach((op, i) => {
+    const off = 7 + i * OP_LEN;
+    buf[off] = op.add ? 1 : 0;
+    op.id.copy(buf, off + 1);
+    buf.writeUInt32LE(op.add ? op.exp >>> 0 : 0, off + 9);
+  });
+  return buf;
+}
+
+/**
+ * @param {object} opts
+ * @param {string} opts.mqttUrl
+ * @param {string[]} opts.zones         zone letters served by a gate, e.g. ["A", "B", "C"]
+ * @param {string} opts.parkingPrefix   "nice_sophia." -> parking/nice_sophia.A/allowlist
+ * @param {number} opts.snapshotEveryMs full retained refresh, also drops expired entries
+ */
+function startAllowlist(firestore, collection, opts) {
+  const zones = new Map(opts.zones.map((z) => [z, { seq: 0 }]));
+  const byDoc = new Map(); // reservation doc id -> entry
+  let ready = false; // first Firestore result received
+
+  const client = mqtt.connect(opts.mqttUrl, { reconnectPeriod: 2000 });
+  const topic = (zone) => `parking/${opts.parkingPrefix}${zone}/allowlist`;
+
+  function publishSnapshot(zone) {
+    const st = zones.get(zone);
+    const now = Math.floor(Date.now() / 1000);
+    const live = [...byDoc.values()]
+      .filter((e) => e.zone === zone && e.exp >= now)
+      .sort((a, b) => a.exp - b.exp);
+    const truncated = live.length > MAX_ENTRIES;
+    if (truncated) {
+      console.warn(`⚠ Allowlist ${zone}: ${live.length} réservations, ${MAX_ENTRIES} envoyées`);
+    }
+    const entries = live.slice(0, MAX_ENTRIES);
+    client.publish(topic(zone), encodeSnapshot(st.seq, entries, truncated), { qos: 1, retain: true });
+    console.log(`🔐 Allowlist ${zone}: snapshot seq=${st.seq} (${entries.length} entrées)`);
+  }
+
+  function publishAll() {
+    if (!ready || !client.connected) return;
+    const now = Math.floor(Date.now() / 1000);
+    for (const [doc, e] of byDoc) if (e.exp < now) byDoc.delete(doc);
+    for (const zone of zones.keys()) publishSnapshot(zone);
+  }
+
+  function publishDeltas(opsByZone) {
+    for (const [zone, ops] of opsByZone) {
+      const st = zones.get(zone);
+      for (let i = 0; i < ops.length; i += MAX_OPS) {
+        st.seq++;
+        // Lost while offline: the snapshot on reconnect carries the same state.
+        if (client.connected) {
+          client.publish(`${topic(zone)}/delta`, encodeDelta(st.seq, ops.slice(i, i + MAX_OPS)), { qos: 1 });
+        }
+      }
+    }
+  }
+
+  client.on("connect", () => {
+    console.log(`🔐 Allowlist: MQTT connecté (${opts.mqttUrl})`);
+    publishAll(); // broker without persistence: retained snapshots are gone after a restart
+  });
+  client.on("error", (err) => console.error("Allowlist MQTT:", err.message));
+
+  firestore
+    .collection(collection)
+    .where("expiresAt", ">", new Date())
+    .onSnapshot(
+      (snap) => {
+        const opsByZone = new Map();
+        const push = (e, add) => {
+          if (!zones.has(e.zone)) return;
+          if (!opsByZone.has(e.zone)) opsByZone.set(e.zone, []);
+          opsByZone.get(e.zone).push({ add, id: e.id, exp: e.exp });
+        };
+
+        for (const ch of snap.docChanges()) {
+          const old = byDoc.get(ch.doc.id);
+          const cur = ch.type === "removed" ? null : tokenEntry(ch.doc.data().qrToken);
+          if (old && (!cur || !old.id.equals(cur.id))) push(old, false);
+          if (cur) push(cur, true);
+          if (cur) byDoc.set(ch.doc.id, cur);
+          else byDoc.delete(ch.doc.id);
+        }
+
+        if (!ready) {
+          ready = true;
+          publishAll();
+        } else {
+          publishDeltas(opsByZone);
+        }
+      },
+      (err) => console.error("Allowlist Firestore:", err.message)
+    );
+
+  setInterval(publishAll, opts.snapshotEveryMs);
+  return client;
+}
+
+module.exports = { startAllowlist, tokenEntry, encodeSnapshot, encodeDelta };
@@ -1,6 +1,8 @@
 const { Kafka } = require("kafkajs");
 const Redis = require("ioredis");
 const admin = require("firebase-admin");
+const wire = require("@optipark/shared/wire");
+const { startAllowlist } = require("./allowlist");
 
 // -----------------------------------------------------------
 // CONFIG
@@ -12,6 +14,11 @@ const REDIS_PORT = parseInt(process.env.REDIS_PORT || "6379", 10);
 
 const RESERVATIONS_COLLECTION = "reservations";
 
+// Allowlist des barrières (allowlist.js) ; ALLOWLIST_ZONES="" pour la désactiver
+const MQTT_URL = process.env.MQTT_URL || "mqtt://mosquitto:1883";
+const ALLOWLIST_ZONES = (process.env.ALLOWLIST_ZONES ?? "A,B,C").split(",").map((z) => z.trim()).filter(Boolean);
+const ALLOWLIST_SNAPSHOT_MS = parseInt(process.env.ALLOWLIST_SNAPSHOT_MS || "60000", 10);
+
 const RAW_TOPICS = [
   "parking.nice_sophia.A",
   "parking.nice_sophia.B",
@@ -88,6 +95,15 @@ async function run() {
   await redis.connect();
   console.log("Redis connected.");
 
+  if (ALLOWLIST_ZONES.length > 0) {
+    startAllowlist(firestore, RESERVATIONS_COLLECTION, {
+      mqttUrl: MQTT_URL,
+      zones: ALLOWLIST_ZONES,
+      parkingPrefix: "nice_sophia.",
+      snapshotEveryMs: ALLOWLIST_SNAPSHOT_MS,
+    });
+  }
+
   const consumer = kafka.consumer({
     groupId: KAFKA_GROUP_ID,
     retry: {
@@ -129,11 +145,20 @@ async function run() {
     eachMessage: async ({ topic, message }) => {
       let event;
 
-      try {
-        event = JSON.parse(message.value.toString());
-      } catch {
-        console.error("Invalid JSON:", message.value.toString());
-        return;
+      if (wire.isBinary(message.value)) {
+        const decoded = wire.decode(message.value);
+        if (!decoded) {
+          console.error("Invalid binary event:", message.value.toString("hex"));
+          return;
+        }
+        event = decoded.value;
+      } else {
+        try {
+          event = JSON.parse(message.value.toString());
+        } catch {
+          console.error("Invalid JSON:", message.value.toString());
+          return;
+        }
       }
 
       const { parking_id, slot_id, occupied } = event;
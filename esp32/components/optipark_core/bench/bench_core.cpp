@@ -0,0 +1,219 @@
+// Microbenchmarks for the hot paths of the gate and sensor firmware, run on the
+// host against fake_hal. Absolute numbers differ from the ESP32; use them to
+// compare changes.
+//   ./build/core_bench --benchmark_filter=Qr
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "allowlist.h"
+#include "evtime.h"
+#include "fake_hal.h"
+#include "occupancy.h"
+#include "qr.h"
+#include "rain.h"
+#include "wire_format.h"
+
+static void BM_QrParse(benchmark::State &state)
+{
+    const char *in = "OPK_V1_20JA02|OPTIPARK:A-18:Alice Martin";
+    char name[QR_NAME_LEN];
+    char zone[QR_ZONE_LEN];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(qr_parse(in, "OPK_V1_20JA02", name, sizeof(name), zone, sizeof(zone)));
+    }
+}
+BENCHMARK(BM_QrParse);
+
+static void BM_QrParseBadSignature(benchmark::State &state)
+{
+    const char *in = "OPK_V1_20JA03|OPTIPARK:A-18:Alice Martin";
+    char name[QR_NAME_LEN];
+    char zone[QR_ZONE_LEN];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(qr_parse(in, "OPK_V1_20JA02", name, sizeof(name), zone, sizeof(zone)));
+    }
+}
+BENCHMARK(BM_QrParseBadSignature);
+
+static qr_keyring_t bench_keys()
+{
+    qr_keyring_t k{};
+    k.count = 1;
+    k.key[0].kid = 1;
+    for (int i = 0; i < QR_KEY_LEN; i++) k.key[0].key[i] = uint8_t(i);
+    return k;
+}
+
+// Signed token: parse + HMAC-SHA256 + constant-time compare. The host HMAC is
+// OpenSSL in software; the gate uses the SHA accelerator through mbedTLS.
+static void BM_QrVerify(benchmark::State &state)
+{
+    const qr_keyring_t keys = bench_keys();
+    const char *in = "OPK2|1|A-3|1900000000|Alice|gac7uxSuGqdIsiUiou8BoQ";
+    qr_token_t t;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(qr_verify(in, &keys, 1899999000, 60, &t));
+    }
+}
+BENCHMARK(BM_QrVerify);
+
+// Alternating legacy payloads, so every call goes past the repeat filter.
+static void BM_QrCheck(benchmark::State &state)
+{
+    const char *in[2] = { "OPK_V1_20JA02|OPTIPARK:A-18:Alice", "OPK_V1_20JA02|OPTIPARK:A-3:Bob" };
+    const qr_keyring_t keys = bench_keys();
+    const qr_policy_t policy = { &keys, "OPK_V1_20JA02", 'A', 60, nullptr };
+    qr_filter_t f{};
+    qr_token_t t;
+    unsigned i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(qr_check(&f, in[i++ & 1], &policy, &t));
+    }
+}
+BENCHMARK(BM_QrCheck);
+
+// Full allowlist snapshot (ALLOW_MAX entries), as received on MQTT reconnect.
+static std::vector<uint8_t> allow_snapshot()
+{
+    std::vector<uint8_t> m = { 0xB1, ALLOW_MSG_SNAPSHOT, 1, 0, 0, 0, 0, ALLOW_MAX & 0xff, ALLOW_MAX >> 8 };
+    std::mt19937_64 rng(42);
+    for (int i = 0; i < ALLOW_MAX; i++) {
+        uint64_t id = rng();
+        for (int b = 0; b < 8; b++) m.push_back(uint8_t(id >> (8 * b)));
+        for (int b = 0; b < 4; b++) m.push_back(uint8_t(1900000000u >> (8 * b)));
+    }
+    return m;
+}
+
+static void BM_AllowlistSnapshot(benchmark::State &state)
+{
+    static allowlist_t a;
+    const std::vector<uint8_t> m = allow_snapshot();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(allowlist_apply(&a, m.data(), m.size()));
+    }
+}
+BENCHMARK(BM_AllowlistSnapshot);
+
+// Admission lookup on a full list, alternating hit and miss.
+static void BM_AllowlistCheck(benchmark::State &state)
+{
+    static allowlist_t a;
+    allowlist_init(&a);
+    const std::vector<uint8_t> m = allow_snapshot();
+    allowlist_apply(&a, m.data(), m.size());
+    std::mt19937_64 rng(42);
+    const uint64_t ids[2] = { rng(), 0x0123456789abcdefULL };
+    unsigned i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(allowlist_check(&a, ids[i++ & 1], 1899999000));
+    }
+}
+BENCHMARK(BM_AllowlistCheck);
+
+// One scan tick of the shift-register backend, arg = number of changing spots.
+static void BM_OccupancyScan(benchmark::State &state)
+{
+    occupancy_t o;
+    occupancy_init(&o, MAX_SPOTS, true, true);
+    const uint64_t toggling = (state.range(0) >= 64) ? ~0ULL : ((1ULL << state.range(0)) - 1);
+    uint64_t sample = 0;
+    unsigned tick = 0;
+    for (auto _ : state) {
+        if (++tick % 3 == 0) sample ^= toggling;   // flips land every third tick
+        benchmark::DoNotOptimize(occupancy_scan(&o, sample));
+    }
+}
+BENCHMARK(BM_OccupancyScan)->Arg(0)->Arg(1)->Arg(64);
+
+static void BM_OccupancyDecide(benchmark::State &state)
+{
+    occupancy_t o;
+    occupancy_init(&o, MAX_SPOTS, true, true);
+    int i = 0;
+    for (auto _ : state) {
+        o.occ[i] = !o.occ[i];
+        benchmark::DoNotOptimize(occupancy_publish_decide(&o, i, true, false));
+        i = (i + 1) & (MAX_SPOTS - 1);
+    }
+}
+BENCHMARK(BM_OccupancyDecide);
+
+// Every spot flapping against a 4-per-minute limit: mostly held decisions.
+static void BM_OccupancyDecideRateLimited(benchmark::State &state)
+{
+    occupancy_t o;
+    occupancy_init(&o, MAX_SPOTS, true, true);
+    occupancy_set_rate_limit(&o, 4, 60000);
+    int i = 0;
+    for (auto _ : state) {
+        o.occ[i] = !o.occ[i];
+        benchmark::DoNotOptimize(occupancy_publish_decide(&o, i, true, false));
+        i = (i + 1) & (MAX_SPOTS - 1);
+    }
+}
+BENCHMARK(BM_OccupancyDecideRateLimited);
+
+static void BM_RainPoll(benchmark::State &state)
+{
+    g_hal.reset();
+    g_hal.adc[0] = {2000, 1925, true};
+    rain_cfg_t cfg{};
+    cfg.wet_mv = 1000;
+    cfg.dry_mv = 2850;
+    cfg.wet_raw = 1200;
+    cfg.dry_raw = 3500;
+    cfg.iir_shift = 3;
+    cfg.hysteresis_pct = 5;
+    cfg.min_publish_ms = 10000;
+    cfg.on_change_only = false;
+    cfg.sensor_id = "rain-1";
+    cfg.topic = "parking/rain";
+    cfg.binary = state.range(0) != 0;
+    rain_t r;
+    rain_init(&r, &cfg);
+    for (auto _ : state) {
+        g_hal.now_ms += 10000;      // every call publishes
+        benchmark::DoNotOptimize(rain_poll(&r));
+        if (g_hal.published.size() > 1024) g_hal.published.clear();
+    }
+}
+BENCHMARK(BM_RainPoll)->ArgName("binary")->Arg(0)->Arg(1);
+
+static void BM_WireEncodeSpot(benchmark::State &state)
+{
+    uint8_t buf[WIRE_SPOT_MAX_LEN];
+    evtime_t t = { 1768298400000LL, true, 30 };
+    for (auto _ : state) {
+        t.ms++;
+        benchmark::DoNotOptimize(wire_encode_spot(buf, sizeof(buf), "A-18", true, 3700, &t));
+    }
+}
+BENCHMARK(BM_WireEncodeSpot);
+
+static void BM_WireEncodeDelta(benchmark::State &state)
+{
+    uint8_t buf[WIRE_DELTA_MAX_LEN];
+    const evtime_t t = { 1768298400000LL, true, 30 };
+    uint32_t seq = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(wire_encode_delta(buf, sizeof(buf), seq++, 0x1a, 0x2, &t));
+    }
+}
+BENCHMARK(BM_WireEncodeDelta);
+
+// JSON timestamp members as appended to every spot / rain / delta payload.
+static void BM_EvtimeJson(benchmark::State &state)
+{
+    char buf[64];
+    evtime_t t = { 1768298400000LL, true, 30 };
+    for (auto _ : state) {
+        t.ms += 1009;
+        benchmark::DoNotOptimize(evtime_json(&t, buf, sizeof(buf)));
+    }
+}
+BENCHMARK(BM_EvtimeJson);
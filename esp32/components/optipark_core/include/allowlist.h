@@ -0,0 +1,71 @@
+/* @file  allowlist.h
+   @brief active reservations of this gate's zone, pushed by the backend over
+          MQTT, for local admission decisions
+*/
+
+#ifndef _ALLOWLIST_H_
+#define _ALLOWLIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A reservation is identified by the first 8 bytes of its QR token tag (see
+ * qr.h), read little-endian. Messages (kafka/schemas/wire-format-v2.md):
+ *   snapshot 0xB1 0x10 seq:u32 flags:u8 count:u16 {id:u64 exp:u32}*count   retained
+ *   delta    0xB1 0x11 seq:u32 n:u8 {op:u8 id:u64 exp:u32}*n               op 1 add, 0 remove
+ * A snapshot replaces the whole set. Deltas apply on top of it in seq order.
+ * When one is lost, or a snapshot older than the deltas already applied comes
+ * in (the retained copy after a reconnect), the set stays usable for hits but
+ * is partial until the next snapshot repairs it.
+ */
+#define ALLOW_MAX        256     // entries per zone
+#define ALLOW_SLOTS      512     // open addressing, load factor <= 0.5
+#define ALLOW_ENTRY_LEN  12
+#define ALLOW_DELTA_OP_LEN 13
+
+#define ALLOW_MSG_SNAPSHOT  0x10
+#define ALLOW_MSG_DELTA     0x11
+
+#define ALLOW_SNAP_TRUNCATED 0x01   // backend had more than ALLOW_MAX entries
+
+typedef enum {
+    ALLOW_UNKNOWN,      // no usable list (none received yet, or incomplete)
+    ALLOW_YES,
+    ALLOW_NO,
+} allow_result_t;
+
+typedef struct {
+    bool loaded;            // a snapshot was applied
+    bool partial;           // truncated, full here, behind a lost delta or rolled
+                            // back by a stale snapshot: a miss proves nothing
+    uint32_t seq;
+    uint32_t gaps;          // deltas lost since boot
+    int count;
+    int tombs;              // removed slots, cleared by the next snapshot
+    uint8_t state[ALLOW_SLOTS];
+    uint64_t id[ALLOW_SLOTS];
+    uint32_t exp[ALLOW_SLOTS];
+} allowlist_t;
+
+void allowlist_init(allowlist_t *a);
+
+// Apply one snapshot or delta. false for a malformed or stale message.
+bool allowlist_apply(allowlist_t *a, const uint8_t *msg, size_t len);
+
+// id of a token: first 8 tag bytes, little-endian.
+uint64_t allowlist_id(const uint8_t *tag);
+
+// O(1) on average. An entry past exp counts as absent.
+allow_result_t allowlist_check(const allowlist_t *a, uint64_t id, int64_t now_s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+/* @file  evtime.h
+   @brief event timestamps: wall clock (SNTP) when synced, uptime otherwise
+*/
+
+#ifndef _EVTIME_H_
+#define _EVTIME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int64_t ms;         // unix ms if epoch, else uptime ms; < 0 = unknown
+    bool epoch;
+    int sync_age_s;     // seconds since the last SNTP sync, -1 = unknown
+} evtime_t;
+
+// Timestamp of something that happened at uptime_ms (hal_now_ms() scale).
+evtime_t evtime_at(int64_t uptime_ms);
+
+// "2026-01-13T10:00:00.123Z"; returns the length, 0 if cap is too small.
+size_t evtime_iso(int64_t epoch_ms, char *buf, size_t cap);
+
+// JSON members to append after the last one of an object:
+//   ,"sent_at":"...","sync_age_s":N   (epoch)
+//   ,"ts_ms":N                        (uptime)
+//   nothing                           (unknown)
+// Returns the length like snprintf (>= cap means truncated).
+int evtime_json(const evtime_t *t, char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+/* @file  gate.h
+   @brief gate servo + screen state machine
+   @note  runs in the firmware's gate task; all I/O goes through opk_hal.h
+*/
+
+#ifndef _GATE_H_
+#define _GATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "qr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    GATE_REQ_OPEN,
+    GATE_REQ_INVALID,
+    GATE_REQ_WRONG_ZONE,
+    GATE_REQ_EXPIRED,
+    GATE_REQ_USED,
+    GATE_REQ_NOT_BOOKED,
+} gate_req_kind_t;
+
+typedef struct {
+    gate_req_kind_t kind;
+    char name[QR_NAME_LEN];
+    char zone[QR_ZONE_LEN];
+    int64_t rx_ms;      // QR line received, for the QR -> servo latency
+} gate_req_t;
+
+typedef enum {
+    GATE_IDLE,
+    GATE_WELCOME,   // "Welcome" shown, name + servo open next
+    GATE_OPEN,      // servo open, close on deadline
+} gate_state_t;
+
+typedef struct {
+    int open_deg;
+    int close_deg;
+    uint32_t welcome_ms;
+    uint32_t open_ms;
+    uint32_t invalid_ms;    // "Invalid QR" hold time
+    uint32_t wrong_ms;      // "Wrong parking" hold time
+} gate_cfg_t;
+
+// Start serving req. Returns the next state; *deadline_ms is set unless
+// that state is GATE_IDLE. A rejection restores the "Waiting..." base screen
+// under its timed message.
+gate_state_t gate_start(const gate_cfg_t *cfg, const gate_req_t *req, int64_t *deadline_ms);
+
+// Called once the deadline of st has passed. more_queued skips the
+// "Waiting..." screen when the next request is already waiting.
+gate_state_t gate_advance(const gate_cfg_t *cfg, gate_state_t st, const gate_req_t *req,
+                          bool more_queued, int64_t *deadline_ms);
+
+void gate_show_waiting(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+/* @file  occupancy.h
+   @brief per-spot occupancy state: debouncing, change-only publish decisions
+          and the per-slot publish rate limit
+*/
+
+#ifndef _OCCUPANCY_H_
+#define _OCCUPANCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_SPOTS     64     // one bit per spot in the uint64 bitmaps
+
+typedef enum {
+    OCC_PUB_NONE,       // nothing to send
+    OCC_PUB_NOW,        // changed: publish a per-slot event, outbox it on failure
+    OCC_PUB_REFRESH,    // unchanged re-publish (PUBLISH_ON_CHANGE_ONLY off), no outbox
+    OCC_PUB_BATCH,      // changed: bit set in chg, goes out with the next delta
+    OCC_PUB_OUTBOX,     // changed while offline or behind a backlog: outbox it
+    OCC_PUB_HELD,       // changed but rate limited: decide again at occupancy_next_release_ms()
+} occ_pub_t;
+
+typedef struct {
+    int count;
+    bool batch;             // snapshot mode: changes are batched into deltas
+    bool on_change_only;    // per-slot mode: skip re-publishing unchanged spots
+    bool occ[MAX_SPOTS];    // confirmed state
+    bool prev[MAX_SPOTS];   // state last handed to the publisher
+    uint64_t chg;           // batch mode: bit i = spot i changed since the last delta
+    // Rate limit, one token bucket per spot (GCRA form: a single deadline
+    // per spot instead of a token count and a refill time).
+    int rl_burst;                   // 0 = no limit
+    uint32_t rl_interval_ms;        // one token back every interval
+    int64_t rl_tat[MAX_SPOTS];      // theoretical arrival time of the next change
+    uint64_t held;                  // bit i = spot i has a change waiting for a token
+    uint16_t suppressed[MAX_SPOTS]; // transitions never published, reset by the caller
+    // Polled backends: 2-bit vertical counters, one bit lane per spot.
+    uint64_t scan_state;
+    uint64_t ct0, ct1;
+} occupancy_t;
+
+void occupancy_init(occupancy_t *o, int count, bool batch, bool on_change_only);
+
+uint64_t occupancy_bitmap(const occupancy_t *o);
+// Bitmap of the state handed to the publisher (prev): a held spot keeps its
+// last published bit. Deltas carry this one, so the receiver's cache never
+// learns a held change it was not told about as a change.
+uint64_t occupancy_published_bitmap(const occupancy_t *o);
+int occupancy_count_free(const occupancy_t *o);
+
+// Debounce one bulk sample (bit i = spot i occupied) of a polled backend:
+// a bit flips after 3 equal samples in a row. Flipped spots are applied to
+// o->occ; the returned mask says which.
+uint64_t occupancy_scan(occupancy_t *o, uint64_t sample);
+
+// Re-read spot i from its GPIO and apply the level as the confirmed state.
+// Returns true when it changed.
+bool occupancy_confirm_pin(occupancy_t *o, int i, int pin, bool active_low);
+
+// At most burst changes per spot within window_ms (burst <= 0 or window_ms 0:
+// no limit). A change over the limit is held (OCC_PUB_HELD) and decided again
+// once the spot has a token: the latest state then goes out, or nothing if
+// the spot is back where it was last published.
+void occupancy_set_rate_limit(occupancy_t *o, int burst, uint32_t window_ms);
+
+// What to do with spot i after a confirm, resync or release. online: MQTT
+// connected; backlog: the outbox is not empty (new events queue behind it to
+// keep order).
+occ_pub_t occupancy_publish_decide(occupancy_t *o, int i, bool online, bool backlog);
+
+// Earliest hal_now_ms() at which a held spot gets a token, INT64_MAX if none is held.
+int64_t occupancy_next_release_ms(const occupancy_t *o);
+
+// A full snapshot of occupancy_bitmap() went out: every spot counts as
+// published, held ones included. The receiver sees a held spot as a
+// difference to its cache, since no delta carried its new bit.
+void occupancy_snapshot_sent(occupancy_t *o);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/* @file  opk_hal.h
+   @brief hardware interface of the portable firmware core
+   @note  implemented by the firmware (app_main.c) on the ESP32 and by
+          test/fake_hal.cpp on the host
+*/
+
+#ifndef _OPK_HAL_H_
+#define _OPK_HAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Monotonic milliseconds since boot.
+int64_t hal_now_ms(void);
+
+// Wall clock in unix seconds / ms, 0 while it has not been synced.
+int64_t hal_epoch_s(void);
+int64_t hal_epoch_ms(void);
+
+// Seconds since the last successful SNTP sync, -1 if none since boot.
+int hal_clock_sync_age_s(void);
+
+// Input level of a GPIO (true = high).
+bool hal_gpio_get(int pin);
+
+// One oversampled reading of analog input ch (index in the firmware's
+// channel list). mv is -1 when no calibration is available.
+bool hal_adc_read(int ch, int *raw, int *mv);
+
+// Queue one message; false when offline or the client refused it.
+bool hal_mqtt_publish(const char *topic, const void *payload, size_t len, int qos, bool retain);
+
+// Base screen, kept until replaced. Cancels a timed message still up.
+void hal_lcd_show(const char *line0, const char *line1);
+
+// Timed screen, falls back to the base screen after hold_ms.
+void hal_lcd_message(const char *line0, const char *line1, uint32_t hold_ms);
+
+void hal_servo_set_angle(int deg);
+
+// HMAC-SHA256 (hardware SHA on the ESP32).
+bool hal_hmac_sha256(const uint8_t *key, size_t key_len, const void *msg, size_t len, uint8_t out[32]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
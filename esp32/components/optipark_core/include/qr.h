@@ -0,0 +1,110 @@
+/* @file  qr.h
+   @brief gate QR tokens: signed v2 verification, legacy parsing, repeat and
+          replay filtering
+*/
+
+#ifndef _QR_H_
+#define _QR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "allowlist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QR_MAX_LEN    160     // longest payload remembered for the repeat check
+#define QR_NAME_LEN   64
+#define QR_ZONE_LEN   8
+#define QR_SLOT_LEN   12
+
+/*
+ * Signed token (v2), issued by the reservation backend:
+ *   OPK2|<kid>|<slot>|<exp>|<user>|<tag>
+ * kid: key id 0..255; slot: "A-3" (zone = part before '-'); exp: unix
+ * seconds; tag: first QR_TAG_LEN bytes of HMAC-SHA256(key[kid], everything
+ * before the last '|'), base64url without padding (22 chars).
+ */
+#define QR_V2_PREFIX  "OPK2|"
+#define QR_KEY_LEN    32
+#define QR_TAG_LEN    16
+#define QR_MAX_KEYS   4       // current + previous during a rotation, with headroom
+#define QR_USED_MAX   32      // opened tokens remembered until they expire
+
+typedef struct {
+    uint8_t kid;
+    uint8_t key[QR_KEY_LEN];
+} qr_key_t;
+
+typedef struct {
+    int count;
+    qr_key_t key[QR_MAX_KEYS];
+} qr_keyring_t;
+
+typedef enum {
+    QR_OPEN,          // valid, for this gate
+    QR_INVALID,       // malformed, or a legacy code while those are off
+    QR_WRONG_ZONE,    // valid, for another parking
+    QR_IGNORE,        // empty, or the same payload as the previous scan
+    QR_BAD_TAG,       // signed token with an unknown key or a wrong tag
+    QR_EXPIRED,
+    QR_NO_CLOCK,      // signed token, but the wall clock is not synced yet
+    QR_REPLAY,        // token already opened the gate
+    QR_NOT_BOOKED,    // signed token, but not in the zone's reservation list
+} qr_result_t;
+
+typedef struct {
+    char name[QR_NAME_LEN];
+    char zone[QR_ZONE_LEN];
+    char slot[QR_SLOT_LEN];     // empty for legacy codes
+    int64_t exp;                // 0 for legacy codes
+    uint8_t tag[QR_TAG_LEN];
+} qr_token_t;
+
+typedef struct {
+    const qr_keyring_t *keys;
+    const char *legacy_sig;     // also accept "<sig>|OPTIPARK:..." codes; NULL = signed only
+    char zone;                  // zone served by this gate
+    int skew_s;                 // grace after exp for clock drift
+    const allowlist_t *allow;   // active reservations; NULL or not loaded = token alone decides
+} qr_policy_t;
+
+typedef struct {
+    uint8_t tag[8];
+    int64_t exp;
+} qr_used_t;
+
+typedef struct {
+    char last[QR_MAX_LEN];
+    qr_used_t used[QR_USED_MAX];
+    int used_next;
+} qr_filter_t;
+
+// Legacy "<signature>|OPTIPARK:<zone>-<spot>:<name>"
+// Fills out_name / out_zone on success; the signature must match exactly.
+bool qr_parse(const char *in, const char *signature,
+              char *out_name, size_t out_name_sz,
+              char *out_zone, size_t out_zone_sz);
+
+// Parse a v2 token and check its tag (hal_hmac_sha256, constant-time compare)
+// and expiry. now_s: unix seconds, 0 when the clock is not synced.
+qr_result_t qr_verify(const char *in, const qr_keyring_t *keys, int64_t now_s, int skew_s,
+                      qr_token_t *out);
+
+// Repeat filter + verify/parse + zone check + allowlist + replay check, with the time from
+// hal_epoch_s(). A payload equal to the previous one is ignored until a
+// different one is scanned (cameras resend while the code is in view).
+qr_result_t qr_check(qr_filter_t *f, const char *payload, const qr_policy_t *p, qr_token_t *out);
+
+// Compare without an early exit, so timing does not leak the matching prefix.
+bool qr_ct_equal(const uint8_t *a, const uint8_t *b, size_t n);
+
+const char *qr_result_str(qr_result_t r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
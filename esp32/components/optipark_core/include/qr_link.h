@@ -0,0 +1,60 @@
+/* @file  qr_link.h
+   @brief camera QR link: line framing of the TCP stream and the decision
+          line echoed back for each scan
+*/
+
+#ifndef _QR_LINK_H_
+#define _QR_LINK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QR_LINK_BUF_SIZE  256     // per-connection ring, also the max line length
+
+/*
+ * The camera sends one QR payload per '\n'-terminated line. Each line gets
+ * one decision line back, in order (tools/qr_loadgen.py reads them):
+ *   OPK-D <seq> <t_ms> <decide_us> <gate> <result>
+ * seq:       line number on this connection, from 1
+ * t_ms:      gate uptime when the decision was taken
+ * decide_us: line complete -> decision (QR check only, not the network)
+ * gate:      queued | full (gate queue full, request dropped) | -
+ * result:    qr_result_str(), or "too long" for a dropped overlong line
+ */
+#define QR_DECISION_PREFIX  "OPK-D "
+#define QR_DECISION_MAX     96
+
+typedef struct {
+    char buf[QR_LINK_BUF_SIZE];
+    uint16_t head;
+    uint16_t len;
+    bool discarding;            // overlong line: drop bytes up to the next '\n'
+    uint32_t seq;               // lines delivered, overlong ones included
+} qr_link_t;
+
+// line is NUL-terminated with CR removed and trailing blanks trimmed; NULL
+// for a line longer than QR_LINK_BUF_SIZE - 1, reported once when detected.
+typedef void (*qr_line_fn)(void *ctx, char *line, int n);
+
+void qr_link_reset(qr_link_t *l);
+
+// Contiguous free part of the ring, where the next recv() goes.
+char *qr_link_space(qr_link_t *l, size_t *room);
+
+// n bytes were written at qr_link_space(): hand every complete line to on_line.
+void qr_link_commit(qr_link_t *l, size_t n, qr_line_fn on_line, void *ctx);
+
+// Decision line for the current l->seq, '\n' included. Returns its length.
+int qr_decision_format(char *out, size_t cap, uint32_t seq, int64_t t_ms, uint32_t decide_us,
+                       const char *gate, const char *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+/* @file  rain.h
+   @brief rain percentage from the analog sensor: scaling, IIR filter,
+          hysteresis and rate-limited publishing
+*/
+
+#ifndef _RAIN_H_
+#define _RAIN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int adc_ch;               // hal_adc_read() channel
+    int wet_mv, dry_mv;       // calibrated end points (100 % / 0 %)
+    int wet_raw, dry_raw;     // same, in ADC codes, used without calibration
+    int iir_shift;            // y += (x - y) / 2^iir_shift per reading
+    int hysteresis_pct;       // publish only on a move of at least this much
+    uint32_t min_publish_ms;  // and at most once per this interval
+    bool on_change_only;      // false: also republish every min_publish_ms
+    const char *sensor_id;
+    const char *topic;
+    int qos;
+    bool retain;
+    bool binary;              // wire format v1 instead of JSON
+} rain_cfg_t;
+
+typedef struct {
+    const rain_cfg_t *cfg;
+    int pct_q8;         // IIR state, percent * 256; -1 = not primed
+    int pct;            // filtered percentage
+    int pct_pub;        // last published value, -1 = none yet
+    int64_t pub_ms;
+    int raw, mv;        // last reading
+} rain_t;
+
+void rain_init(rain_t *r, const rain_cfg_t *cfg);
+
+// 0 (dry) .. 100 (wet); mv < 0 falls back to the raw end points.
+int rain_pct_from_reading(const rain_cfg_t *cfg, int raw, int mv);
+
+// Feed one unfiltered percentage. Returns true when r->pct should be published.
+bool rain_feed(rain_t *r, int pct, int64_t now_ms);
+
+// Read, filter and publish if due. Returns true when a message went out.
+bool rain_poll(rain_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+/* @file  wire_format.h
+   @brief compact binary encoding of OptiPark sensor events (v2)
+   @note  layout is specified in kafka/schemas/wire-format-v2.md
+*/
+
+#ifndef _WIRE_FORMAT_H_
+#define _WIRE_FORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "evtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WIRE_MARKER_V1        0xB1     // no sync age, delta without flags (still decoded)
+#define WIRE_MARKER_V2        0xB2
+
+#define WIRE_TYPE_SPOT        0x01
+#define WIRE_TYPE_RAIN        0x02
+#define WIRE_TYPE_DELTA       0x03
+
+// spot event flags
+#define WIRE_SPOT_OCCUPIED    0x01
+#define WIRE_SPOT_HAS_BATTERY 0x02
+#define WIRE_SPOT_HAS_TS      0x04
+#define WIRE_SPOT_HAS_PARKING 0x08
+#define WIRE_SPOT_TS_EPOCH    0x10
+#define WIRE_SPOT_HAS_SYNC    0x20
+
+// rain event flags
+#define WIRE_RAIN_HAS_RAW     0x01
+#define WIRE_RAIN_HAS_TS      0x02
+#define WIRE_RAIN_TS_EPOCH    0x04
+#define WIRE_RAIN_HAS_SYNC    0x08
+
+// delta flags (v2)
+#define WIRE_DELTA_HAS_TS     0x01
+#define WIRE_DELTA_TS_EPOCH   0x02
+#define WIRE_DELTA_HAS_SYNC   0x04
+
+// worst case for the short ids used on the gate (<= 15 chars)
+#define WIRE_SPOT_MAX_LEN     (2 + 1 + 16 + 2 + 8 + 2)
+#define WIRE_RAIN_MAX_LEN     (2 + 1 + 16 + 1 + 2 + 8 + 2)
+#define WIRE_DELTA_LEN        (2 + 1 + 4 + 8 + 8 + 8)  // with a timestamp, without sync age
+#define WIRE_DELTA_MAX_LEN    (WIRE_DELTA_LEN + 2)
+
+#define WIRE_SYNC_UNKNOWN     0xFFFF
+
+// All encoders return the number of bytes written, 0 if the buffer is too small.
+// battery_mv / raw < 0: field left out. ts: NULL or ms < 0 = no timestamp;
+// sync_age_s is only sent with an epoch timestamp.
+size_t wire_encode_spot(uint8_t *buf, size_t cap, const char *slot_id, bool occupied,
+                        int battery_mv, const evtime_t *ts);
+size_t wire_encode_rain(uint8_t *buf, size_t cap, const char *sensor_id, uint8_t rain_pct,
+                        int raw, const evtime_t *ts);
+size_t wire_encode_delta(uint8_t *buf, size_t cap, uint32_t seq, uint64_t occ, uint64_t chg,
+                         const evtime_t *ts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,264 @@
+/* @file  gate_sim.cpp
+   @brief host stand-in for the gate's camera link: the TCP server of
+          app_main.c around the real QR check, gate state machine and line
+          framing, so tools/qr_loadgen.py runs without a board
+
+   Same port, client limit, gate queue depth and timings as the firmware
+   defaults. The fake HAL supplies the clocks (real time here) and HMAC; the
+   allowlist stays unloaded, so a valid signed token alone opens.
+
+     gate_sim [--port 3333] [--zone A] [--keys 1:<64 hex>,...] [--legacy SIG] [-v]
+
+   --port 0 picks a free port. The port is printed on stdout once listening.
+*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "fake_hal.h"
+#include "gate.h"
+#include "qr.h"
+#include "qr_link.h"
+
+namespace {
+
+// app_main.c defaults
+const int MAX_CLIENTS = 4;
+const size_t GATE_QUEUE_LEN = 4;
+const gate_cfg_t GATE_CFG = { 0, 90, 800, 2500, 1200, 2000 };
+
+struct Conn {
+    int fd = -1;
+    qr_link_t link;
+};
+
+struct Sim {
+    qr_keyring_t keys{};
+    qr_policy_t policy{};
+    qr_filter_t filter{};
+    std::deque<gate_req_t> queue;
+    gate_state_t st = GATE_IDLE;
+    gate_req_t cur{};
+    int64_t deadline_ms = 0;
+    bool verbose = false;
+};
+
+Sim g_sim;
+
+int64_t mono_us()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void tick_clocks()
+{
+    using namespace std::chrono;
+    static const int64_t t0 = mono_us();
+    g_hal.now_ms = (mono_us() - t0) / 1000;
+    g_hal.epoch_ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    g_hal.sync_age_s = 0;
+}
+
+bool parse_keys(const char *spec, qr_keyring_t *ring)
+{
+    std::string s(spec);
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t end = s.find(',', pos);
+        std::string item = s.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = (end == std::string::npos) ? s.size() : end + 1;
+        size_t colon = item.find(':');
+        if (colon == std::string::npos || ring->count >= QR_MAX_KEYS) return false;
+        std::string hex = item.substr(colon + 1);
+        if (hex.size() != 2 * QR_KEY_LEN) return false;
+        qr_key_t &k = ring->key[ring->count++];
+        k.kid = uint8_t(atoi(item.substr(0, colon).c_str()));
+        for (int i = 0; i < QR_KEY_LEN; i++) {
+            char *stop = nullptr;
+            std::string byte = hex.substr(2 * i, 2);
+            k.key[i] = uint8_t(strtoul(byte.c_str(), &stop, 16));
+            if (*stop) return false;
+        }
+    }
+    return true;
+}
+
+gate_req_kind_t req_kind(qr_result_t r)
+{
+    switch (r) {
+    case QR_OPEN:       return GATE_REQ_OPEN;
+    case QR_WRONG_ZONE: return GATE_REQ_WRONG_ZONE;
+    case QR_EXPIRED:    return GATE_REQ_EXPIRED;
+    case QR_REPLAY:     return GATE_REQ_USED;
+    case QR_NOT_BOOKED: return GATE_REQ_NOT_BOOKED;
+    default:            return GATE_REQ_INVALID;
+    }
+}
+
+// gate_task of app_main.c, driven from the poll loop.
+void gate_run()
+{
+    for (;;) {
+        if (g_sim.st == GATE_IDLE) {
+            if (g_sim.queue.empty()) return;
+            g_sim.cur = g_sim.queue.front();
+            g_sim.queue.pop_front();
+            g_sim.st = gate_start(&GATE_CFG, &g_sim.cur, &g_sim.deadline_ms);
+            continue;
+        }
+        if (g_hal.now_ms < g_sim.deadline_ms) return;
+        g_sim.st = gate_advance(&GATE_CFG, g_sim.st, &g_sim.cur, !g_sim.queue.empty(), &g_sim.deadline_ms);
+        g_hal.screens.clear();
+        g_hal.servo.clear();
+    }
+}
+
+void on_line(void *ctx, char *line, int n)
+{
+    (void)n;
+    Conn *c = static_cast<Conn *>(ctx);
+    int64_t t0 = mono_us();
+    const char *result = "too long";
+    const char *gate = "-";
+
+    if (line) {
+        qr_token_t tok;
+        qr_result_t r = qr_check(&g_sim.filter, line, &g_sim.policy, &tok);
+        result = qr_result_str(r);
+        if (r != QR_IGNORE) {
+            if (g_sim.queue.size() < GATE_QUEUE_LEN) {
+                gate_req_t req{};
+                req.kind = req_kind(r);
+                req.rx_ms = g_hal.now_ms;
+                if (r == QR_OPEN) snprintf(req.name, sizeof(req.name), "%s", tok.name);
+                if (r == QR_OPEN || r == QR_WRONG_ZONE) snprintf(req.zone, sizeof(req.zone), "%s", tok.zone);
+                g_sim.queue.push_back(req);
+                gate = "queued";
+            } else {
+                gate = "full";
+            }
+        }
+    }
+
+    char out[QR_DECISION_MAX];
+    int len = qr_decision_format(out, sizeof(out), c->link.seq, g_hal.now_ms, uint32_t(mono_us() - t0),
+                                 gate, result);
+    if (g_sim.verbose) printf("fd=%d %.*s", c->fd, len, out);
+    send(c->fd, out, size_t(len), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+int listen_on(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(uint16_t(port));
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, MAX_CLIENTS) != 0) {
+        perror("gate_sim: bind/listen");
+        exit(1);
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+    printf("gate_sim listening on %d\n", ntohs(addr.sin_port));
+    fflush(stdout);
+    return fd;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int port = 3333;
+    std::string zone = "A";
+    const char *keys = nullptr;
+    const char *legacy = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool has_val = i + 1 < argc;
+        if (a == "--port" && has_val) port = atoi(argv[++i]);
+        else if (a == "--zone" && has_val) zone = argv[++i];
+        else if (a == "--keys" && has_val) keys = argv[++i];
+        else if (a == "--legacy" && has_val) legacy = argv[++i];
+        else if (a == "-v") g_sim.verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--port N] [--zone A] [--keys kid:hex,...] [--legacy SIG] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (keys && !parse_keys(keys, &g_sim.keys)) {
+        fprintf(stderr, "gate_sim: bad --keys, expected kid:<64 hex>[,...]\n");
+        return 2;
+    }
+    g_sim.policy.keys = &g_sim.keys;
+    g_sim.policy.legacy_sig = legacy;
+    g_sim.policy.zone = zone[0];
+    g_sim.policy.skew_s = 120;
+    g_sim.policy.allow = nullptr;
+
+    tick_clocks();
+    gate_show_waiting();
+    int listen_fd = listen_on(port);
+    std::vector<Conn> conns(MAX_CLIENTS);
+
+    for (;;) {
+        std::vector<pollfd> pfds = {{listen_fd, POLLIN, 0}};
+        for (Conn &c : conns) {
+            if (c.fd >= 0) pfds.push_back({c.fd, POLLIN, 0});
+        }
+        int timeout = 1000;
+        if (g_sim.st != GATE_IDLE) {
+            timeout = int(std::max<int64_t>(0, std::min<int64_t>(timeout, g_sim.deadline_ms - g_hal.now_ms)));
+        }
+        poll(pfds.data(), pfds.size(), timeout);
+        tick_clocks();
+
+        if (pfds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            Conn *slot = nullptr;
+            for (Conn &c : conns) {
+                if (c.fd < 0) { slot = &c; break; }
+            }
+            if (!slot) {
+                close(fd);      // same as the board: TCP_MAX_CLIENTS, then refused
+            } else if (fd >= 0) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                slot->fd = fd;
+                qr_link_reset(&slot->link);
+            }
+        }
+        for (size_t i = 1; i < pfds.size(); i++) {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            for (Conn &c : conns) {
+                if (c.fd != pfds[i].fd) continue;
+                size_t room;
+                char *dst = qr_link_space(&c.link, &room);
+                ssize_t r = recv(c.fd, dst, room, 0);
+                if (r <= 0) {
+                    close(c.fd);
+                    c.fd = -1;
+                } else {
+                    qr_link_commit(&c.link, size_t(r), on_line, &c);
+                }
+            }
+        }
+        gate_run();
+    }
+}
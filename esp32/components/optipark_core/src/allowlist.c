@@ -0,0 +1,146 @@
+/* @file  allowlist.c
+   @brief active reservations of this gate's zone, pushed by the backend over
+          MQTT, for local admission decisions
+*/
+
+#include <string.h>
+#include "allowlist.h"
+
+#define ALLOW_MARKER 0xB1
+
+enum { SLOT_EMPTY = 0, SLOT_USED, SLOT_TOMB };
+
+static uint32_t rd_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t rd_u64(const uint8_t *p)
+{
+    return (uint64_t)rd_u32(p) | ((uint64_t)rd_u32(p + 4) << 32);
+}
+
+// ids are HMAC output, so the low bits are already uniform.
+static unsigned home(uint64_t id)
+{
+    return (unsigned)id & (ALLOW_SLOTS - 1);
+}
+
+static int find(const allowlist_t *a, uint64_t id)
+{
+    unsigned i = home(id);
+    for (int n = 0; n < ALLOW_SLOTS; n++, i = (i + 1) & (ALLOW_SLOTS - 1)) {
+        if (a->state[i] == SLOT_EMPTY) return -1;
+        if (a->state[i] == SLOT_USED && a->id[i] == id) return (int)i;
+    }
+    return -1;
+}
+
+static void add(allowlist_t *a, uint64_t id, uint32_t exp)
+{
+    int at = find(a, id);
+    if (at >= 0) {
+        a->exp[at] = exp;
+        return;
+    }
+    if (a->count >= ALLOW_MAX) {
+        a->partial = true;
+        return;
+    }
+    unsigned i = home(id);
+    while (a->state[i] == SLOT_USED) i = (i + 1) & (ALLOW_SLOTS - 1);
+    if (a->state[i] == SLOT_TOMB) a->tombs--;
+    a->state[i] = SLOT_USED;
+    a->id[i] = id;
+    a->exp[i] = exp;
+    a->count++;
+}
+
+static void del(allowlist_t *a, uint64_t id)
+{
+    int at = find(a, id);
+    if (at < 0) return;
+    a->state[at] = SLOT_TOMB;
+    a->count--;
+    a->tombs++;
+}
+
+static void clear(allowlist_t *a)
+{
+    memset(a->state, SLOT_EMPTY, sizeof(a->state));
+    a->count = 0;
+    a->tombs = 0;
+    a->partial = false;
+}
+
+void allowlist_init(allowlist_t *a)
+{
+    memset(a, 0, sizeof(*a));
+}
+
+static bool apply_snapshot(allowlist_t *a, const uint8_t *p, size_t len)
+{
+    if (len < 7) return false;
+    uint32_t seq = rd_u32(p);
+    uint8_t flags = p[4];
+    uint16_t n = (uint16_t)(p[5] | (p[6] << 8));
+    if (len != 7 + (size_t)n * ALLOW_ENTRY_LEN) return false;
+
+    // Always taken, even with a lower seq: the backend restarted, or this is
+    // the retained copy after a reconnect and may miss newer adds.
+    bool stale = a->loaded && (int32_t)(seq - a->seq) < 0;
+    clear(a);
+    p += 7;
+    for (uint16_t k = 0; k < n; k++, p += ALLOW_ENTRY_LEN) add(a, rd_u64(p), rd_u32(p + 8));
+    if ((flags & ALLOW_SNAP_TRUNCATED) || stale) a->partial = true;
+    a->seq = seq;
+    a->loaded = true;
+    return true;
+}
+
+static bool apply_delta(allowlist_t *a, const uint8_t *p, size_t len)
+{
+    if (len < 5) return false;
+    uint32_t seq = rd_u32(p);
+    uint8_t n = p[4];
+    if (len != 5 + (size_t)n * ALLOW_DELTA_OP_LEN) return false;
+
+    // Before the first snapshot there is nothing to apply it to.
+    if (!a->loaded || (int32_t)(seq - a->seq) <= 0) return false;
+    if (seq != a->seq + 1) {
+        a->gaps++;
+        a->partial = true;
+    }
+    a->seq = seq;
+
+    p += 5;
+    for (uint8_t k = 0; k < n; k++, p += ALLOW_DELTA_OP_LEN) {
+        uint64_t id = rd_u64(p + 1);
+        if (p[0]) add(a, id, rd_u32(p + 9));
+        else del(a, id);
+    }
+    return true;
+}
+
+bool allowlist_apply(allowlist_t *a, const uint8_t *msg, size_t len)
+{
+    if (!msg || len < 2 || msg[0] != ALLOW_MARKER) return false;
+    switch (msg[1]) {
+    case ALLOW_MSG_SNAPSHOT: return apply_snapshot(a, msg + 2, len - 2);
+    case ALLOW_MSG_DELTA:    return apply_delta(a, msg + 2, len - 2);
+    default:                 return false;
+    }
+}
+
+uint64_t allowlist_id(const uint8_t *tag)
+{
+    return rd_u64(tag);
+}
+
+allow_result_t allowlist_check(const allowlist_t *a, uint64_t id, int64_t now_s)
+{
+    if (!a->loaded) return ALLOW_UNKNOWN;
+    int at = find(a, id);
+    if (at >= 0 && (now_s <= 0 || (int64_t)a->exp[at] >= now_s)) return ALLOW_YES;
+    return a->partial ? ALLOW_UNKNOWN : ALLOW_NO;
+}
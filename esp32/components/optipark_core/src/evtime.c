@@ -0,0 +1,63 @@
+/* @file  evtime.c
+   @brief event timestamps: wall clock (SNTP) when synced, uptime otherwise
+*/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "evtime.h"
+#include "opk_hal.h"
+
+evtime_t evtime_at(int64_t uptime_ms)
+{
+    evtime_t t = { .ms = uptime_ms, .epoch = false, .sync_age_s = -1 };
+    int64_t wall = hal_epoch_ms();
+    if (wall > 0 && uptime_ms >= 0) {
+        // Same offset as now: the two clocks do not drift apart measurably
+        // over the few minutes an event can wait in the outbox.
+        t.ms = wall - (hal_now_ms() - uptime_ms);
+        t.epoch = true;
+        t.sync_age_s = hal_clock_sync_age_s();
+    }
+    return t;
+}
+
+// Days since 1970-01-01 to y/m/d (proleptic Gregorian, H. Hinnant's civil_from_days).
+static void civil_from_days(int64_t z, int *y, int *m, int *d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    *d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = (int)(yoe + era * 400 + (*m <= 2));
+}
+
+size_t evtime_iso(int64_t epoch_ms, char *buf, size_t cap)
+{
+    if (epoch_ms < 0) return 0;
+    int64_t s = epoch_ms / 1000;
+    int64_t days = s / 86400;
+    int sod = (int)(s % 86400);
+    int y, m, d;
+    civil_from_days(days, &y, &m, &d);
+    int n = snprintf(buf, cap, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                     y, m, d, sod / 3600, (sod / 60) % 60, sod % 60, (int)(epoch_ms % 1000));
+    return (n < 0 || (size_t)n >= cap) ? 0 : (size_t)n;
+}
+
+int evtime_json(const evtime_t *t, char *buf, size_t cap)
+{
+    if (t->ms < 0) {
+        if (cap) buf[0] = 0;
+        return 0;
+    }
+    if (!t->epoch) return snprintf(buf, cap, ",\"ts_ms\":%" PRId64, t->ms);
+
+    char iso[32];
+    evtime_iso(t->ms, iso, sizeof(iso));
+    if (t->sync_age_s < 0) return snprintf(buf, cap, ",\"sent_at\":\"%s\"", iso);
+    return snprintf(buf, cap, ",\"sent_at\":\"%s\",\"sync_age_s\":%d", iso, t->sync_age_s);
+}
@@ -0,0 +1,73 @@
+/* @file  gate.c
+   @brief gate servo + screen state machine
+*/
+
+#include "gate.h"
+#include "opk_hal.h"
+
+void gate_show_waiting(void)
+{
+    hal_lcd_show("OPTIPARK", "Waiting...");
+}
+
+static void show_wrong_parking(const gate_cfg_t *cfg, const char *zone)
+{
+    if (zone && zone[0] == 'B') hal_lcd_message("OPTIPARK", "Go to parking B", cfg->wrong_ms);
+    else hal_lcd_message("OPTIPARK", "Wrong parking", cfg->wrong_ms);
+}
+
+static void show_name(const char *name)
+{
+    hal_lcd_show("OPTIPARK", (name && name[0]) ? name : "User");
+}
+
+gate_state_t gate_start(const gate_cfg_t *cfg, const gate_req_t *req, int64_t *deadline_ms)
+{
+    // A timed message falls back to the base screen, which may still show the
+    // previous driver's name when this request was queued behind an opening.
+    if (req->kind != GATE_REQ_OPEN) gate_show_waiting();
+    switch (req->kind) {
+    case GATE_REQ_OPEN:
+        hal_lcd_show("OPTIPARK", "Welcome");
+        *deadline_ms = hal_now_ms() + cfg->welcome_ms;
+        return GATE_WELCOME;
+    // Timed messages: the display falls back to "Waiting..." by itself. The next
+    // scan replaces the message right away, either with its own message or with
+    // "Welcome" (a base screen cancels the timed message).
+    case GATE_REQ_WRONG_ZONE:
+        show_wrong_parking(cfg, req->zone);
+        return GATE_IDLE;
+    case GATE_REQ_EXPIRED:
+        hal_lcd_message("OPTIPARK", "QR expired", cfg->invalid_ms);
+        return GATE_IDLE;
+    case GATE_REQ_USED:
+        hal_lcd_message("OPTIPARK", "QR already used", cfg->invalid_ms);
+        return GATE_IDLE;
+    case GATE_REQ_NOT_BOOKED:
+        hal_lcd_message("OPTIPARK", "No reservation", cfg->invalid_ms);
+        return GATE_IDLE;
+    case GATE_REQ_INVALID:
+    default:
+        hal_lcd_message("OPTIPARK", "Invalid QR", cfg->invalid_ms);
+        return GATE_IDLE;
+    }
+}
+
+gate_state_t gate_advance(const gate_cfg_t *cfg, gate_state_t st, const gate_req_t *req,
+                          bool more_queued, int64_t *deadline_ms)
+{
+    switch (st) {
+    case GATE_WELCOME:
+        show_name(req->name);
+        hal_servo_set_angle(cfg->open_deg);
+        *deadline_ms = hal_now_ms() + cfg->open_ms;
+        return GATE_OPEN;
+    case GATE_OPEN:
+        hal_servo_set_angle(cfg->close_deg);
+        break;
+    default:
+        break;
+    }
+    if (!more_queued) gate_show_waiting();
+    return GATE_IDLE;
+}
@@ -0,0 +1,137 @@
+/* @file  occupancy.c
+   @brief per-spot occupancy state: debouncing, change-only publish decisions
+          and the per-slot publish rate limit
+*/
+
+#include <string.h>
+#include "occupancy.h"
+#include "opk_hal.h"
+
+void occupancy_init(occupancy_t *o, int count, bool batch, bool on_change_only)
+{
+    memset(o, 0, sizeof(*o));
+    o->count = (count > MAX_SPOTS) ? MAX_SPOTS : count;
+    o->batch = batch;
+    o->on_change_only = on_change_only;
+}
+
+uint64_t occupancy_bitmap(const occupancy_t *o)
+{
+    uint64_t occ = 0;
+    for (int i = 0; i < o->count; i++) if (o->occ[i]) occ |= (1ULL << i);
+    return occ;
+}
+
+uint64_t occupancy_published_bitmap(const occupancy_t *o)
+{
+    uint64_t occ = 0;
+    for (int i = 0; i < o->count; i++) if (o->prev[i]) occ |= (1ULL << i);
+    return occ;
+}
+
+int occupancy_count_free(const occupancy_t *o)
+{
+    int n = 0;
+    for (int i = 0; i < o->count; i++) if (!o->occ[i]) n++;
+    return n;
+}
+
+// Cost per sample is constant; only spots that flipped are visited.
+uint64_t occupancy_scan(occupancy_t *o, uint64_t sample)
+{
+    uint64_t diff = sample ^ o->scan_state;
+    o->ct1 = (o->ct1 ^ o->ct0) & diff;
+    o->ct0 = ~o->ct0 & diff;
+    uint64_t flip = o->ct1 & o->ct0;
+    o->ct0 &= ~flip;
+    o->ct1 &= ~flip;
+    o->scan_state ^= flip;
+
+    for (uint64_t m = flip; m; m &= m - 1) {
+        int i = __builtin_ctzll(m);
+        o->occ[i] = (o->scan_state >> i) & 1;
+    }
+    return flip;
+}
+
+bool occupancy_confirm_pin(occupancy_t *o, int i, int pin, bool active_low)
+{
+    bool occ = hal_gpio_get(pin) != active_low;
+    if (occ == o->occ[i]) return false;
+    o->occ[i] = occ;
+    return true;
+}
+
+void occupancy_set_rate_limit(occupancy_t *o, int burst, uint32_t window_ms)
+{
+    bool on = (burst > 0 && window_ms > 0);
+    o->rl_burst = on ? burst : 0;
+    o->rl_interval_ms = on ? window_ms / (uint32_t)burst : 0;
+    if (on && !o->rl_interval_ms) o->rl_interval_ms = 1;
+    memset(o->rl_tat, 0, sizeof(o->rl_tat));
+    o->held = 0;
+}
+
+// Token bucket of rl_burst tokens, one back every rl_interval_ms. rl_tat[i]
+// is when the bucket would be full again; a token is free while that is at
+// most (burst - 1) intervals ahead.
+static int64_t rl_ready_ms(const occupancy_t *o, int i)
+{
+    return o->rl_tat[i] - (int64_t)(o->rl_burst - 1) * o->rl_interval_ms;
+}
+
+static bool rl_take(occupancy_t *o, int i)
+{
+    if (!o->rl_burst) return true;
+    int64_t now = hal_now_ms();
+    if (now < rl_ready_ms(o, i)) return false;
+    o->rl_tat[i] = ((o->rl_tat[i] > now) ? o->rl_tat[i] : now) + o->rl_interval_ms;
+    return true;
+}
+
+static void count_suppressed(occupancy_t *o, int i, int n)
+{
+    o->suppressed[i] = (o->suppressed[i] > UINT16_MAX - n) ? UINT16_MAX : o->suppressed[i] + n;
+}
+
+occ_pub_t occupancy_publish_decide(occupancy_t *o, int i, bool online, bool backlog)
+{
+    uint64_t bit = 1ULL << i;
+    bool changed = (o->occ[i] != o->prev[i]);
+    if (!changed && (o->held & bit)) {
+        // Flipped back while held: both transitions are coalesced away.
+        o->held &= ~bit;
+        count_suppressed(o, i, 2);
+    }
+    if (!changed && (o->on_change_only || o->batch)) return OCC_PUB_NONE;
+    if (changed && !rl_take(o, i)) {
+        o->held |= bit;
+        return OCC_PUB_HELD;
+    }
+    o->held &= ~bit;
+    o->prev[i] = o->occ[i];
+
+    if (!online || backlog) return changed ? OCC_PUB_OUTBOX : OCC_PUB_NONE;
+    if (o->batch) {
+        o->chg |= bit;
+        return OCC_PUB_BATCH;
+    }
+    return changed ? OCC_PUB_NOW : OCC_PUB_REFRESH;
+}
+
+int64_t occupancy_next_release_ms(const occupancy_t *o)
+{
+    int64_t next = INT64_MAX;
+    for (uint64_t m = o->held; m; m &= m - 1) {
+        int64_t at = rl_ready_ms(o, __builtin_ctzll(m));
+        if (at < next) next = at;
+    }
+    return next;
+}
+
+void occupancy_snapshot_sent(occupancy_t *o)
+{
+    memcpy(o->prev, o->occ, sizeof(o->prev));
+    o->chg = 0;
+    o->held = 0;
+}
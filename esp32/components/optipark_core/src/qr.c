@@ -0,0 +1,225 @@
+/* @file  qr.c
+   @brief gate QR tokens: signed v2 verification, legacy parsing, repeat and
+          replay filtering
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "qr.h"
+#include "opk_hal.h"
+
+#define QR_TAG_B64_LEN  22      // base64url of QR_TAG_LEN bytes, no padding
+
+bool qr_parse(const char *in, const char *signature,
+              char *out_name, size_t out_name_sz,
+              char *out_zone, size_t out_zone_sz)
+{
+    // OPK_V1_20JA02|OPTIPARK:A-1:Name
+    if (!in || !signature || !out_name || !out_zone) return false;
+
+    const char *p1 = strchr(in, '|');
+    if (!p1) return false;
+
+    size_t sig_len = (size_t)(p1 - in);
+    if (sig_len == 0 || sig_len != strlen(signature)) return false;
+    if (memcmp(in, signature, sig_len) != 0) return false;
+
+    const char *rest = p1 + 1; // OPTIPARK:A-1:Name
+    const char *c1 = strchr(rest, ':');
+    if (!c1) return false;
+    if (c1 - rest != 8 || strncmp(rest, "OPTIPARK", 8) != 0) return false;
+
+    const char *zone_ptr = c1 + 1;
+    const char *zone_end = strchr(zone_ptr, '-');
+    if (!zone_end) return false;
+
+    size_t zone_len = (size_t)(zone_end - zone_ptr);
+    if (zone_len == 0 || zone_len >= out_zone_sz) return false;
+
+    const char *last_colon = strrchr(in, ':');
+    if (!last_colon) return false;
+    const char *name_ptr = last_colon + 1;
+    if (*name_ptr == 0) return false;
+
+    memcpy(out_zone, zone_ptr, zone_len);
+    out_zone[zone_len] = 0;
+    snprintf(out_name, out_name_sz, "%s", name_ptr);
+    return true;
+}
+
+bool qr_ct_equal(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    volatile uint8_t diff = 0;
+    for (size_t i = 0; i < n; i++) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+static int b64url_val(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+// Exactly QR_TAG_B64_LEN chars -> QR_TAG_LEN bytes; unused low bits must be
+// zero so one tag has one spelling.
+static bool tag_decode(const char *s, size_t len, uint8_t *out)
+{
+    if (len != QR_TAG_B64_LEN) return false;
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        int v = b64url_val(s[i]);
+        if (v < 0) return false;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    return n == QR_TAG_LEN && (acc & ((1u << bits) - 1)) == 0;
+}
+
+// Decimal field [s, end) into *out; no sign, no leading garbage.
+static bool parse_uint(const char *s, const char *end, int max_digits, int64_t *out)
+{
+    if (end <= s || end - s > max_digits) return false;
+    int64_t v = 0;
+    for (const char *p = s; p < end; p++) {
+        if (*p < '0' || *p > '9') return false;
+        v = v * 10 + (*p - '0');
+    }
+    *out = v;
+    return true;
+}
+
+static const qr_key_t *keyring_find(const qr_keyring_t *keys, int64_t kid)
+{
+    if (!keys) return NULL;
+    for (int i = 0; i < keys->count && i < QR_MAX_KEYS; i++) {
+        if (keys->key[i].kid == kid) return &keys->key[i];
+    }
+    return NULL;
+}
+
+qr_result_t qr_verify(const char *in, const qr_keyring_t *keys, int64_t now_s, int skew_s,
+                      qr_token_t *out)
+{
+    const size_t plen = sizeof(QR_V2_PREFIX) - 1;
+    if (!in || strncmp(in, QR_V2_PREFIX, plen) != 0) return QR_INVALID;
+
+    // OPK2|kid|slot|exp|user|tag
+    const char *f_kid = in + plen;
+    const char *f_slot = strchr(f_kid, '|');
+    if (!f_slot++) return QR_INVALID;
+    const char *f_exp = strchr(f_slot, '|');
+    if (!f_exp++) return QR_INVALID;
+    const char *f_user = strchr(f_exp, '|');
+    if (!f_user++) return QR_INVALID;
+    const char *f_tag = strrchr(f_user, '|');
+    if (!f_tag++) return QR_INVALID;
+
+    int64_t kid, exp;
+    if (!parse_uint(f_kid, f_slot - 1, 3, &kid) || kid > 255) return QR_INVALID;
+    if (!parse_uint(f_exp, f_user - 1, 12, &exp)) return QR_INVALID;
+
+    size_t slot_len = (size_t)(f_exp - 1 - f_slot);
+    const char *dash = memchr(f_slot, '-', slot_len);
+    if (slot_len == 0 || slot_len >= QR_SLOT_LEN || !dash) return QR_INVALID;
+    size_t zone_len = (size_t)(dash - f_slot);
+    if (zone_len == 0 || zone_len >= QR_ZONE_LEN) return QR_INVALID;
+
+    size_t user_len = (size_t)(f_tag - 1 - f_user);
+    if (user_len == 0) return QR_INVALID;
+
+    uint8_t tag[QR_TAG_LEN];
+    if (!tag_decode(f_tag, strlen(f_tag), tag)) return QR_INVALID;
+
+    const qr_key_t *k = keyring_find(keys, kid);
+    if (!k) return QR_BAD_TAG;
+
+    uint8_t mac[32];
+    if (!hal_hmac_sha256(k->key, QR_KEY_LEN, in, (size_t)(f_tag - 1 - in), mac)) return QR_BAD_TAG;
+    if (!qr_ct_equal(mac, tag, QR_TAG_LEN)) return QR_BAD_TAG;
+
+    if (now_s <= 0) return QR_NO_CLOCK;
+    if (now_s > exp + skew_s) return QR_EXPIRED;
+
+    memcpy(out->slot, f_slot, slot_len);
+    out->slot[slot_len] = 0;
+    memcpy(out->zone, f_slot, zone_len);
+    out->zone[zone_len] = 0;
+    snprintf(out->name, sizeof(out->name), "%.*s", (int)user_len, f_user);
+    out->exp = exp;
+    memcpy(out->tag, tag, QR_TAG_LEN);
+    return QR_OPEN;
+}
+
+// Remember an opened token until it expires; a second use is a replay.
+static bool replay_check_and_mark(qr_filter_t *f, const qr_token_t *t, int64_t now_s, int skew_s)
+{
+    int slot = -1;
+    for (int i = 0; i < QR_USED_MAX; i++) {
+        qr_used_t *u = &f->used[i];
+        bool live = u->exp && now_s <= u->exp + skew_s;
+        if (live && memcmp(u->tag, t->tag, sizeof(u->tag)) == 0) return false;
+        if (!live && slot < 0) slot = i;
+    }
+    if (slot < 0) {
+        // All live: evict round-robin.
+        slot = f->used_next;
+        f->used_next = (f->used_next + 1) % QR_USED_MAX;
+    }
+    memcpy(f->used[slot].tag, t->tag, sizeof(f->used[slot].tag));
+    f->used[slot].exp = t->exp;
+    return true;
+}
+
+qr_result_t qr_check(qr_filter_t *f, const char *payload, const qr_policy_t *p, qr_token_t *out)
+{
+    if (!payload || payload[0] == 0) return QR_IGNORE;
+
+    if (strncmp(payload, f->last, sizeof(f->last)) == 0) return QR_IGNORE;
+    strncpy(f->last, payload, sizeof(f->last) - 1);
+
+    memset(out, 0, sizeof(*out));
+    int64_t now_s = 0;
+    if (strncmp(payload, QR_V2_PREFIX, sizeof(QR_V2_PREFIX) - 1) == 0) {
+        now_s = hal_epoch_s();
+        qr_result_t r = qr_verify(payload, p->keys, now_s, p->skew_s, out);
+        if (r != QR_OPEN) return r;
+    } else if (!p->legacy_sig ||
+               !qr_parse(payload, p->legacy_sig, out->name, sizeof(out->name), out->zone, sizeof(out->zone))) {
+        return QR_INVALID;
+    }
+
+    if (out->zone[0] != p->zone) return QR_WRONG_ZONE;
+    // Before the replay mark, so a refused token is not burnt.
+    if (out->exp && p->allow &&
+        allowlist_check(p->allow, allowlist_id(out->tag), now_s - p->skew_s) == ALLOW_NO) {
+        return QR_NOT_BOOKED;
+    }
+    if (out->exp && !replay_check_and_mark(f, out, now_s, p->skew_s)) return QR_REPLAY;
+    return QR_OPEN;
+}
+
+const char *qr_result_str(qr_result_t r)
+{
+    switch (r) {
+    case QR_OPEN:       return "open";
+    case QR_INVALID:    return "invalid";
+    case QR_WRONG_ZONE: return "wrong zone";
+    case QR_IGNORE:     return "ignored";
+    case QR_BAD_TAG:    return "bad signature";
+    case QR_EXPIRED:    return "expired";
+    case QR_NO_CLOCK:   return "clock not synced";
+    case QR_REPLAY:     return "already used";
+    case QR_NOT_BOOKED: return "no reservation";
+    default:            return "?";
+    }
+}
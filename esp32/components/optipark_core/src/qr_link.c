@@ -0,0 +1,76 @@
+/* @file  qr_link.c
+   @brief camera QR link: line framing of the TCP stream and the decision
+          line echoed back for each scan
+*/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "qr_link.h"
+
+void qr_link_reset(qr_link_t *l)
+{
+    memset(l, 0, sizeof(*l));
+}
+
+char *qr_link_space(qr_link_t *l, size_t *room)
+{
+    uint16_t tail = (uint16_t)((l->head + l->len) % QR_LINK_BUF_SIZE);
+    *room = (tail >= l->head && l->len < QR_LINK_BUF_SIZE)
+            ? (size_t)(QR_LINK_BUF_SIZE - tail)
+            : (size_t)(l->head - tail);
+    return l->buf + tail;
+}
+
+void qr_link_commit(qr_link_t *l, size_t n, qr_line_fn on_line, void *ctx)
+{
+    l->len = (uint16_t)(l->len + n);
+
+    while (l->len > 0) {
+        int nl = -1;
+        for (int k = 0; k < l->len; k++) {
+            if (l->buf[(l->head + k) % QR_LINK_BUF_SIZE] == '\n') { nl = k; break; }
+        }
+
+        if (nl < 0) {
+            if (l->discarding) {
+                l->head = 0;
+                l->len = 0;
+            } else if (l->len == QR_LINK_BUF_SIZE) {
+                l->discarding = true;
+                l->head = 0;
+                l->len = 0;
+                l->seq++;
+                on_line(ctx, NULL, 0);
+            }
+            return;
+        }
+
+        char line[QR_LINK_BUF_SIZE];
+        int len = 0;
+        for (int k = 0; k < nl; k++) {
+            char ch = l->buf[(l->head + k) % QR_LINK_BUF_SIZE];
+            if (ch != '\r') line[len++] = ch;
+        }
+        while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) len--;
+        line[len] = 0;
+        l->head = (uint16_t)((l->head + nl + 1) % QR_LINK_BUF_SIZE);
+        l->len = (uint16_t)(l->len - (nl + 1));
+
+        if (l->discarding) {
+            l->discarding = false;   // tail of the overlong line
+            continue;
+        }
+        l->seq++;
+        on_line(ctx, line, len);
+    }
+}
+
+int qr_decision_format(char *out, size_t cap, uint32_t seq, int64_t t_ms, uint32_t decide_us,
+                       const char *gate, const char *result)
+{
+    int n = snprintf(out, cap, QR_DECISION_PREFIX "%" PRIu32 " %" PRId64 " %" PRIu32 " %s %s\n",
+                     seq, t_ms, decide_us, gate, result);
+    if (n < 0) return 0;
+    return (n < (int)cap) ? n : (int)cap - 1;
+}
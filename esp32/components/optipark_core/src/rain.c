@@ -0,0 +1,97 @@
+/* @file  rain.c
+   @brief rain percentage from the analog sensor: scaling, IIR filter,
+          hysteresis and rate-limited publishing
+*/
+
+#include <stdio.h>
+#include "rain.h"
+#include "opk_hal.h"
+#include "evtime.h"
+#include "wire_format.h"
+
+static inline int clampi(int x, int a, int b)
+{
+    if (x < a) return a;
+    if (x > b) return b;
+    return x;
+}
+
+void rain_init(rain_t *r, const rain_cfg_t *cfg)
+{
+    r->cfg = cfg;
+    r->pct_q8 = -1;
+    r->pct = 0;
+    r->pct_pub = -1;
+    r->pub_ms = 0;
+    r->raw = 0;
+    r->mv = -1;
+}
+
+int rain_pct_from_reading(const rain_cfg_t *cfg, int raw, int mv)
+{
+    if (mv >= 0) {
+        mv = clampi(mv, cfg->wet_mv, cfg->dry_mv);
+        return (100 * (cfg->dry_mv - mv)) / (cfg->dry_mv - cfg->wet_mv);
+    }
+    raw = clampi(raw, cfg->wet_raw, cfg->dry_raw);
+    return (100 * (cfg->dry_raw - raw)) / (cfg->dry_raw - cfg->wet_raw);
+}
+
+bool rain_feed(rain_t *r, int pct, int64_t now_ms)
+{
+    const rain_cfg_t *cfg = r->cfg;
+
+    // Integer IIR on percent * 256; the first reading primes it.
+    int x = pct << 8;
+    if (r->pct_q8 < 0) r->pct_q8 = x;
+    else r->pct_q8 += (x - r->pct_q8) / (1 << cfg->iir_shift);
+    r->pct = (r->pct_q8 + 128) >> 8;
+
+    // Hysteresis + rate limit. The first value goes out at once, and the end
+    // points are always reached. pct_pub only advances on a successful
+    // publish, so a value missed while offline is retried.
+    if (r->pct_pub < 0) return true;
+    if (now_ms - r->pub_ms < cfg->min_publish_ms) return false;
+
+    int moved = r->pct - r->pct_pub;
+    if (moved < 0) moved = -moved;
+    return moved >= cfg->hysteresis_pct
+        || (moved > 0 && (r->pct == 0 || r->pct == 100))
+        || !cfg->on_change_only;
+}
+
+static bool rain_publish(rain_t *r, int64_t now_ms)
+{
+    const rain_cfg_t *cfg = r->cfg;
+
+    evtime_t ts = evtime_at(now_ms);
+
+    if (cfg->binary) {
+        uint8_t payload[WIRE_RAIN_MAX_LEN];
+        size_t len = wire_encode_rain(payload, sizeof(payload), cfg->sensor_id, (uint8_t)r->pct, r->raw, &ts);
+        if (len == 0) return false;
+        return hal_mqtt_publish(cfg->topic, payload, len, cfg->qos, cfg->retain);
+    }
+
+    char payload[160];
+    int n = snprintf(payload, sizeof(payload),
+                     "{\"sensor_id\":\"%s\",\"rain_pct\":%d,\"raw\":%d",
+                     cfg->sensor_id, r->pct, r->raw);
+    if (n > 0 && n < (int)sizeof(payload)) n += evtime_json(&ts, payload + n, sizeof(payload) - n);
+    if (n > 0 && n < (int)sizeof(payload)) n += snprintf(payload + n, sizeof(payload) - n, "}");
+    if (n < 0 || n >= (int)sizeof(payload)) return false;
+    return hal_mqtt_publish(cfg->topic, payload, (size_t)n, cfg->qos, cfg->retain);
+}
+
+bool rain_poll(rain_t *r)
+{
+    if (!hal_adc_read(r->cfg->adc_ch, &r->raw, &r->mv)) return false;
+
+    int64_t t = hal_now_ms();
+    if (!rain_feed(r, rain_pct_from_reading(r->cfg, r->raw, r->mv), t)) return false;
+    if (!rain_publish(r, t)) return false;
+
+    r->pct_pub = r->pct;
+    r->pub_ms = t;
+    return true;
+}
@@ -0,0 +1,115 @@
+/* @file  wire_format.c
+   @brief compact binary encoding of OptiPark sensor events (v2)
+*/
+
+#include <string.h>
+#include "wire_format.h"
+
+typedef struct {
+    uint8_t *p;
+    size_t cap;
+    size_t n;
+    bool overflow;
+} wire_writer_t;
+
+static void put_u8(wire_writer_t *w, uint8_t v)
+{
+    if (w->n + 1 > w->cap) { w->overflow = true; return; }
+    w->p[w->n++] = v;
+}
+
+// little-endian, width in bytes
+static void put_le(wire_writer_t *w, uint64_t v, int width)
+{
+    for (int i = 0; i < width; i++) put_u8(w, (uint8_t)(v >> (8 * i)));
+}
+
+static void put_str(wire_writer_t *w, const char *s)
+{
+    size_t len = s ? strlen(s) : 0;
+    if (len > 255 || w->n + 1 + len > w->cap) { w->overflow = true; return; }
+    w->p[w->n++] = (uint8_t)len;
+    memcpy(w->p + w->n, s, len);
+    w->n += len;
+}
+
+static size_t wire_done(const wire_writer_t *w)
+{
+    return w->overflow ? 0 : w->n;
+}
+
+static bool has_ts(const evtime_t *ts)
+{
+    return ts && ts->ms >= 0;
+}
+
+static bool has_sync(const evtime_t *ts)
+{
+    return has_ts(ts) && ts->epoch && ts->sync_age_s >= 0;
+}
+
+// saturates below WIRE_SYNC_UNKNOWN, which decoders read as "no age"
+static void put_sync(wire_writer_t *w, const evtime_t *ts)
+{
+    int age = ts->sync_age_s;
+    put_le(w, (uint64_t)(age > 0xFFFE ? 0xFFFE : age), 2);
+}
+
+size_t wire_encode_spot(uint8_t *buf, size_t cap, const char *slot_id, bool occupied,
+                        int battery_mv, const evtime_t *ts)
+{
+    wire_writer_t w = { .p = buf, .cap = cap };
+    uint8_t flags = 0;
+    if (occupied) flags |= WIRE_SPOT_OCCUPIED;
+    if (battery_mv >= 0) flags |= WIRE_SPOT_HAS_BATTERY;
+    if (has_ts(ts)) flags |= WIRE_SPOT_HAS_TS | (ts->epoch ? WIRE_SPOT_TS_EPOCH : 0);
+    if (has_sync(ts)) flags |= WIRE_SPOT_HAS_SYNC;
+
+    put_u8(&w, WIRE_MARKER_V2);
+    put_u8(&w, WIRE_TYPE_SPOT);
+    put_u8(&w, flags);
+    put_str(&w, slot_id);
+    if (battery_mv >= 0) put_le(&w, (uint64_t)(battery_mv > 0xFFFF ? 0xFFFF : battery_mv), 2);
+    if (has_ts(ts)) put_le(&w, (uint64_t)ts->ms, 8);
+    if (has_sync(ts)) put_sync(&w, ts);
+    return wire_done(&w);
+}
+
+size_t wire_encode_rain(uint8_t *buf, size_t cap, const char *sensor_id, uint8_t rain_pct,
+                        int raw, const evtime_t *ts)
+{
+    wire_writer_t w = { .p = buf, .cap = cap };
+    uint8_t flags = 0;
+    if (raw >= 0) flags |= WIRE_RAIN_HAS_RAW;
+    if (has_ts(ts)) flags |= WIRE_RAIN_HAS_TS | (ts->epoch ? WIRE_RAIN_TS_EPOCH : 0);
+    if (has_sync(ts)) flags |= WIRE_RAIN_HAS_SYNC;
+
+    put_u8(&w, WIRE_MARKER_V2);
+    put_u8(&w, WIRE_TYPE_RAIN);
+    put_u8(&w, flags);
+    put_str(&w, sensor_id);
+    put_u8(&w, rain_pct);
+    if (raw >= 0) put_le(&w, (uint64_t)(raw > 0xFFFF ? 0xFFFF : raw), 2);
+    if (has_ts(ts)) put_le(&w, (uint64_t)ts->ms, 8);
+    if (has_sync(ts)) put_sync(&w, ts);
+    return wire_done(&w);
+}
+
+size_t wire_encode_delta(uint8_t *buf, size_t cap, uint32_t seq, uint64_t occ, uint64_t chg,
+                         const evtime_t *ts)
+{
+    wire_writer_t w = { .p = buf, .cap = cap };
+    uint8_t flags = 0;
+    if (has_ts(ts)) flags |= WIRE_DELTA_HAS_TS | (ts->epoch ? WIRE_DELTA_TS_EPOCH : 0);
+    if (has_sync(ts)) flags |= WIRE_DELTA_HAS_SYNC;
+
+    put_u8(&w, WIRE_MARKER_V2);
+    put_u8(&w, WIRE_TYPE_DELTA);
+    put_u8(&w, flags);
+    put_le(&w, seq, 4);
+    put_le(&w, occ, 8);
+    put_le(&w, chg, 8);
+    if (has_ts(ts)) put_le(&w, (uint64_t)ts->ms, 8);
+    if (has_sync(ts)) put_sync(&w, ts);
+    return wire_done(&w);
+}
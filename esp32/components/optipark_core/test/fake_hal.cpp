@@ -0,0 +1,75 @@
+/* @file  fake_hal.cpp
+   @brief host implementation of opk_hal.h that records every call
+*/
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "fake_hal.h"
+#include "opk_hal.h"
+
+FakeHal g_hal;
+
+int64_t hal_now_ms(void)
+{
+    return g_hal.now_ms;
+}
+
+int64_t hal_epoch_s(void)
+{
+    return g_hal.epoch_ms / 1000;
+}
+
+int64_t hal_epoch_ms(void)
+{
+    return g_hal.epoch_ms;
+}
+
+int hal_clock_sync_age_s(void)
+{
+    return g_hal.sync_age_s;
+}
+
+bool hal_gpio_get(int pin)
+{
+    auto it = g_hal.gpio.find(pin);
+    return it != g_hal.gpio.end() && it->second;
+}
+
+bool hal_adc_read(int ch, int *raw, int *mv)
+{
+    auto it = g_hal.adc.find(ch);
+    if (it == g_hal.adc.end() || !it->second.ok) return false;
+    *raw = it->second.raw;
+    *mv = it->second.mv;
+    return true;
+}
+
+bool hal_mqtt_publish(const char *topic, const void *payload, size_t len, int qos, bool retain)
+{
+    if (!g_hal.mqtt_online) return false;
+    g_hal.published.push_back({topic, std::string(static_cast<const char *>(payload), len), qos, retain});
+    return true;
+}
+
+void hal_lcd_show(const char *line0, const char *line1)
+{
+    g_hal.screens.push_back({line0, line1, 0});
+}
+
+void hal_lcd_message(const char *line0, const char *line1, uint32_t hold_ms)
+{
+    g_hal.screens.push_back({line0, line1, hold_ms});
+}
+
+void hal_servo_set_angle(int deg)
+{
+    g_hal.servo.push_back(deg);
+}
+
+bool hal_hmac_sha256(const uint8_t *key, size_t key_len, const void *msg, size_t len, uint8_t out[32])
+{
+    unsigned int out_len = 0;
+    return HMAC(EVP_sha256(), key, (int)key_len, static_cast<const unsigned char *>(msg), len, out, &out_len)
+        && out_len == 32;
+}
@@ -0,0 +1,49 @@
+/* @file  fake_hal.h
+   @brief host implementation of opk_hal.h that records every call
+*/
+
+#ifndef _FAKE_HAL_H_
+#define _FAKE_HAL_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct FakeMessage {
+    std::string topic;
+    std::string payload;
+    int qos;
+    bool retain;
+};
+
+struct FakeScreen {
+    std::string line0;
+    std::string line1;
+    uint32_t hold_ms;   // 0 = base screen
+};
+
+struct FakeAdc {
+    int raw;
+    int mv;
+    bool ok;
+};
+
+struct FakeHal {
+    int64_t now_ms = 0;
+    int64_t epoch_ms = 0;       // wall clock at now_ms, 0 = not synced
+    int sync_age_s = -1;        // -1 = no SNTP sync since boot
+    std::map<int, bool> gpio;
+    std::map<int, FakeAdc> adc;
+    bool mqtt_online = true;
+    std::vector<FakeMessage> published;
+    std::vector<FakeScreen> screens;
+    std::vector<int> servo;     // every angle written, in order
+
+    void reset() { *this = FakeHal(); }
+};
+
+// The state behind the hal_* functions; tests reset it in SetUp().
+extern FakeHal g_hal;
+
+#endif
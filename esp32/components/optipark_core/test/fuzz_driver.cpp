@@ -0,0 +1,74 @@
+// Standalone driver for LLVMFuzzerTestOneInput: mutates a small seed corpus
+// with a fixed seed, so ctest runs are reproducible without libFuzzer.
+//   fuzz_qr_smoke [iterations]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Allowlist snapshot with Alice's A-3 token below, and a delta adding it (allowlist.h).
+static const char SNAP[] = "\xB1\x10\x01\x00\x00\x00\x00\x01\x00"
+                           "\x81\xa7\x3b\xbb\x14\xae\x1a\xa7\x00\xb3\x3f\x71";
+static const char DELTA[] = "\xB1\x11\x02\x00\x00\x00\x01\x01"
+                            "\x81\xa7\x3b\xbb\x14\xae\x1a\xa7\x00\xb3\x3f\x71";
+
+static const std::string SEEDS[] = {
+    "OPK_V1_20JA02|OPTIPARK:A-1:Alice",
+    "OPK_V1_20JA02|OPTIPARK:B-18:Bob",
+    "OPK_V1_20JA02|OPTIPARK:ABCDEFG-1:x",
+    "OPK_V1_20JA02|OPTIPARK:A-1:",
+    "OPK_V1_20JA02|OPTIPARK:-:",
+    "|:-:",
+    "",
+    "OPK2|1|A-3|1900000000|Alice|gac7uxSuGqdIsiUiou8BoQ",
+    "OPK2|1|B-18|1900000000|Bob Martin|CiCOfg0jVJfTGeHvrtro4A",
+    "OPK2|2|A-3|1900000000|Alice|iSBiyDOCowER42p-s32Y6w",
+    std::string(SNAP, sizeof(SNAP) - 1),
+    std::string(DELTA, sizeof(DELTA) - 1),
+};
+
+static const char DICT[] = "|:-OPTIPARK_V120JA2";
+
+int main(int argc, char **argv)
+{
+    long iterations = (argc > 1) ? atol(argv[1]) : 100000;
+    std::mt19937 rng(0x0B1u);
+    const size_t n_seeds = sizeof(SEEDS) / sizeof(SEEDS[0]);
+
+    for (const std::string &s : SEEDS) LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(s.data()), s.size());
+
+    std::string in;
+    for (long it = 0; it < iterations; it++) {
+        if (it % 64 == 0 || in.size() > 512) in = SEEDS[rng() % n_seeds];
+
+        switch (rng() % 5) {
+        case 0:     // flip a byte
+            if (!in.empty()) in[rng() % in.size()] = static_cast<char>(rng());
+            break;
+        case 1:     // insert a structural character
+            in.insert(in.begin() + (in.empty() ? 0 : rng() % (in.size() + 1)), DICT[rng() % (sizeof(DICT) - 1)]);
+            break;
+        case 2:     // delete a byte
+            if (!in.empty()) in.erase(rng() % in.size(), 1);
+            break;
+        case 3:     // duplicate a chunk
+            if (!in.empty()) {
+                size_t at = rng() % in.size();
+                in.insert(at, in.substr(at, 1 + rng() % 32));
+            }
+            break;
+        default:    // splice with another seed
+            in += SEEDS[rng() % n_seeds];
+            break;
+        }
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(in.data()), in.size());
+    }
+    printf("fuzz_qr_smoke: %ld inputs ok\n", iterations);
+    return 0;
+}
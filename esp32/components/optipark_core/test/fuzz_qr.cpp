@@ -0,0 +1,62 @@
+// libFuzzer entry point for the QR rules and the allowlist decoder (-DOPK_LIBFUZZER=ON with clang), also
+// linked into fuzz_qr_smoke by fuzz_driver.cpp.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "allowlist.h"
+#include "fake_hal.h"
+#include "qr.h"
+
+static qr_keyring_t fuzz_keys()
+{
+    qr_keyring_t k{};
+    k.count = 1;
+    k.key[0].kid = 1;
+    for (int i = 0; i < QR_KEY_LEN; i++) k.key[0].key[i] = uint8_t(i);
+    return k;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static const qr_keyring_t keys = fuzz_keys();
+    static qr_filter_t f;
+    static allowlist_t allow;
+    std::string in(reinterpret_cast<const char *>(data), size);   // stops at the first NUL for the C side
+
+    char name[QR_NAME_LEN];
+    char zone[QR_ZONE_LEN];
+    if (qr_parse(in.c_str(), "OPK_V1_20JA02", name, sizeof(name), zone, sizeof(zone))) {
+        if (strlen(name) == 0 || strlen(name) >= sizeof(name)) __builtin_trap();
+        if (strlen(zone) == 0 || strlen(zone) >= sizeof(zone)) __builtin_trap();
+        if (strchr(zone, '-')) __builtin_trap();
+    }
+
+    // Tiny buffers must still be respected.
+    char n1[1];
+    char z2[2];
+    if (qr_parse(in.c_str(), "OPK_V1_20JA02", n1, sizeof(n1), z2, sizeof(z2)) && (n1[0] || strlen(z2) != 1)) {
+        __builtin_trap();
+    }
+
+    qr_token_t t;
+    if (qr_verify(in.c_str(), &keys, 1800000000, 60, &t) == QR_OPEN) {
+        if (strlen(t.slot) == 0 || strlen(t.zone) == 0 || strlen(t.name) == 0) __builtin_trap();
+        if (strncmp(t.slot, t.zone, strlen(t.zone)) != 0) __builtin_trap();
+        if (t.exp + 60 < 1800000000) __builtin_trap();
+    }
+
+    // The same bytes as an MQTT allowlist message; the table must stay consistent.
+    if (allowlist_apply(&allow, data, size)) {
+        int used = 0;
+        for (int i = 0; i < ALLOW_SLOTS; i++) used += (allow.state[i] == 1);
+        if (used != allow.count || allow.count > ALLOW_MAX) __builtin_trap();
+    }
+
+    g_hal.epoch_ms = 1800000000000LL;
+    const qr_policy_t policy = { &keys, "OPK_V1_20JA02", 'A', 60, &allow };
+    qr_result_t r = qr_check(&f, in.c_str(), &policy, &t);
+    if (r == QR_OPEN && t.zone[0] != 'A') __builtin_trap();
+    return 0;
+}
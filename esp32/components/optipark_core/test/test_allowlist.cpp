@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+#include "allowlist.h"
+
+namespace {
+
+struct Entry {
+    uint64_t id;
+    uint32_t exp;
+};
+
+void put32(std::vector<uint8_t> &b, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) b.push_back(uint8_t(v >> (8 * i)));
+}
+
+void put64(std::vector<uint8_t> &b, uint64_t v)
+{
+    put32(b, uint32_t(v));
+    put32(b, uint32_t(v >> 32));
+}
+
+std::vector<uint8_t> snapshot(uint32_t seq, const std::vector<Entry> &e, uint8_t flags = 0)
+{
+    std::vector<uint8_t> b = {0xB1, ALLOW_MSG_SNAPSHOT};
+    put32(b, seq);
+    b.push_back(flags);
+    b.push_back(uint8_t(e.size()));
+    b.push_back(uint8_t(e.size() >> 8));
+    for (const Entry &x : e) {
+        put64(b, x.id);
+        put32(b, x.exp);
+    }
+    return b;
+}
+
+std::vector<uint8_t> delta(uint32_t seq, bool add, uint64_t id, uint32_t exp = 0)
+{
+    std::vector<uint8_t> b = {0xB1, ALLOW_MSG_DELTA};
+    put32(b, seq);
+    b.push_back(1);
+    b.push_back(add ? 1 : 0);
+    put64(b, id);
+    put32(b, exp);
+    return b;
+}
+
+const int64_t NOW = 1800000000;
+const uint32_t LATER = 1800003600;
+
+class Allowlist : public ::testing::Test {
+protected:
+    std::unique_ptr<allowlist_t> a{new allowlist_t};
+
+    void SetUp() override { allowlist_init(a.get()); }
+
+    bool apply(const std::vector<uint8_t> &m) { return allowlist_apply(a.get(), m.data(), m.size()); }
+    allow_result_t check(uint64_t id, int64_t now = NOW) { return allowlist_check(a.get(), id, now); }
+};
+
+TEST_F(Allowlist, UnknownUntilFirstSnapshot)
+{
+    EXPECT_EQ(check(1), ALLOW_UNKNOWN);
+    EXPECT_FALSE(apply(delta(1, true, 1, LATER)));
+    EXPECT_EQ(check(1), ALLOW_UNKNOWN);
+
+    ASSERT_TRUE(apply(snapshot(7, {})));
+    EXPECT_EQ(check(1), ALLOW_NO);
+}
+
+TEST_F(Allowlist, SnapshotReplacesEverything)
+{
+    ASSERT_TRUE(apply(snapshot(1, {{10, LATER}, {11, LATER}})));
+    EXPECT_EQ(a->count, 2);
+    EXPECT_EQ(check(10), ALLOW_YES);
+    EXPECT_EQ(check(11), ALLOW_YES);
+
+    ASSERT_TRUE(apply(snapshot(2, {{12, LATER}})));
+    EXPECT_EQ(check(10), ALLOW_NO);
+    EXPECT_EQ(check(12), ALLOW_YES);
+}
+
+TEST_F(Allowlist, DeltasInOrder)
+{
+    ASSERT_TRUE(apply(snapshot(5, {{10, LATER}})));
+    ASSERT_TRUE(apply(delta(6, true, 20, LATER)));
+    ASSERT_TRUE(apply(delta(7, false, 10)));
+    EXPECT_EQ(check(10), ALLOW_NO);
+    EXPECT_EQ(check(20), ALLOW_YES);
+    EXPECT_EQ(a->gaps, 0u);
+
+    EXPECT_FALSE(apply(delta(7, true, 10, LATER)));   // duplicate
+    EXPECT_FALSE(apply(delta(3, true, 10, LATER)));   // older than the snapshot
+    EXPECT_EQ(check(10), ALLOW_NO);
+
+    ASSERT_TRUE(apply(delta(10, true, 30, LATER)));
+    EXPECT_EQ(a->gaps, 1u);
+    EXPECT_EQ(check(30), ALLOW_YES);
+}
+
+TEST_F(Allowlist, GapMakesMissesUnknownUntilSnapshot)
+{
+    ASSERT_TRUE(apply(snapshot(5, {{10, LATER}})));
+    ASSERT_TRUE(apply(delta(8, true, 30, LATER)));    // 6 and 7 lost
+    EXPECT_TRUE(a->partial);
+    EXPECT_EQ(check(30), ALLOW_YES);
+    EXPECT_EQ(check(20), ALLOW_UNKNOWN);              // may have been in a lost delta
+    ASSERT_TRUE(apply(delta(9, true, 40, LATER)));
+    EXPECT_EQ(check(20), ALLOW_UNKNOWN);
+
+    ASSERT_TRUE(apply(snapshot(9, {{10, LATER}, {30, LATER}, {40, LATER}})));
+    EXPECT_FALSE(a->partial);
+    EXPECT_EQ(check(20), ALLOW_NO);
+}
+
+TEST_F(Allowlist, StaleSnapshotMakesMissesUnknown)
+{
+    ASSERT_TRUE(apply(snapshot(5, {{10, LATER}})));
+    ASSERT_TRUE(apply(delta(6, true, 20, LATER)));
+    ASSERT_TRUE(apply(snapshot(6, {{10, LATER}, {20, LATER}})));   // same seq: up to date
+    EXPECT_FALSE(a->partial);
+
+    // Retained snapshot from before the add, replayed on reconnect.
+    ASSERT_TRUE(apply(snapshot(5, {{10, LATER}})));
+    EXPECT_TRUE(a->partial);
+    EXPECT_EQ(check(10), ALLOW_YES);
+    EXPECT_EQ(check(20), ALLOW_UNKNOWN);
+
+    ASSERT_TRUE(apply(snapshot(7, {{10, LATER}, {20, LATER}})));
+    EXPECT_FALSE(a->partial);
+    EXPECT_EQ(check(20), ALLOW_YES);
+    EXPECT_EQ(check(30), ALLOW_NO);
+}
+
+TEST_F(Allowlist, SnapshotAfterBackendRestart)
+{
+    ASSERT_TRUE(apply(snapshot(1000, {{10, LATER}})));
+    ASSERT_TRUE(apply(snapshot(1, {{11, LATER}})));
+    ASSERT_TRUE(apply(delta(2, true, 12, LATER)));
+    EXPECT_EQ(check(12), ALLOW_YES);
+    EXPECT_EQ(check(10), ALLOW_UNKNOWN);              // until the next snapshot
+    ASSERT_TRUE(apply(snapshot(2, {{11, LATER}, {12, LATER}})));
+    EXPECT_EQ(check(10), ALLOW_NO);
+}
+
+TEST_F(Allowlist, ExpiredEntriesDoNotAdmit)
+{
+    ASSERT_TRUE(apply(snapshot(1, {{10, uint32_t(NOW)}})));
+    EXPECT_EQ(check(10, NOW), ALLOW_YES);
+    EXPECT_EQ(check(10, NOW + 1), ALLOW_NO);
+}
+
+TEST_F(Allowlist, CollidingIdsAndTombstones)
+{
+    // Same home slot, so they probe past each other.
+    const uint64_t x = 5, y = 5 + ALLOW_SLOTS, z = 5 + 2 * ALLOW_SLOTS;
+    ASSERT_TRUE(apply(snapshot(1, {{x, LATER}, {y, LATER}, {z, LATER}})));
+    ASSERT_TRUE(apply(delta(2, false, y)));
+    EXPECT_EQ(check(x), ALLOW_YES);
+    EXPECT_EQ(check(y), ALLOW_NO);
+    EXPECT_EQ(check(z), ALLOW_YES);
+    EXPECT_EQ(a->tombs, 1);
+
+    ASSERT_TRUE(apply(delta(3, true, y, LATER)));     // reuses the tombstone
+    EXPECT_EQ(check(y), ALLOW_YES);
+    EXPECT_EQ(a->tombs, 0);
+    EXPECT_EQ(a->count, 3);
+}
+
+TEST_F(Allowlist, FullListMakesMissesUnknown)
+{
+    std::vector<Entry> e;
+    for (uint64_t i = 0; i < ALLOW_MAX; i++) e.push_back({i * 7919, LATER});
+    ASSERT_TRUE(apply(snapshot(1, e)));
+    EXPECT_EQ(check(3), ALLOW_NO);
+    EXPECT_FALSE(a->partial);
+
+    ASSERT_TRUE(apply(delta(2, true, 3, LATER)));
+    EXPECT_TRUE(a->partial);
+    EXPECT_EQ(check(3), ALLOW_UNKNOWN);
+    EXPECT_EQ(check(7919), ALLOW_YES);
+
+    ASSERT_TRUE(apply(snapshot(3, {{1, LATER}}, ALLOW_SNAP_TRUNCATED)));
+    EXPECT_EQ(check(2), ALLOW_UNKNOWN);
+}
+
+TEST_F(Allowlist, MalformedMessages)
+{
+    ASSERT_TRUE(apply(snapshot(1, {{10, LATER}})));
+    std::vector<uint8_t> s = snapshot(2, {{11, LATER}});
+    s.pop_back();
+    EXPECT_FALSE(apply(s));
+    std::vector<uint8_t> d = delta(2, true, 11, LATER);
+    d.push_back(0);
+    EXPECT_FALSE(apply(d));
+    EXPECT_FALSE(apply({0xB1}));
+    EXPECT_FALSE(apply({0xB2, ALLOW_MSG_SNAPSHOT, 0, 0, 0, 0, 0, 0, 0}));
+    EXPECT_FALSE(apply({0xB1, 0x01, 0, 0, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(check(10), ALLOW_YES);
+    EXPECT_EQ(a->seq, 1u);
+}
+
+TEST(AllowlistId, LittleEndianTagPrefix)
+{
+    const uint8_t tag[16] = {1, 2, 3, 4, 5, 6, 7, 8, 0xff};
+    EXPECT_EQ(allowlist_id(tag), 0x0807060504030201ULL);
+}
+
+} // namespace
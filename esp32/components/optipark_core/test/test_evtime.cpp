@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "evtime.h"
+#include "fake_hal.h"
+
+namespace {
+
+class Evtime : public ::testing::Test {
+protected:
+    void SetUp() override { g_hal.reset(); }
+
+    std::string json(const evtime_t &t)
+    {
+        char buf[96];
+        int n = evtime_json(&t, buf, sizeof(buf));
+        EXPECT_LT(n, int(sizeof(buf)));
+        return std::string(buf, size_t(n));
+    }
+};
+
+TEST_F(Evtime, UptimeUntilSynced)
+{
+    g_hal.now_ms = 9000;
+    evtime_t t = evtime_at(8500);
+    EXPECT_FALSE(t.epoch);
+    EXPECT_EQ(t.ms, 8500);
+    EXPECT_EQ(t.sync_age_s, -1);
+    EXPECT_EQ(json(t), ",\"ts_ms\":8500");
+}
+
+TEST_F(Evtime, PastEventsKeepTheirOffset)
+{
+    g_hal.now_ms = 9000;
+    g_hal.epoch_ms = 1768298400000LL;
+    g_hal.sync_age_s = 12;
+    evtime_t t = evtime_at(8500);   // confirmed 500 ms ago, e.g. waited in the outbox
+    EXPECT_TRUE(t.epoch);
+    EXPECT_EQ(t.ms, 1768298400000LL - 500);
+    EXPECT_EQ(t.sync_age_s, 12);
+    EXPECT_EQ(json(t), ",\"sent_at\":\"2026-01-13T09:59:59.500Z\",\"sync_age_s\":12");
+}
+
+TEST_F(Evtime, UnknownTimestamp)
+{
+    g_hal.epoch_ms = 1768298400000LL;
+    evtime_t t = evtime_at(-1);     // restored from a previous boot
+    EXPECT_FALSE(t.epoch);
+    EXPECT_EQ(json(t), "");
+}
+
+TEST_F(Evtime, ClockWithoutSntpSyncOmitsAge)
+{
+    const evtime_t t = { 1768298400000LL, true, -1 };
+    EXPECT_EQ(json(t), ",\"sent_at\":\"2026-01-13T10:00:00.000Z\"");
+}
+
+TEST(EvtimeIso, Calendar)
+{
+    char buf[32];
+    ASSERT_EQ(evtime_iso(0, buf, sizeof(buf)), 24u);
+    EXPECT_STREQ(buf, "1970-01-01T00:00:00.000Z");
+    evtime_iso(951782400123LL, buf, sizeof(buf));       // leap day
+    EXPECT_STREQ(buf, "2000-02-29T00:00:00.123Z");
+    evtime_iso(4102444799999LL, buf, sizeof(buf));
+    EXPECT_STREQ(buf, "2099-12-31T23:59:59.999Z");
+    EXPECT_EQ(evtime_iso(0, buf, 24), 0u);
+}
+
+} // namespace
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include "fake_hal.h"
+#include "gate.h"
+
+namespace {
+
+// open_deg, close_deg, welcome_ms, open_ms, invalid_ms, wrong_ms
+const gate_cfg_t CFG = { 0, 90, 800, 2500, 1200, 2000 };
+
+class Gate : public ::testing::Test {
+protected:
+    void SetUp() override { g_hal.reset(); }
+
+    gate_req_t req(gate_req_kind_t kind, const char *name = "", const char *zone = "")
+    {
+        gate_req_t r{};
+        r.kind = kind;
+        snprintf(r.name, sizeof(r.name), "%s", name);
+        snprintf(r.zone, sizeof(r.zone), "%s", zone);
+        return r;
+    }
+};
+
+TEST_F(Gate, OpenSequence)
+{
+    gate_req_t r = req(GATE_REQ_OPEN, "Alice", "A");
+    int64_t deadline = 0;
+
+    g_hal.now_ms = 1000;
+    ASSERT_EQ(gate_start(&CFG, &r, &deadline), GATE_WELCOME);
+    EXPECT_EQ(deadline, 1800);
+    EXPECT_EQ(g_hal.screens.back().line1, "Welcome");
+    EXPECT_TRUE(g_hal.servo.empty());
+
+    g_hal.now_ms = deadline;
+    ASSERT_EQ(gate_advance(&CFG, GATE_WELCOME, &r, false, &deadline), GATE_OPEN);
+    EXPECT_EQ(deadline, 4300);
+    EXPECT_EQ(g_hal.screens.back().line1, "Alice");
+    ASSERT_EQ(g_hal.servo.size(), 1u);
+    EXPECT_EQ(g_hal.servo[0], 0);
+
+    g_hal.now_ms = deadline;
+    ASSERT_EQ(gate_advance(&CFG, GATE_OPEN, &r, false, &deadline), GATE_IDLE);
+    ASSERT_EQ(g_hal.servo.size(), 2u);
+    EXPECT_EQ(g_hal.servo[1], 90);
+    EXPECT_EQ(g_hal.screens.back().line1, "Waiting...");
+}
+
+TEST_F(Gate, EmptyNameShowsUser)
+{
+    gate_req_t r = req(GATE_REQ_OPEN);
+    int64_t deadline = 0;
+    gate_start(&CFG, &r, &deadline);
+    gate_advance(&CFG, GATE_WELCOME, &r, false, &deadline);
+    EXPECT_EQ(g_hal.screens.back().line1, "User");
+}
+
+TEST_F(Gate, QueuedRequestSkipsWaitingScreen)
+{
+    gate_req_t r = req(GATE_REQ_OPEN, "Alice", "A");
+    int64_t deadline = 0;
+    gate_start(&CFG, &r, &deadline);
+    gate_advance(&CFG, GATE_WELCOME, &r, false, &deadline);
+    size_t screens = g_hal.screens.size();
+    EXPECT_EQ(gate_advance(&CFG, GATE_OPEN, &r, true, &deadline), GATE_IDLE);
+    EXPECT_EQ(g_hal.screens.size(), screens);
+    EXPECT_EQ(g_hal.servo.back(), 90);
+}
+
+TEST_F(Gate, RejectionsAreTimedMessages)
+{
+    int64_t deadline = -1;
+    gate_req_t inv = req(GATE_REQ_INVALID);
+    EXPECT_EQ(gate_start(&CFG, &inv, &deadline), GATE_IDLE);
+    EXPECT_EQ(g_hal.screens.back().line1, "Invalid QR");
+    EXPECT_EQ(g_hal.screens.back().hold_ms, 1200u);
+
+    gate_req_t b = req(GATE_REQ_WRONG_ZONE, "", "B");
+    EXPECT_EQ(gate_start(&CFG, &b, &deadline), GATE_IDLE);
+    EXPECT_EQ(g_hal.screens.back().line1, "Go to parking B");
+    EXPECT_EQ(g_hal.screens.back().hold_ms, 2000u);
+
+    gate_req_t c = req(GATE_REQ_WRONG_ZONE, "", "C");
+    gate_start(&CFG, &c, &deadline);
+    EXPECT_EQ(g_hal.screens.back().line1, "Wrong parking");
+
+    gate_req_t exp = req(GATE_REQ_EXPIRED);
+    EXPECT_EQ(gate_start(&CFG, &exp, &deadline), GATE_IDLE);
+    EXPECT_EQ(g_hal.screens.back().line1, "QR expired");
+    EXPECT_EQ(g_hal.screens.back().hold_ms, 1200u);
+
+    gate_req_t used = req(GATE_REQ_USED);
+    EXPECT_EQ(gate_start(&CFG, &used, &deadline), GATE_IDLE);
+    EXPECT_EQ(g_hal.screens.back().line1, "QR already used");
+
+    gate_req_t nb = req(GATE_REQ_NOT_BOOKED);
+    EXPECT_EQ(gate_start(&CFG, &nb, &deadline), GATE_IDLE);
+    EXPECT_EQ(g_hal.screens.back().line1, "No reservation");
+
+    EXPECT_EQ(deadline, -1);
+    EXPECT_TRUE(g_hal.servo.empty());
+}
+
+TEST_F(Gate, QueuedRejectionFallsBackToWaiting)
+{
+    gate_req_t r = req(GATE_REQ_OPEN, "Alice", "A");
+    int64_t deadline = 0;
+    gate_start(&CFG, &r, &deadline);
+    gate_advance(&CFG, GATE_WELCOME, &r, false, &deadline);
+    gate_advance(&CFG, GATE_OPEN, &r, true, &deadline);
+    EXPECT_EQ(g_hal.screens.back().line1, "Alice");
+
+    gate_req_t inv = req(GATE_REQ_INVALID);
+    EXPECT_EQ(gate_start(&CFG, &inv, &deadline), GATE_IDLE);
+    ASSERT_GE(g_hal.screens.size(), 2u);
+    const FakeScreen &base = g_hal.screens[g_hal.screens.size() - 2];
+    EXPECT_EQ(base.line1, "Waiting...");
+    EXPECT_EQ(base.hold_ms, 0u);
+    EXPECT_EQ(g_hal.screens.back().line1, "Invalid QR");
+    EXPECT_EQ(g_hal.screens.back().hold_ms, 1200u);
+}
+
+} // namespace
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+
+#include "fake_hal.h"
+#include "occupancy.h"
+
+namespace {
+
+class Occupancy : public ::testing::Test {
+protected:
+    occupancy_t o;
+    void SetUp() override { g_hal.reset(); }
+};
+
+TEST_F(Occupancy, ScanFlipsAfterThreeEqualSamples)
+{
+    occupancy_init(&o, 8, true, true);
+    EXPECT_EQ(occupancy_scan(&o, 0x05), 0u);
+    EXPECT_EQ(occupancy_scan(&o, 0x05), 0u);
+    EXPECT_EQ(occupancy_scan(&o, 0x05), 0x05u);
+    EXPECT_TRUE(o.occ[0]);
+    EXPECT_FALSE(o.occ[1]);
+    EXPECT_TRUE(o.occ[2]);
+    EXPECT_EQ(occupancy_scan(&o, 0x05), 0u);
+}
+
+TEST_F(Occupancy, ScanIgnoresGlitches)
+{
+    occupancy_init(&o, 8, true, true);
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(occupancy_scan(&o, 0x01), 0u);
+        EXPECT_EQ(occupancy_scan(&o, 0x01), 0u);
+        EXPECT_EQ(occupancy_scan(&o, 0x00), 0u);   // bounce resets the count
+    }
+    EXPECT_FALSE(o.occ[0]);
+}
+
+TEST_F(Occupancy, ScanAllSixtyFourLanes)
+{
+    occupancy_init(&o, MAX_SPOTS, true, true);
+    occupancy_scan(&o, ~0ULL);
+    occupancy_scan(&o, ~0ULL);
+    EXPECT_EQ(occupancy_scan(&o, ~0ULL), ~0ULL);
+    EXPECT_EQ(occupancy_bitmap(&o), ~0ULL);
+    EXPECT_EQ(occupancy_count_free(&o), 0);
+}
+
+TEST_F(Occupancy, ConfirmPinHonoursPolarity)
+{
+    occupancy_init(&o, 2, false, true);
+    g_hal.gpio[34] = false;
+    EXPECT_TRUE(occupancy_confirm_pin(&o, 0, 34, true));    // active low: low = occupied
+    EXPECT_TRUE(o.occ[0]);
+    EXPECT_FALSE(occupancy_confirm_pin(&o, 0, 34, true));
+    g_hal.gpio[34] = true;
+    EXPECT_TRUE(occupancy_confirm_pin(&o, 0, 34, true));
+    EXPECT_FALSE(o.occ[0]);
+    EXPECT_TRUE(occupancy_confirm_pin(&o, 1, 34, false));
+    EXPECT_TRUE(o.occ[1]);
+}
+
+TEST_F(Occupancy, PerSlotChangeOnly)
+{
+    occupancy_init(&o, 4, false, true);
+    o.occ[1] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 1, true, false), OCC_PUB_NOW);
+    EXPECT_EQ(occupancy_publish_decide(&o, 1, true, false), OCC_PUB_NONE);
+    EXPECT_EQ(occupancy_publish_decide(&o, 2, true, false), OCC_PUB_NONE);
+    EXPECT_EQ(o.chg, 0u);
+}
+
+TEST_F(Occupancy, PerSlotRefreshWhenNotChangeOnly)
+{
+    occupancy_init(&o, 4, false, false);
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_REFRESH);
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, false, false), OCC_PUB_NONE);
+}
+
+TEST_F(Occupancy, BatchSetsChangeMask)
+{
+    occupancy_init(&o, 4, true, false);
+    o.occ[0] = true;
+    o.occ[3] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_BATCH);
+    EXPECT_EQ(occupancy_publish_decide(&o, 3, true, false), OCC_PUB_BATCH);
+    EXPECT_EQ(occupancy_publish_decide(&o, 1, true, false), OCC_PUB_NONE);   // batch is always change-only
+    EXPECT_EQ(o.chg, 0x9u);
+}
+
+TEST_F(Occupancy, OfflineOrBacklogGoesToOutbox)
+{
+    occupancy_init(&o, 4, true, true);
+    o.occ[0] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, false, false), OCC_PUB_OUTBOX);
+    o.occ[0] = false;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, true), OCC_PUB_OUTBOX);
+    EXPECT_EQ(o.chg, 0u);
+    // Handed over once: the next decision sees no change.
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_NONE);
+}
+
+TEST_F(Occupancy, RateLimitHoldsChangesOverTheBurst)
+{
+    occupancy_init(&o, 4, false, true);
+    occupancy_set_rate_limit(&o, 2, 10000);     // a token back every 5 s
+    g_hal.now_ms = 1000;
+    o.occ[0] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_NOW);
+    o.occ[0] = false;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_NOW);
+    o.occ[0] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_HELD);
+    EXPECT_EQ(o.held, 0x1u);
+    EXPECT_EQ(occupancy_next_release_ms(&o), 6000);
+
+    // Other spots have their own bucket.
+    o.occ[1] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 1, true, false), OCC_PUB_NOW);
+
+    g_hal.now_ms = 5999;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_HELD);
+    g_hal.now_ms = 6000;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_NOW);   // trailing edge
+    EXPECT_EQ(o.held, 0u);
+    EXPECT_EQ(occupancy_next_release_ms(&o), INT64_MAX);
+    EXPECT_EQ(o.suppressed[0], 0);
+}
+
+TEST_F(Occupancy, RateLimitCoalescesFlapping)
+{
+    occupancy_init(&o, 4, true, true);
+    occupancy_set_rate_limit(&o, 1, 5000);
+    o.occ[2] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 2, true, false), OCC_PUB_BATCH);
+    o.chg = 0;
+
+    // Ten flips inside the window: an even number ends where it started.
+    for (int k = 0; k < 10; k++) {
+        g_hal.now_ms += 100;
+        o.occ[2] = !o.occ[2];
+        occupancy_publish_decide(&o, 2, true, false);
+    }
+    EXPECT_EQ(o.held, 0u);
+    EXPECT_EQ(o.suppressed[2], 10);
+    EXPECT_EQ(o.chg, 0u);
+
+    // One more: the final state goes out once the token is back.
+    o.occ[2] = false;
+    EXPECT_EQ(occupancy_publish_decide(&o, 2, true, false), OCC_PUB_HELD);
+    g_hal.now_ms = occupancy_next_release_ms(&o);
+    EXPECT_EQ(occupancy_publish_decide(&o, 2, true, false), OCC_PUB_BATCH);
+    EXPECT_EQ(o.chg, 0x4u);
+}
+
+TEST_F(Occupancy, RateLimitAppliesOfflineAndSnapshotReleases)
+{
+    occupancy_init(&o, 4, true, true);
+    occupancy_set_rate_limit(&o, 1, 60000);
+    o.occ[0] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, false, false), OCC_PUB_OUTBOX);
+    o.occ[0] = false;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, false, false), OCC_PUB_HELD);
+
+    occupancy_snapshot_sent(&o);     // carries the current state
+    EXPECT_EQ(o.held, 0u);
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_NONE);
+}
+
+// Snapshot mode end to end, with the bridge's cache modelled as the last
+// bitmap received: the held spot's final state must show up as a change.
+TEST_F(Occupancy, HeldChangeReachesReceiverThroughSnapshot)
+{
+    occupancy_init(&o, 4, true, true);
+    occupancy_set_rate_limit(&o, 1, 60000);
+    uint64_t cache = occupancy_bitmap(&o);   // boot snapshot
+
+    o.occ[0] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_BATCH);
+    g_hal.now_ms += 100;
+    o.occ[0] = false;
+    EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_HELD);
+
+    // A delta for another spot goes out while spot 0 is held.
+    o.occ[1] = true;
+    EXPECT_EQ(occupancy_publish_decide(&o, 1, true, false), OCC_PUB_BATCH);
+    uint64_t delta_occ = occupancy_published_bitmap(&o);
+    EXPECT_EQ(delta_occ, 0x3u);              // spot 0 still at its published "occupied"
+    cache = delta_occ;
+    o.chg = 0;
+
+    // The periodic snapshot absorbs the held change.
+    uint64_t snap_occ = occupancy_bitmap(&o);
+    occupancy_snapshot_sent(&o);
+    EXPECT_EQ(snap_occ ^ cache, 0x1u);       // the receiver emits spot 0 = free
+    EXPECT_FALSE(snap_occ & 0x1u);
+    EXPECT_EQ(o.held, 0u);
+    EXPECT_EQ(occupancy_published_bitmap(&o), snap_occ);
+}
+
+TEST_F(Occupancy, RateLimitOff)
+{
+    occupancy_init(&o, 4, false, true);
+    occupancy_set_rate_limit(&o, 0, 60000);
+    for (int k = 0; k < 100; k++) {
+        o.occ[0] = !o.occ[0];
+        EXPECT_EQ(occupancy_publish_decide(&o, 0, true, false), OCC_PUB_NOW);
+    }
+}
+
+} // namespace
@@ -0,0 +1,336 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fake_hal.h"
+#include "opk_hal.h"
+#include "qr.h"
+
+namespace {
+
+const char *SIG = "OPK_V1_20JA02";
+
+struct Parsed {
+    bool ok;
+    std::string name;
+    std::string zone;
+};
+
+Parsed parse(const char *in)
+{
+    char name[QR_NAME_LEN] = {0};
+    char zone[QR_ZONE_LEN] = {0};
+    bool ok = qr_parse(in, SIG, name, sizeof(name), zone, sizeof(zone));
+    return {ok, name, zone};
+}
+
+TEST(QrParse, ValidPayload)
+{
+    Parsed p = parse("OPK_V1_20JA02|OPTIPARK:A-1:Alice");
+    ASSERT_TRUE(p.ok);
+    EXPECT_EQ(p.zone, "A");
+    EXPECT_EQ(p.name, "Alice");
+}
+
+TEST(QrParse, MultiCharZoneAndSpot)
+{
+    Parsed p = parse("OPK_V1_20JA02|OPTIPARK:B2-18:Bob Martin");
+    ASSERT_TRUE(p.ok);
+    EXPECT_EQ(p.zone, "B2");
+    EXPECT_EQ(p.name, "Bob Martin");
+}
+
+TEST(QrParse, RejectsWrongSignature)
+{
+    EXPECT_FALSE(parse("OPK_V1_20JA03|OPTIPARK:A-1:Alice").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA0|OPTIPARK:A-1:Alice").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA021|OPTIPARK:A-1:Alice").ok);
+    EXPECT_FALSE(parse("|OPTIPARK:A-1:Alice").ok);
+}
+
+TEST(QrParse, RejectsWrongPrefix)
+{
+    EXPECT_FALSE(parse("OPK_V1_20JA02|OPTIPARX:A-1:Alice").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA02|OPTIPAR:A-1:Alice").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA02|OPTIPARKING:A-1:Alice").ok);
+}
+
+TEST(QrParse, RejectsMissingParts)
+{
+    EXPECT_FALSE(parse("").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA02").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA02|OPTIPARK").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA02|OPTIPARK:A1:Alice").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA02|OPTIPARK:-1:Alice").ok);
+    EXPECT_FALSE(parse("OPK_V1_20JA02|OPTIPARK:A-1:").ok);
+    EXPECT_FALSE(qr_parse(nullptr, SIG, nullptr, 0, nullptr, 0));
+}
+
+TEST(QrParse, RejectsZoneLongerThanBuffer)
+{
+    EXPECT_FALSE(parse("OPK_V1_20JA02|OPTIPARK:ABCDEFGH-1:Alice").ok);
+    EXPECT_TRUE(parse("OPK_V1_20JA02|OPTIPARK:ABCDEFG-1:Alice").ok);
+}
+
+TEST(QrParse, TruncatesLongName)
+{
+    std::string in = "OPK_V1_20JA02|OPTIPARK:A-1:" + std::string(200, 'x');
+    Parsed p = parse(in.c_str());
+    ASSERT_TRUE(p.ok);
+    EXPECT_EQ(p.name.size(), size_t(QR_NAME_LEN - 1));
+}
+
+// Vectors from Reservation/qr_token.py with key 00 01 .. 1f as kid 1, so the
+// backend and the gate agree on the format.
+const char *V2_A3_ALICE = "OPK2|1|A-3|1900000000|Alice|gac7uxSuGqdIsiUiou8BoQ";
+const char *V2_B18_BOB = "OPK2|1|B-18|1900000000|Bob Martin|CiCOfg0jVJfTGeHvrtro4A";
+const char *V2_KID2 = "OPK2|2|A-3|1900000000|Alice|iSBiyDOCowER42p-s32Y6w";
+const int64_t EXP = 1900000000;
+
+qr_keyring_t test_keys()
+{
+    qr_keyring_t k{};
+    k.count = 1;
+    k.key[0].kid = 1;
+    for (int i = 0; i < QR_KEY_LEN; i++) k.key[0].key[i] = uint8_t(i);
+    return k;
+}
+
+// Sign with the test key, like the backend does.
+std::string sign(const std::string &body)
+{
+    qr_keyring_t k = test_keys();
+    uint8_t mac[32];
+    hal_hmac_sha256(k.key[0].key, QR_KEY_LEN, body.data(), body.size(), mac);
+    static const char *B64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    std::string tag;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (int i = 0; i < QR_TAG_LEN; i++) {
+        acc = (acc << 8) | mac[i];
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            tag += B64[(acc >> bits) & 63];
+        }
+    }
+    if (bits) tag += B64[(acc << (6 - bits)) & 63];
+    return body + "|" + tag;
+}
+
+class QrVerify : public ::testing::Test {
+protected:
+    qr_keyring_t keys = test_keys();
+    qr_token_t t{};
+
+    qr_result_t verify(const std::string &in, int64_t now = EXP - 100)
+    {
+        return qr_verify(in.c_str(), &keys, now, 60, &t);
+    }
+};
+
+TEST_F(QrVerify, BackendVectors)
+{
+    ASSERT_EQ(verify(V2_A3_ALICE), QR_OPEN);
+    EXPECT_STREQ(t.slot, "A-3");
+    EXPECT_STREQ(t.zone, "A");
+    EXPECT_STREQ(t.name, "Alice");
+    EXPECT_EQ(t.exp, EXP);
+
+    ASSERT_EQ(verify(V2_B18_BOB), QR_OPEN);
+    EXPECT_STREQ(t.zone, "B");
+    EXPECT_STREQ(t.name, "Bob Martin");
+}
+
+TEST_F(QrVerify, SignerMatchesBackend)
+{
+    EXPECT_EQ(sign("OPK2|1|A-3|1900000000|Alice"), V2_A3_ALICE);
+}
+
+TEST_F(QrVerify, UnknownKeyAndRotation)
+{
+    EXPECT_EQ(verify(V2_KID2), QR_BAD_TAG);
+
+    keys.count = 2;
+    keys.key[1].kid = 2;
+    memset(keys.key[1].key, 0xAB, QR_KEY_LEN);
+    EXPECT_EQ(verify(V2_KID2), QR_OPEN);
+    EXPECT_EQ(verify(V2_A3_ALICE), QR_OPEN);    // old key still accepted during the rotation
+}
+
+TEST_F(QrVerify, TamperedFieldsFail)
+{
+    std::string good = V2_A3_ALICE;
+    EXPECT_EQ(verify("OPK2|1|A-4|1900000000|Alice|gac7uxSuGqdIsiUiou8BoQ"), QR_BAD_TAG);
+    EXPECT_EQ(verify("OPK2|1|A-3|1900000001|Alice|gac7uxSuGqdIsiUiou8BoQ"), QR_BAD_TAG);
+    EXPECT_EQ(verify("OPK2|1|A-3|1900000000|Alicf|gac7uxSuGqdIsiUiou8BoQ"), QR_BAD_TAG);
+    EXPECT_EQ(verify("OPK2|1|A-3|1900000000|Alice|hac7uxSuGqdIsiUiou8BoQ"), QR_BAD_TAG);
+}
+
+TEST_F(QrVerify, NonCanonicalTagRejected)
+{
+    // Last char carries 2 data bits + 4 zero bits; 'R' (17) sets a padding bit.
+    EXPECT_EQ(verify("OPK2|1|A-3|1900000000|Alice|gac7uxSuGqdIsiUiou8BoR"), QR_INVALID);
+}
+
+TEST_F(QrVerify, Expiry)
+{
+    EXPECT_EQ(verify(V2_A3_ALICE, EXP), QR_OPEN);
+    EXPECT_EQ(verify(V2_A3_ALICE, EXP + 60), QR_OPEN);      // skew
+    EXPECT_EQ(verify(V2_A3_ALICE, EXP + 61), QR_EXPIRED);
+    EXPECT_EQ(verify(V2_A3_ALICE, 0), QR_NO_CLOCK);
+}
+
+TEST_F(QrVerify, Malformed)
+{
+    EXPECT_EQ(verify("OPK2|"), QR_INVALID);
+    EXPECT_EQ(verify("OPK2|1|A-3|1900000000|gac7uxSuGqdIsiUiou8BoQ"), QR_INVALID);
+    EXPECT_EQ(verify(sign("OPK2|256|A-3|1900000000|Alice")), QR_INVALID);
+    EXPECT_EQ(verify(sign("OPK2|x|A-3|1900000000|Alice")), QR_INVALID);
+    EXPECT_EQ(verify(sign("OPK2|1|A3|1900000000|Alice")), QR_INVALID);
+    EXPECT_EQ(verify(sign("OPK2|1|-3|1900000000|Alice")), QR_INVALID);
+    EXPECT_EQ(verify(sign("OPK2|1|ABCDEFGHIJK-3|1900000000|Alice")), QR_INVALID);
+    EXPECT_EQ(verify(sign("OPK2|1|A-3|-5|Alice")), QR_INVALID);
+    EXPECT_EQ(verify(sign("OPK2|1|A-3|1900000000|")), QR_INVALID);
+    EXPECT_EQ(verify(std::string(V2_A3_ALICE) + "A"), QR_INVALID);
+}
+
+TEST_F(QrVerify, UserMayContainSeparator)
+{
+    ASSERT_EQ(verify(sign("OPK2|1|A-3|1900000000|A|B")), QR_OPEN);
+    EXPECT_STREQ(t.name, "A|B");
+}
+
+TEST(QrCtEqual, Compares)
+{
+    uint8_t a[4] = {1, 2, 3, 4}, b[4] = {1, 2, 3, 4}, c[4] = {1, 2, 3, 5};
+    EXPECT_TRUE(qr_ct_equal(a, b, 4));
+    EXPECT_FALSE(qr_ct_equal(a, c, 4));
+    EXPECT_TRUE(qr_ct_equal(a, c, 3));
+}
+
+class QrCheck : public ::testing::Test {
+protected:
+    qr_keyring_t keys = test_keys();
+    qr_policy_t policy{&keys, SIG, 'A', 60, nullptr};
+    qr_filter_t f{};
+    qr_token_t t{};
+
+    void SetUp() override
+    {
+        g_hal.reset();
+        g_hal.epoch_ms = 1000 * (EXP - 3600);
+    }
+
+    qr_result_t check(const char *payload) { return qr_check(&f, payload, &policy, &t); }
+};
+
+TEST_F(QrCheck, OpensForOwnZone)
+{
+    EXPECT_EQ(check("OPK_V1_20JA02|OPTIPARK:A-3:Alice"), QR_OPEN);
+    EXPECT_STREQ(t.name, "Alice");
+    EXPECT_STREQ(t.zone, "A");
+    EXPECT_EQ(t.exp, 0);
+}
+
+TEST_F(QrCheck, OtherZone)
+{
+    EXPECT_EQ(check("OPK_V1_20JA02|OPTIPARK:B-3:Alice"), QR_WRONG_ZONE);
+    EXPECT_STREQ(t.zone, "B");
+    EXPECT_EQ(check(V2_B18_BOB), QR_WRONG_ZONE);
+}
+
+TEST_F(QrCheck, IgnoresEmptyAndRepeats)
+{
+    EXPECT_EQ(check(""), QR_IGNORE);
+    EXPECT_EQ(check(nullptr), QR_IGNORE);
+    EXPECT_EQ(check("OPK_V1_20JA02|OPTIPARK:A-3:Alice"), QR_OPEN);
+    EXPECT_EQ(check("OPK_V1_20JA02|OPTIPARK:A-3:Alice"), QR_IGNORE);
+    EXPECT_EQ(check("garbage"), QR_INVALID);
+    EXPECT_EQ(check("garbage"), QR_IGNORE);
+    // A different code in between re-arms the first one.
+    EXPECT_EQ(check("OPK_V1_20JA02|OPTIPARK:A-3:Alice"), QR_OPEN);
+}
+
+TEST_F(QrCheck, LongPayloadsAreNeverRepeats)
+{
+    std::string in = "OPK_V1_20JA02|OPTIPARK:A-1:" + std::string(QR_MAX_LEN, 'x');
+    EXPECT_EQ(check(in.c_str()), QR_OPEN);
+    EXPECT_EQ(check(in.c_str()), QR_OPEN);
+}
+
+TEST_F(QrCheck, LegacyCodesCanBeTurnedOff)
+{
+    policy.legacy_sig = nullptr;
+    EXPECT_EQ(check("OPK_V1_20JA02|OPTIPARK:A-3:Alice"), QR_INVALID);
+    EXPECT_EQ(check(V2_A3_ALICE), QR_OPEN);
+}
+
+TEST_F(QrCheck, SignedTokenOpensOnce)
+{
+    EXPECT_EQ(check(V2_A3_ALICE), QR_OPEN);
+    EXPECT_EQ(check(V2_A3_ALICE), QR_IGNORE);       // camera resend
+    EXPECT_EQ(check("garbage"), QR_INVALID);
+    EXPECT_EQ(check(V2_A3_ALICE), QR_REPLAY);       // shown again later
+}
+
+TEST_F(QrCheck, WrongZoneDoesNotConsumeToken)
+{
+    policy.zone = 'B';
+    EXPECT_EQ(check(V2_A3_ALICE), QR_WRONG_ZONE);
+    policy.zone = 'A';
+    f.last[0] = 0;
+    EXPECT_EQ(check(V2_A3_ALICE), QR_OPEN);
+}
+
+TEST_F(QrCheck, ClockFromHal)
+{
+    g_hal.epoch_ms = 0;
+    EXPECT_EQ(check(V2_A3_ALICE), QR_NO_CLOCK);
+    g_hal.epoch_ms = 1000 * (EXP + 3600);
+    f.last[0] = 0;
+    EXPECT_EQ(check(V2_A3_ALICE), QR_EXPIRED);
+}
+
+TEST_F(QrCheck, ReplayCacheEvictsExpiredFirst)
+{
+    // Fill the cache with tokens that expire soon, then let them lapse.
+    for (int i = 0; i < QR_USED_MAX; i++) {
+        std::string tok = sign("OPK2|1|A-" + std::to_string(i) + "|" + std::to_string(EXP - 3000) + "|U");
+        ASSERT_EQ(check(tok.c_str()), QR_OPEN) << i;
+    }
+    g_hal.epoch_ms = 1000 * (EXP - 100);
+    EXPECT_EQ(check(V2_A3_ALICE), QR_OPEN);
+    EXPECT_EQ(check("garbage"), QR_INVALID);
+    EXPECT_EQ(check(V2_A3_ALICE), QR_REPLAY);
+}
+
+TEST_F(QrCheck, AllowlistDecidesSignedTokens)
+{
+    std::unique_ptr<allowlist_t> allow(new allowlist_t);
+    allowlist_init(allow.get());
+    policy.allow = allow.get();
+
+    // Nothing received yet: the token alone decides.
+    EXPECT_EQ(check(V2_A3_ALICE), QR_OPEN);
+    f = qr_filter_t{};
+
+    // Empty list for the zone: refused, and the token is not burnt.
+    const uint8_t empty[] = {0xB1, ALLOW_MSG_SNAPSHOT, 1, 0, 0, 0, 0, 0, 0};
+    ASSERT_TRUE(allowlist_apply(allow.get(), empty, sizeof(empty)));
+    EXPECT_EQ(check(V2_A3_ALICE), QR_NOT_BOOKED);
+    EXPECT_EQ(check("OPK_V1_20JA02|OPTIPARK:A-3:Alice"), QR_OPEN);     // legacy codes have no id
+
+    // Add the token's id (first 8 tag bytes) and scan again.
+    qr_token_t tok{};
+    ASSERT_EQ(qr_verify(V2_A3_ALICE, &keys, EXP - 100, 60, &tok), QR_OPEN);
+    std::vector<uint8_t> d = {0xB1, ALLOW_MSG_DELTA, 2, 0, 0, 0, 1, 1};
+    d.insert(d.end(), tok.tag, tok.tag + 8);
+    for (int i = 0; i < 4; i++) d.push_back(uint8_t(EXP >> (8 * i)));
+    ASSERT_TRUE(allowlist_apply(allow.get(), d.data(), d.size()));
+    EXPECT_EQ(check(V2_A3_ALICE), QR_OPEN);
+}
+
+} // namespace
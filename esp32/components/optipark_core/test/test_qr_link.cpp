@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "qr_link.h"
+
+namespace {
+
+class QrLink : public ::testing::Test {
+protected:
+    void SetUp() override { qr_link_reset(&link); }
+
+    static void on_line(void *ctx, char *line, int n)
+    {
+        auto *self = static_cast<QrLink *>(ctx);
+        if (line) {
+            EXPECT_EQ(strlen(line), size_t(n));
+        }
+        self->lines.push_back(line ? line : "<too long>");
+        self->seqs.push_back(self->link.seq);
+    }
+
+    // Feed like recv() would: never more than the contiguous free space.
+    void feed(const std::string &bytes, size_t chunk = 1024)
+    {
+        size_t off = 0;
+        while (off < bytes.size()) {
+            size_t room;
+            char *dst = qr_link_space(&link, &room);
+            ASSERT_GT(room, 0u);
+            size_t n = std::min({room, chunk, bytes.size() - off});
+            memcpy(dst, bytes.data() + off, n);
+            qr_link_commit(&link, n, on_line, this);
+            off += n;
+        }
+    }
+
+    qr_link_t link;
+    std::vector<std::string> lines;
+    std::vector<uint32_t> seqs;
+};
+
+TEST_F(QrLink, SplitsLinesAndTrims)
+{
+    feed("OPK2|1|A-3|x\r\nsecond \t\n\nthird");
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[0], "OPK2|1|A-3|x");
+    EXPECT_EQ(lines[1], "second");
+    EXPECT_EQ(lines[2], "");
+    EXPECT_EQ(seqs, (std::vector<uint32_t>{1, 2, 3}));
+
+    feed("\n");
+    ASSERT_EQ(lines.size(), 4u);
+    EXPECT_EQ(lines[3], "third");
+}
+
+TEST_F(QrLink, ByteAtATimeAcrossTheRingEnd)
+{
+    std::string stream;
+    for (int i = 0; i < 40; i++) stream += "line-" + std::to_string(i) + "\n";
+    feed(stream, 7);
+    ASSERT_EQ(lines.size(), 40u);
+    EXPECT_EQ(lines[39], "line-39");
+    EXPECT_EQ(link.seq, 40u);
+}
+
+TEST_F(QrLink, OverlongLineReportedOnceThenSkipped)
+{
+    feed(std::string(QR_LINK_BUF_SIZE - 1, 'a') + "\n");
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0].size(), size_t(QR_LINK_BUF_SIZE - 1));
+
+    feed(std::string(3 * QR_LINK_BUF_SIZE, 'b') + "\nnext\n", 100);
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[1], "<too long>");
+    EXPECT_EQ(lines[2], "next");
+    EXPECT_EQ(seqs, (std::vector<uint32_t>{1, 2, 3}));
+}
+
+TEST(QrDecision, Format)
+{
+    char out[QR_DECISION_MAX];
+    int n = qr_decision_format(out, sizeof(out), 12, 345678, 910, "queued", "wrong zone");
+    EXPECT_STREQ(out, "OPK-D 12 345678 910 queued wrong zone\n");
+    EXPECT_EQ(n, int(strlen(out)));
+
+    char small[8];
+    n = qr_decision_format(small, sizeof(small), 1, 2, 3, "-", "open");
+    EXPECT_EQ(n, 7);
+    EXPECT_STREQ(small, "OPK-D 1");
+}
+
+} // namespace
@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include "fake_hal.h"
+#include "rain.h"
+#include "wire_format.h"
+
+namespace {
+
+rain_cfg_t make_cfg()
+{
+    rain_cfg_t c{};
+    c.adc_ch = 0;
+    c.wet_mv = 1000;
+    c.dry_mv = 2850;
+    c.wet_raw = 1200;
+    c.dry_raw = 3500;
+    c.iir_shift = 3;
+    c.hysteresis_pct = 5;
+    c.min_publish_ms = 10000;
+    c.on_change_only = true;
+    c.sensor_id = "rain-1";
+    c.topic = "parking/rain";
+    c.qos = 1;
+    c.retain = true;
+    c.binary = false;
+    return c;
+}
+
+class Rain : public ::testing::Test {
+protected:
+    rain_cfg_t cfg = make_cfg();
+    rain_t r;
+
+    void SetUp() override
+    {
+        g_hal.reset();
+        rain_init(&r, &cfg);
+    }
+
+    // Feed the same reading n times, one per second.
+    int settle(int pct, int n)
+    {
+        int due = 0;
+        for (int i = 0; i < n; i++) {
+            g_hal.now_ms += 1000;
+            if (rain_feed(&r, pct, g_hal.now_ms)) {
+                due++;
+                r.pct_pub = r.pct;
+                r.pub_ms = g_hal.now_ms;
+            }
+        }
+        return due;
+    }
+};
+
+TEST_F(Rain, PercentFromMillivolts)
+{
+    EXPECT_EQ(rain_pct_from_reading(&cfg, 0, 2850), 0);
+    EXPECT_EQ(rain_pct_from_reading(&cfg, 0, 3300), 0);
+    EXPECT_EQ(rain_pct_from_reading(&cfg, 0, 1000), 100);
+    EXPECT_EQ(rain_pct_from_reading(&cfg, 0, 100), 100);
+    EXPECT_EQ(rain_pct_from_reading(&cfg, 0, 1925), 50);
+}
+
+TEST_F(Rain, PercentFromRawWithoutCalibration)
+{
+    EXPECT_EQ(rain_pct_from_reading(&cfg, 3500, -1), 0);
+    EXPECT_EQ(rain_pct_from_reading(&cfg, 1200, -1), 100);
+    EXPECT_EQ(rain_pct_from_reading(&cfg, 2350, -1), 50);
+}
+
+TEST_F(Rain, FirstReadingPrimesFilterAndIsDue)
+{
+    EXPECT_TRUE(rain_feed(&r, 42, 0));
+    EXPECT_EQ(r.pct, 42);
+}
+
+TEST_F(Rain, IirConvergesToStep)
+{
+    settle(0, 1);
+    settle(100, 60);
+    EXPECT_EQ(r.pct, 100);
+}
+
+TEST_F(Rain, HysteresisSuppressesSmallMoves)
+{
+    settle(50, 1);
+    EXPECT_EQ(settle(52, 120), 0);
+    EXPECT_EQ(r.pct_pub, 50);
+}
+
+TEST_F(Rain, RateLimited)
+{
+    settle(0, 1);
+    // A full step moves the filter a lot per second, but at most one publish per 10 s.
+    int due = settle(100, 30);
+    EXPECT_LE(due, 3);
+    EXPECT_GE(due, 2);
+}
+
+TEST_F(Rain, EndPointsAlwaysReached)
+{
+    settle(50, 1);
+    settle(100, 120);
+    EXPECT_EQ(r.pct_pub, 100);
+    settle(0, 120);
+    EXPECT_EQ(r.pct_pub, 0);
+}
+
+TEST_F(Rain, PeriodicRepublishWhenNotChangeOnly)
+{
+    cfg.on_change_only = false;
+    settle(50, 1);
+    EXPECT_EQ(settle(50, 60), 6);
+}
+
+TEST_F(Rain, PollPublishesJson)
+{
+    g_hal.adc[0] = {2000, 1925, true};
+    ASSERT_TRUE(rain_poll(&r));
+    ASSERT_EQ(g_hal.published.size(), 1u);
+    const FakeMessage &m = g_hal.published[0];
+    EXPECT_EQ(m.topic, "parking/rain");
+    EXPECT_EQ(m.payload, "{\"sensor_id\":\"rain-1\",\"rain_pct\":50,\"raw\":2000,\"ts_ms\":0}");
+    EXPECT_EQ(m.qos, 1);
+    EXPECT_TRUE(m.retain);
+}
+
+TEST_F(Rain, PollCarriesWallClockOnceSynced)
+{
+    g_hal.now_ms = 5000;
+    g_hal.epoch_ms = 1768298400000LL;
+    g_hal.sync_age_s = 42;
+    g_hal.adc[0] = {2000, 1925, true};
+    ASSERT_TRUE(rain_poll(&r));
+    EXPECT_EQ(g_hal.published[0].payload,
+              "{\"sensor_id\":\"rain-1\",\"rain_pct\":50,\"raw\":2000,"
+              "\"sent_at\":\"2026-01-13T10:00:00.000Z\",\"sync_age_s\":42}");
+}
+
+TEST_F(Rain, PollPublishesBinary)
+{
+    cfg.binary = true;
+    g_hal.adc[0] = {2000, 1925, true};
+    ASSERT_TRUE(rain_poll(&r));
+    ASSERT_EQ(g_hal.published.size(), 1u);
+    EXPECT_EQ(uint8_t(g_hal.published[0].payload[0]), WIRE_MARKER_V2);
+    EXPECT_EQ(uint8_t(g_hal.published[0].payload[1]), WIRE_TYPE_RAIN);
+}
+
+TEST_F(Rain, PollRetriesWhileOffline)
+{
+    g_hal.adc[0] = {2000, 1925, true};
+    g_hal.mqtt_online = false;
+    EXPECT_FALSE(rain_poll(&r));
+    EXPECT_EQ(r.pct_pub, -1);
+
+    g_hal.mqtt_online = true;
+    g_hal.now_ms += 1000;
+    EXPECT_TRUE(rain_poll(&r));
+    EXPECT_EQ(r.pct_pub, 50);
+}
+
+TEST_F(Rain, PollSkipsFailedAdcRead)
+{
+    g_hal.adc[0] = {2000, 1925, false};
+    EXPECT_FALSE(rain_poll(&r));
+    EXPECT_EQ(r.pct_q8, -1);
+    EXPECT_TRUE(g_hal.published.empty());
+}
+
+} // namespace
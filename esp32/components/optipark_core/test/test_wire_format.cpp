@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "wire_format.h"
+
+namespace {
+
+std::vector<uint8_t> spot(const char *id, bool occ, int battery_mv, int64_t ts)
+{
+    const evtime_t t = { ts, false, -1 };
+    std::vector<uint8_t> buf(WIRE_SPOT_MAX_LEN);
+    buf.resize(wire_encode_spot(buf.data(), buf.size(), id, occ, battery_mv, &t));
+    return buf;
+}
+
+TEST(WireFormat, SpotLayout)
+{
+    std::vector<uint8_t> b = spot("A-3", true, -1, 0x0102030405060708LL);
+    std::vector<uint8_t> want = {
+        WIRE_MARKER_V2, WIRE_TYPE_SPOT, WIRE_SPOT_OCCUPIED | WIRE_SPOT_HAS_TS,
+        3, 'A', '-', '3',
+        0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,
+    };
+    EXPECT_EQ(b, want);
+}
+
+TEST(WireFormat, SpotBatteryIsClamped)
+{
+    std::vector<uint8_t> b = spot("A-3", false, 70000, 0);
+    ASSERT_EQ(b.size(), 17u);
+    EXPECT_EQ(b[2], WIRE_SPOT_HAS_BATTERY | WIRE_SPOT_HAS_TS);
+    EXPECT_EQ(b[7], 0xFF);
+    EXPECT_EQ(b[8], 0xFF);
+}
+
+TEST(WireFormat, TooSmallBufferReturnsZero)
+{
+    uint8_t buf[8];
+    const evtime_t t = { 0, false, -1 };
+    EXPECT_EQ(wire_encode_spot(buf, sizeof(buf), "A-3", true, -1, &t), 0u);
+    EXPECT_EQ(wire_encode_delta(buf, sizeof(buf), 1, 0, 0, &t), 0u);
+}
+
+TEST(WireFormat, DeltaWithUptime)
+{
+    uint8_t buf[64];
+    const evtime_t t = { 123, false, -1 };
+    EXPECT_EQ(wire_encode_delta(buf, sizeof(buf), 7, ~0ULL, 1, &t), size_t(WIRE_DELTA_LEN));
+    EXPECT_EQ(buf[0], WIRE_MARKER_V2);
+    EXPECT_EQ(buf[1], WIRE_TYPE_DELTA);
+    EXPECT_EQ(buf[2], WIRE_DELTA_HAS_TS);
+    EXPECT_EQ(buf[3], 7);
+}
+
+TEST(WireFormat, DeltaWithWallClockAppendsSyncAge)
+{
+    uint8_t buf[64];
+    const evtime_t t = { 1768298400000LL, true, 70000 };
+    ASSERT_EQ(wire_encode_delta(buf, sizeof(buf), 7, 0, 0, &t), size_t(WIRE_DELTA_MAX_LEN));
+    EXPECT_EQ(buf[2], WIRE_DELTA_HAS_TS | WIRE_DELTA_TS_EPOCH | WIRE_DELTA_HAS_SYNC);
+    EXPECT_EQ(buf[WIRE_DELTA_LEN], 0xFE);       // saturates below WIRE_SYNC_UNKNOWN
+    EXPECT_EQ(buf[WIRE_DELTA_LEN + 1], 0xFF);
+}
+
+TEST(WireFormat, DeltaEpochIsFlaggedNotInferredFromLength)
+{
+    uint8_t buf[64];
+    const evtime_t t = { 1768298400000LL, true, -1 };     // RTC kept across deep sleep
+    ASSERT_EQ(wire_encode_delta(buf, sizeof(buf), 7, 0, 0, &t), size_t(WIRE_DELTA_LEN));
+    EXPECT_EQ(buf[2], WIRE_DELTA_HAS_TS | WIRE_DELTA_TS_EPOCH);
+}
+
+TEST(WireFormat, DeltaWithoutTimestamp)
+{
+    uint8_t buf[64];
+    EXPECT_EQ(wire_encode_delta(buf, sizeof(buf), 7, 0, 0, nullptr), size_t(WIRE_DELTA_LEN - 8));
+    EXPECT_EQ(buf[2], 0);
+}
+
+TEST(WireFormat, SpotWithWallClock)
+{
+    const evtime_t t = { 0x0102030405060708LL, true, 300 };
+    uint8_t buf[WIRE_SPOT_MAX_LEN];
+    size_t n = wire_encode_spot(buf, sizeof(buf), "A-3", false, -1, &t);
+    ASSERT_EQ(n, size_t(3 + 4 + 8 + 2));
+    EXPECT_EQ(buf[2], WIRE_SPOT_HAS_TS | WIRE_SPOT_TS_EPOCH | WIRE_SPOT_HAS_SYNC);
+    EXPECT_EQ(buf[15], 0x2C);   // 300 little-endian
+    EXPECT_EQ(buf[16], 0x01);
+}
+
+TEST(WireFormat, SpotWithoutTimestamp)
+{
+    uint8_t buf[WIRE_SPOT_MAX_LEN];
+    EXPECT_EQ(wire_encode_spot(buf, sizeof(buf), "A-3", true, -1, nullptr), size_t(3 + 4));
+    EXPECT_EQ(buf[2], WIRE_SPOT_OCCUPIED);
+}
+
+TEST(WireFormat, RainWithoutRaw)
+{
+    uint8_t buf[WIRE_RAIN_MAX_LEN];
+    const evtime_t t = { 0, false, -1 };
+    size_t n = wire_encode_rain(buf, sizeof(buf), "rain-1", 64, -1, &t);
+    EXPECT_EQ(n, size_t(3 + 1 + 6 + 1 + 8));
+    EXPECT_EQ(buf[2], WIRE_RAIN_HAS_TS);
+    EXPECT_EQ(buf[10], 64);
+}
+
+} // namespace
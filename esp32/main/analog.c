@@ -0,0 +1,140 @@
+/* @file  analog.c
+   @brief oversampled, calibrated ADC1 readings in short continuous-mode bursts
+
+   The ADC only runs during a burst: DMA fills one frame, the mean per channel
+   is computed and the converter is stopped again. Between bursts there is no
+   CPU work and no PM lock, so light sleep is not held off.
+*/
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "soc/soc_caps.h"
+#include "esp_log.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "analog.h"
+
+#define ANALOG_UNIT          ADC_UNIT_1
+#define ANALOG_ATTEN         ADC_ATTEN_DB_12
+#define ANALOG_SAMPLE_HZ     20000      // lowest DMA rate on the ESP32
+#define ANALOG_READ_TIMEOUT_MS 50
+#define ANALOG_FRAME_BYTES   (ANALOG_MAX_CHANNELS * ANALOG_OVERSAMPLE * SOC_ADC_DIGI_RESULT_BYTES)
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define ANALOG_OUTPUT_TYPE   ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define ANALOG_GET_CHANNEL(p) ((p)->type1.channel)
+#define ANALOG_GET_DATA(p)    ((p)->type1.data)
+#else
+#define ANALOG_OUTPUT_TYPE   ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define ANALOG_GET_CHANNEL(p) ((p)->type2.channel)
+#define ANALOG_GET_DATA(p)    ((p)->type2.data)
+#endif
+
+static const char *TAG = "ANALOG";
+
+static adc_continuous_handle_t s_adc = NULL;
+static adc_channel_t s_channels[ANALOG_MAX_CHANNELS];
+static adc_cali_handle_t s_cali[ANALOG_MAX_CHANNELS];
+static int s_n = 0;
+static uint8_t s_frame[ANALOG_FRAME_BYTES];
+
+static adc_cali_handle_t analog_cali_create(adc_channel_t ch)
+{
+    adc_cali_handle_t h = NULL;
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cfg = {
+        .unit_id = ANALOG_UNIT, .chan = ch, .atten = ANALOG_ATTEN, .bitwidth = ADC_BITWIDTH_12,
+    };
+    err = adc_cali_create_scheme_curve_fitting(&cfg, &h);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    (void)ch;
+    adc_cali_line_fitting_config_t cfg = {
+        .unit_id = ANALOG_UNIT, .atten = ANALOG_ATTEN, .bitwidth = ADC_BITWIDTH_12,
+    };
+    err = adc_cali_create_scheme_line_fitting(&cfg, &h);
+#else
+    (void)ch;
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No calibration for channel %d, raw only", (int)ch);
+        return NULL;
+    }
+    return h;
+}
+
+esp_err_t analog_init(const adc_channel_t *channels, int n)
+{
+    if (n <= 0 || n > ANALOG_MAX_CHANNELS) return ESP_ERR_INVALID_ARG;
+
+    adc_continuous_handle_cfg_t hcfg = {
+        .max_store_buf_size = 2 * ANALOG_FRAME_BYTES,
+        .conv_frame_size = (uint32_t)(n * ANALOG_OVERSAMPLE * SOC_ADC_DIGI_RESULT_BYTES),
+    };
+    esp_err_t err = adc_continuous_new_handle(&hcfg, &s_adc);
+    if (err != ESP_OK) return err;
+
+    adc_digi_pattern_config_t pattern[ANALOG_MAX_CHANNELS] = {0};
+    for (int i = 0; i < n; i++) {
+        s_channels[i] = channels[i];
+        pattern[i].atten = ANALOG_ATTEN;
+        pattern[i].channel = (uint8_t)channels[i];
+        pattern[i].unit = ANALOG_UNIT;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        s_cali[i] = analog_cali_create(channels[i]);
+    }
+
+    adc_continuous_config_t cfg = {
+        .pattern_num = (uint32_t)n,
+        .adc_pattern = pattern,
+        .sample_freq_hz = ANALOG_SAMPLE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ANALOG_OUTPUT_TYPE,
+    };
+    err = adc_continuous_config(s_adc, &cfg);
+    if (err != ESP_OK) return err;
+
+    s_n = n;
+    return ESP_OK;
+}
+
+esp_err_t analog_sample(analog_reading_t *out)
+{
+    if (!s_adc) return ESP_ERR_INVALID_STATE;
+
+    uint32_t sum[ANALOG_MAX_CHANNELS] = {0};
+    uint32_t cnt[ANALOG_MAX_CHANNELS] = {0};
+    uint32_t total = 0;
+
+    esp_err_t err = adc_continuous_start(s_adc);
+    if (err != ESP_OK) return err;
+
+    while (total < (uint32_t)(s_n * ANALOG_OVERSAMPLE)) {
+        uint32_t len = 0;
+        err = adc_continuous_read(s_adc, s_frame, sizeof(s_frame), &len, ANALOG_READ_TIMEOUT_MS);
+        if (err != ESP_OK) break;
+
+        for (uint32_t off = 0; off + SOC_ADC_DIGI_RESULT_BYTES <= len; off += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&s_frame[off];
+            int ch = ANALOG_GET_CHANNEL(p);
+            for (int i = 0; i < s_n; i++) {
+                if ((int)s_channels[i] != ch) continue;
+                sum[i] += ANALOG_GET_DATA(p);
+                cnt[i]++;
+                total++;
+                break;
+            }
+        }
+    }
+
+    adc_continuous_stop(s_adc);
+    adc_continuous_flush_pool(s_adc);   // next burst must not start with stale frames
+    if (err != ESP_OK) return err;
+
+    for (int i = 0; i < s_n; i++) {
+        if (cnt[i] == 0) return ESP_ERR_INVALID_RESPONSE;
+        out[i].raw = (int)((sum[i] + cnt[i] / 2) / cnt[i]);
+        out[i].mv = -1;
+        if (s_cali[i] && adc_cali_raw_to_voltage(s_cali[i], out[i].raw, &out[i].mv) != ESP_OK) out[i].mv = -1;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,26 @@
+/* @file  analog.h
+   @brief oversampled, calibrated ADC1 readings in short continuous-mode bursts
+*/
+
+#ifndef _ANALOG_H_
+#define _ANALOG_H_
+
+#include "esp_err.h"
+#include "esp_adc/adc_continuous.h"
+
+#define ANALOG_MAX_CHANNELS  4
+#define ANALOG_OVERSAMPLE    64     // conversions averaged per channel per burst
+
+typedef struct {
+    int raw;    // mean ADC code over the burst
+    int mv;     // calibrated mean in mV, -1 without calibration
+} analog_reading_t;
+
+// ADC1 channels, all at 12 dB attenuation (0-~3.1 V).
+esp_err_t analog_init(const adc_channel_t *channels, int n);
+
+// Run one DMA burst (ANALOG_OVERSAMPLE conversions per channel, ~7 ms for two
+// channels), then stop the ADC. out[i] matches channels[i] from analog_init().
+esp_err_t analog_sample(analog_reading_t *out);
+
+#endif
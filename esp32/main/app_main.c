@@ -9,30 +9,59 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_timer.h"
+#include "esp_system.h"
 #include "nvs_flash.h"
 
 #include "esp_netif.h"
 #include "esp_wifi.h"
 #include "mqtt_client.h"
+#include "esp_sntp.h"
+#include "mbedtls/md.h"
 
 #include "driver/gpio.h"
 #include "driver/ledc.h"
-#include "esp_adc/adc_oneshot.h"
+#include "soc/soc_caps.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
 
 #include "lwip/sockets.h"
 #include "lwip/netdb.h"
 #include "lwip/inet.h"
 
-// ---- LCD LIB (Avinashee) ----
-#include "lcd_i2c.h"
+// ---- LCD (Avinashee lib, owned by the display task) ----
+#include "display.h"
+
+// ---- Portable core (components/optipark_core), hardware via opk_hal.h ----
+#include "opk_hal.h"
+#include "qr.h"
+#include "qr_link.h"
+#include "allowlist.h"
+#include "gate.h"
+#include "rain.h"
+#include "occupancy.h"
+#include "wire_format.h"
+#include "evtime.h"
+
+#include "outbox.h"
+#include "spot_table.h"
+#include "shiftreg.h"
+#include "analog.h"
+#include "telemetry.h"
+#include "qr_keys.h"
+#include "ota.h"
+#include "task_plan.h"
 
 // ============================================================
 // LOG TAG
@@ -49,7 +78,20 @@ static const char *TAG = "PARKING";
 // TCP SERVER
 // ============================================================
 #define TCP_LISTEN_PORT  3333
-#define TCP_RX_BUF_SIZE  256
+#define TCP_MAX_CLIENTS  4       // entry + exit cameras, with headroom
+#define TCP_IDLE_TIMEOUT_MS    120000
+#define TCP_SELECT_TIMEOUT_MS  1000
+// One "OPK-D ..." decision line back per QR line (qr_link.h), read by
+// tools/qr_loadgen.py. The ESP32-CAM never reads its socket, 0 = off.
+#define TCP_DECISION_ECHO      1
+
+typedef struct {
+    int fd;                      // -1 = slot free
+    qr_link_t link;              // line framing (ring buffer)
+    int64_t last_rx_ms;
+} tcp_conn_t;
+
+static tcp_conn_t s_tcp_conns[TCP_MAX_CLIENTS];
 
 // ============================================================
 // MQTT CONFIG
@@ -61,64 +103,174 @@ static const char *TAG = "PARKING";
 // ============================================================
 #define PARKING_ID        "nice_sophia.A"
 #define MQTT_TOPIC_SPOTS  "parking/nice_sophia.A/status"
+#define MQTT_TOPIC_DELTA  "parking/nice_sophia.A/delta"
+#define MQTT_TOPIC_SNAPSHOT "parking/nice_sophia.A/snapshot"
 #define MQTT_TOPIC_RAIN   "parking/rain"
+#define MQTT_TOPIC_TELEMETRY "parking/nice_sophia.A/telemetry"
+// Active reservations of this zone, from controle-reservation (allowlist.h)
+#define MQTT_TOPIC_ALLOWLIST       "parking/nice_sophia.A/allowlist"
+#define MQTT_TOPIC_ALLOWLIST_DELTA "parking/nice_sophia.A/allowlist/delta"
+// Delta OTA command in, progress out (ota.h, tools/ota_delta.py)
+#define MQTT_TOPIC_OTA             "parking/nice_sophia.A/ota"
+#define MQTT_TOPIC_OTA_STATUS      "parking/nice_sophia.A/ota/status"
+// A full snapshot (9 + 12 * ALLOW_MAX bytes) must fit in one MQTT_EVENT_DATA
+#define MQTT_RX_BUFFER_SIZE   4096
+#define MQTT_TX_BUFFER_SIZE   1024
 
 // ============================================================
 // SPOTS CONFIG
 // ============================================================
-#define N_SPOTS 5
-static const char *SLOT_IDS[N_SPOTS] = { "A-3", "A-2", "A-20", "A-18", "A-10" };
+// The spot table is loaded from NVS at boot (see spot_table.h). Without a
+// provisioned table the board runs the five GPIO-wired spots below.
+#define DEFAULT_N_SPOTS 5
+static const char *DEFAULT_SLOT_IDS[DEFAULT_N_SPOTS] = { "A-3", "A-2", "A-20", "A-18", "A-10" };
 
-static const gpio_num_t IR_PINS[N_SPOTS] = {
+static const gpio_num_t DEFAULT_IR_PINS[DEFAULT_N_SPOTS] = {
     GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_34, GPIO_NUM_35, GPIO_NUM_27
 };
 static const bool IR_ACTIVE_LOW = true;
 
-static const gpio_num_t LED_GREEN[N_SPOTS] = {
+static const gpio_num_t DEFAULT_LED_GREEN[DEFAULT_N_SPOTS] = {
     GPIO_NUM_25, GPIO_NUM_26, GPIO_NUM_14, GPIO_NUM_16, GPIO_NUM_17
 };
-static const gpio_num_t LED_BLUE[N_SPOTS] = {
+static const gpio_num_t DEFAULT_LED_BLUE[DEFAULT_N_SPOTS] = {
     GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_23
 };
 
+static spot_table_t s_spots;
+#define N_SPOTS  (s_spots.count)
+
 #define LED_ON_LEVEL   0   // common anode
 #define LED_OFF_LEVEL  1
 
 // ============================================================
 // TIMING / MQTT
 // ============================================================
-#define READ_EVERY_MS             150
+#define IR_DEBOUNCE_MS            10    // level must hold this long after the last edge
+// Safety re-read of every pin (missed edge). Low power: the pins are level
+// wakeup sources already, and each resync wakes the chip.
+#define IR_RESYNC_EVERY_MS        (LOW_POWER_MODE ? 60000 : 5000)
+#define IR_EVT_QUEUE_LEN          32
+#define SPOT_SCAN_TICK_MS         (LOW_POWER_MODE ? 50 : 5)   // shift-register backend: one bulk read per tick
+// One oversampled ADC burst (rain + battery). Low power: rain changes over
+// minutes, and a burst keeps the CPU out of light sleep for a few ms.
+#define RAIN_READ_EVERY_MS        (LOW_POWER_MODE ? 30000 : 1000)
 #define PUBLISH_QOS               1
 #define PUBLISH_RETAIN            1
 #define PUBLISH_ON_CHANGE_ONLY    1
-#define RAIN_PUBLISH_ON_CHANGE_ONLY  1
+// Per-slot rate limit (token bucket): at most SPOT_RATE_BURST changes of one
+// slot per SPOT_RATE_WINDOW_MS reach MQTT. Changes over it are held and the
+// slot's latest state goes out when a token is back. 0 = no limit.
+#define SPOT_RATE_BURST           4
+#define SPOT_RATE_WINDOW_MS       60000
+#define RAIN_PUBLISH_ON_CHANGE_ONLY  1   // 0: also republish every RAIN_MIN_PUBLISH_MS
+
+// Spot publishing mode
+//  PER_SLOT : one retained JSON per changed slot on MQTT_TOPIC_SPOTS
+//  SNAPSHOT : one bitmap delta per tick on MQTT_TOPIC_DELTA + periodic
+//             retained full snapshot on MQTT_TOPIC_SNAPSHOT
+#define SPOT_PUBLISH_PER_SLOT     0
+#define SPOT_PUBLISH_SNAPSHOT     1
+#define SPOT_PUBLISH_MODE         SPOT_PUBLISH_SNAPSHOT
+#define SPOT_DELTA_TICK_MS        50      // changes within one tick share a delta
+#define SPOT_SNAPSHOT_EVERY_MS    60000
+// Per-slot events are the state in PER_SLOT mode, so they are retained. In
+// SNAPSHOT mode they only backfill transitions missed while offline, and the
+// retained snapshot is the state.
+#define SPOT_EVENT_RETAIN         (SPOT_PUBLISH_MODE == SPOT_PUBLISH_PER_SLOT ? PUBLISH_RETAIN : 0)
+
+// Payload encoding for spot events, deltas and rain (snapshot is always JSON)
+//  JSON   : human readable, matches kafka/schemas/*.json
+//  BINARY : kafka/schemas/wire-format-v2.md, 3-5x smaller, no printf work
+#define WIRE_FORMAT_JSON          0
+#define WIRE_FORMAT_BINARY        1
+#define WIRE_FORMAT               WIRE_FORMAT_JSON
+
+// Runtime telemetry on MQTT_TOPIC_TELEMETRY (QoS 0, not retained), 0 = off
+#define TELEMETRY_EVERY_MS        60000
+
+// Wall clock (SNTP) for event sent_at and QR token expiry. Events carry
+// sync_age_s so the backend can tell a fresh sync from a drifting clock.
+#define SNTP_SERVER               "pool.ntp.org"
+#define SNTP_RESYNC_MS            (15 * 60 * 1000)
+#define CLOCK_VALID_AFTER_S       1704067200   // 2024-01-01; earlier = not synced yet
+
+// Store-and-forward while MQTT is down (see outbox.c)
+#define OUTBOX_DRAIN_BURST        4       // events per drain step
+#define OUTBOX_DRAIN_EVERY_MS     250     // -> at most 16 backfill msgs/s
+#define OUTBOX_PERSIST_EVERY_MS   5000    // NVS write rate limit (flash wear)
+
+// A freshly updated image must reach the broker within this window, or the
+// bootloader goes back to the previous slot (see ota.c)
+#define OTA_CONFIRM_TIMEOUT_MS    90000
+
+// ============================================================
+// POWER
+// ============================================================
+// LOW_POWER_MODE 1 builds a battery/solar sensor-only node: no LCD, servo,
+// gate or camera TCP server. The CPU scales down and light-sleeps whenever
+// every task is blocked, Wi-Fi only wakes every WIFI_LISTEN_INTERVAL beacons,
+// IR pins are level wakeup sources and the LED PWM runs from RC_FAST so it
+// keeps going through light sleep. Needs CONFIG_PM_ENABLE and
+// CONFIG_FREERTOS_USE_TICKLESS_IDLE (see sdkconfig.defaults).
+#define LOW_POWER_MODE            0
+#define PM_MAX_CPU_FREQ_MHZ       160
+#define PM_MIN_CPU_FREQ_MHZ       40      // XTAL
+#define WIFI_LISTEN_INTERVAL      10      // ~1 s between beacon wakes in max modem sleep
+#define MQTT_KEEPALIVE_S          (LOW_POWER_MODE ? 120 : 30)
+
+// Battery voltage on ADC1 through a 1:2 divider, reported as battery_mv.
+// Sampled in the rain ADC burst (analog.c), latched every BATTERY_READ_EVERY_MS.
+#define BATTERY_MONITOR           LOW_POWER_MODE
+#define BATTERY_ADC_CHANNEL       ADC_CHANNEL_3   // GPIO39
+#define BATTERY_DIVIDER           2
+#define BATTERY_READ_EVERY_MS     60000
 
 // ============================================================
-// SOFTWARE PWM (spot LEDs)
+// SPOT LED PWM (LEDC hardware)
 // ============================================================
 #define PWM_STEPS    50
-#define PWM_TICK_US  200
 #define BRIGHTNESS_STEPS  5
 
-static esp_timer_handle_t s_pwm_timer = NULL;
-static volatile uint32_t s_pwm_phase = 0;
-static volatile uint8_t s_green_duty[N_SPOTS] = {0};
-static volatile uint8_t s_blue_duty[N_SPOTS]  = {0};
+#define LED_LEDC_TIMER      LEDC_TIMER_0
+#define LED_LEDC_FREQ_HZ    5000
+#define LED_LEDC_RES_BITS   LEDC_TIMER_10_BIT
+
+typedef struct {
+    bool hw;                // false: no LEDC channel left, plain GPIO on/off
+    ledc_mode_t mode;
+    ledc_channel_t channel;
+} led_pwm_chan_t;
+
+static led_pwm_chan_t s_green_ch[MAX_SPOTS];
+static led_pwm_chan_t s_blue_ch[MAX_SPOTS];
+static uint8_t s_green_duty[MAX_SPOTS] = {0};
+static uint8_t s_blue_duty[MAX_SPOTS]  = {0};
+static led_pwm_chan_t s_sr_oe_ch;   // shift-register backend: global LED dimming
 
 // ============================================================
 // RAIN SENSOR (ADC)
 // ============================================================
-#define RAIN_ADC_UNIT      ADC_UNIT_1
-#define RAIN_ADC_CHANNEL   ADC_CHANNEL_0   // GPIO36
-#define RAIN_ADC_ATTEN     ADC_ATTEN_DB_11
-#define RAIN_ADC_BITWIDTH  ADC_BITWIDTH_DEFAULT
+#define RAIN_ADC_CHANNEL   ADC_CHANNEL_0   // GPIO36, ADC1, 12 dB
 
+// 0 % at the dry level, 100 % at the wet level (calibrated mV; raw codes
+// are the fallback when the chip has no eFuse calibration)
+#define RAIN_WET_MV         1000
+#define RAIN_DRY_MV         2850
 #define RAIN_WET_RAW        1200
 #define RAIN_DRY_RAW        3500
-#define RAIN_RAW_THRESHOLD  2500
+
+#define RAIN_IIR_SHIFT          3      // y += (x - y) / 8 per burst, ~8 s time constant
+#define RAIN_HYSTERESIS_PCT     5      // publish only on a move of at least this much
+#define RAIN_MIN_PUBLISH_MS     10000  // and at most once per this interval
 
 #define RAIN_SENSOR_ID "rain-1"
-static adc_oneshot_unit_handle_t s_adc = NULL;
+
+enum { ANALOG_RAIN, ANALOG_BATTERY, ANALOG_N };   // hal_adc_read() channels
+static const adc_channel_t ANALOG_CHANNELS[ANALOG_N] = { RAIN_ADC_CHANNEL, BATTERY_ADC_CHANNEL };
+static analog_reading_t s_analog[ANALOG_N];
+static bool s_analog_ok = false;
+static int s_battery_mv = -1;      // -1 = not measured
 
 // ============================================================
 // WIFI EVENT GROUP
@@ -135,19 +287,56 @@ static volatile bool s_mqtt_connected = false;
 // ============================================================
 // STATE
 // ============================================================
-static bool s_occ[N_SPOTS] = {0};
-static bool s_occ_prev[N_SPOTS] = {0};
+static occupancy_t s_occ;   // confirmed state, debounce + change tracking (occupancy.c)
 
-static int s_rain01 = 0;
-static int s_rain01_prev = -1;
+// IR edges (GPIO backend): ISR -> queue (spot index) -> parking_task debounce
+static QueueHandle_t s_ir_evt_queue = NULL;
+static int64_t s_ir_confirm_at_ms[MAX_SPOTS] = {0};   // 0 = no edge pending
+#define IR_EVT_WAKE  0xFF   // not a spot: just wake parking_task
+
+// Snapshot mode
+#if SPOT_PUBLISH_MODE == SPOT_PUBLISH_SNAPSHOT
+static uint32_t s_spot_seq = 0;             // incremented per delta
+#endif
+static volatile bool s_snapshot_due = true;
+
+// Telemetry (see telemetry.h)
+static lat_hist_t s_qr_open_hist;            // QR line received -> servo open (gate_task)
+static lat_hist_t s_edge_pub_hist;           // first sensor edge -> MQTT publish (parking_task)
+static int64_t s_spot_edge_ms[MAX_SPOTS];    // 0 = no change in flight
+static task_jitter_t s_parking_jitter = TASK_JITTER_INIT;   // wake lateness, reset per report
+static task_jitter_t s_gate_jitter = TASK_JITTER_INIT;
+
+static const rain_cfg_t RAIN_CFG = {
+    .adc_ch = ANALOG_RAIN,
+    .wet_mv = RAIN_WET_MV,
+    .dry_mv = RAIN_DRY_MV,
+    .wet_raw = RAIN_WET_RAW,
+    .dry_raw = RAIN_DRY_RAW,
+    .iir_shift = RAIN_IIR_SHIFT,
+    .hysteresis_pct = RAIN_HYSTERESIS_PCT,
+    .min_publish_ms = RAIN_MIN_PUBLISH_MS,
+    .on_change_only = RAIN_PUBLISH_ON_CHANGE_ONLY,
+    .sensor_id = RAIN_SENSOR_ID,
+    .topic = MQTT_TOPIC_RAIN,
+    .qos = PUBLISH_QOS,
+    .retain = PUBLISH_RETAIN,
+    .binary = (WIRE_FORMAT == WIRE_FORMAT_BINARY),
+};
+static rain_t s_rain;
 
 // ============================================================
 // SERVO + LCD + QR logic
 // ============================================================
 
-// QR format: OPK_V1_20JA02|OPTIPARK:A-1:Ons Bahri
-#define QR_EXPECTED_SIGNATURE "OPK_V1_20JA02"
+// Signed tokens from the reservation backend (see qr.h):
+//   OPK2|1|A-3|1767225600|Ons Bahri|<tag>
+// Legacy static codes (OPK_V1_20JA02|OPTIPARK:A-1:Ons Bahri) carry no expiry
+// and can be copied; set QR_ACCEPT_LEGACY to 1 only while old apps are in use.
+#define QR_ACCEPT_LEGACY      0
+#define QR_LEGACY_SIGNATURE   "OPK_V1_20JA02"
 #define QR_EXPECTED_ZONE      'A'   // this ESP controls gate A
+#define QR_CLOCK_SKEW_S       120   // grace after exp for drift between backend and gate
 
 // ---- SERVO ----
 #define SERVO_GPIO          GPIO_NUM_13
@@ -163,87 +352,54 @@ static int s_rain01_prev = -1;
 #define SERVO_CLOSE_DEG     90   
 #define SERVO_OPEN_MS       2500
 
-#define GATE_COOLDOWN_MS    5000
-static volatile bool s_gate_busy = false;
-static int64_t s_gate_last_action_ms = 0;
-static char s_last_qr[160] = {0};
+#define GATE_WELCOME_MS     800
+#define GATE_INVALID_MS     1200
+#define GATE_WRONG_MS       2000
+#define GATE_QUEUE_LEN      4
+
+static const gate_cfg_t GATE_CFG = {
+    .open_deg = SERVO_OPEN_DEG,
+    .close_deg = SERVO_CLOSE_DEG,
+    .welcome_ms = GATE_WELCOME_MS,
+    .open_ms = SERVO_OPEN_MS,
+    .invalid_ms = GATE_INVALID_MS,
+    .wrong_ms = GATE_WRONG_MS,
+};
 
-// LCD (your working test values)
-#define LCD_COLS 16
-#define LCD_ROWS 2
+// Filled by the TCP task, drained by gate_task (owns servo, drives the display)
+static QueueHandle_t s_gate_queue = NULL;
+static qr_filter_t s_qr_filter;
+static qr_keyring_t s_qr_keys;     // from NVS, see qr_keys.h
+
+// Written by the MQTT task, read by the TCP task and telemetry under s_allow_lock.
+// Until the first snapshot arrives, a valid signed token is enough.
+static allowlist_t s_allow;
+static SemaphoreHandle_t s_allow_lock = NULL;
+
+static const qr_policy_t QR_POLICY = {
+    .keys = &s_qr_keys,
+    .legacy_sig = QR_ACCEPT_LEGACY ? QR_LEGACY_SIGNATURE : NULL,
+    .zone = QR_EXPECTED_ZONE,
+    .skew_s = QR_CLOCK_SKEW_S,
+    .allow = &s_allow,
+};
 
 // ============================================================
 // Helpers
 // ============================================================
 static inline int64_t now_ms(void) { return esp_timer_get_time() / 1000; }
 
-static inline int clampi(int x, int a, int b) {
-    if (x < a) return a;
-    if (x > b) return b;
-    return x;
-}
-
-static bool read_occupied(int i) {
-    int v = gpio_get_level(IR_PINS[i]);
-    return IR_ACTIVE_LOW ? (v == 0) : (v == 1);
-}
-
-static void set_spot_led_pwm(int i, bool occupied) {
-    if (occupied) { s_green_duty[i] = 0;                s_blue_duty[i]  = BRIGHTNESS_STEPS; }
-    else          { s_green_duty[i] = BRIGHTNESS_STEPS; s_blue_duty[i]  = 0; }
-}
-
-static int count_free(void) {
-    int freeCount = 0;
-    for (int i = 0; i < N_SPOTS; i++) if (!s_occ[i]) freeCount++;
-    return freeCount;
-}
-
-// ============================================================
-// LCD helpers (Avinashee)
-// ============================================================
-static void lcd_print_padded_16(const char *s) {
-    char buf[17];
-    memset(buf, ' ', 16);
-    buf[16] = 0;
-    size_t n = strlen(s);
-    if (n > 16) n = 16;
-    memcpy(buf, s, n);
-    send_string(buf);
-}
-
-static void lcd_line0_optipark(void) {
-    setCursor(0, 0);
-    lcd_print_padded_16("OPTIPARK");
-}
-
-static void lcd_show_waiting(void) {
-    lcd_line0_optipark();
-    setCursor(0, 1);
-    lcd_print_padded_16("Waiting...");
-}
-
-static void lcd_show_invalid(void) {
-    lcd_line0_optipark();
-    setCursor(0, 1);
-    lcd_print_padded_16("Invalid QR");
-}
+// Uptime (s) of the last SNTP sync, -1 = none yet. 32-bit so the SNTP task
+// writes it atomically.
+static volatile int32_t s_clock_sync_s = -1;
 
-static void show_wrong_parking(const char *zone) {
-    lcd_line0_optipark();
-    setCursor(0, 1);
-    if (zone && zone[0] == 'B') lcd_print_padded_16("Go to parking B");
-    else lcd_print_padded_16("Wrong parking");
+static inline TickType_t ms_to_ticks_ceil(int64_t ms) {
+    if (ms <= 0) return 0;
+    return (TickType_t)((ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
 }
 
-static void show_welcome(const char *name) {
-    lcd_line0_optipark();
-    setCursor(0, 1);
-    lcd_print_padded_16("Welcome");
-    vTaskDelay(pdMS_TO_TICKS(800));
-    lcd_line0_optipark();
-    setCursor(0, 1);
-    lcd_print_padded_16(name ? name : "User");
+static inline bool spots_on_shiftreg(void) {
+    return s_spots.io == SPOT_IO_SHIFTREG;
 }
 
 // ============================================================
@@ -292,125 +448,254 @@ static void servo_init(void) {
     ESP_LOGI(TAG, "Servo ready on GPIO%d", (int)SERVO_GPIO);
 }
 
-static void gate_open_close(void) {
-    s_gate_busy = true;
-    servo_set_angle(SERVO_OPEN_DEG);
-    vTaskDelay(pdMS_TO_TICKS(SERVO_OPEN_MS));
-    servo_set_angle(SERVO_CLOSE_DEG);
-    s_gate_busy = false;
-    s_gate_last_action_ms = now_ms();
-}
-
 // ============================================================
-// QR parsing
+// HAL for the portable core (opk_hal.h)
 // ============================================================
-static bool parse_qr_payload(const char *in, char *out_name, size_t out_name_sz,
-                             char *out_zone, size_t out_zone_sz)
+int64_t hal_now_ms(void)
 {
-    // OPK_V1_20JA02|OPTIPARK:A-1:Name
-    if (!in || !out_name || !out_zone) return false;
+    return now_ms();
+}
 
-    const char *p1 = strchr(in, '|');
-    if (!p1) return false;
+int64_t hal_epoch_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < CLOCK_VALID_AFTER_S) return 0;
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
 
-    size_t sig_len = (size_t)(p1 - in);
-    if (sig_len == 0 || sig_len >= 32) return false;
+int64_t hal_epoch_s(void)
+{
+    return hal_epoch_ms() / 1000;
+}
 
-    char sig[32];
-    memcpy(sig, in, sig_len);
-    sig[sig_len] = 0;
-    if (strcmp(sig, QR_EXPECTED_SIGNATURE) != 0) return false;
+int hal_clock_sync_age_s(void)
+{
+    int32_t at = s_clock_sync_s;
+    return (at < 0) ? -1 : (int)(now_ms() / 1000 - at);
+}
 
-    const char *rest = p1 + 1; // OPTIPARK:A-1:Name
-    const char *c1 = strchr(rest, ':');
-    if (!c1) return false;
-    if (strncmp(rest, "OPTIPARK", 7) != 0) return false;
+// mbedTLS runs SHA-256 on the SHA peripheral (CONFIG_MBEDTLS_HARDWARE_SHA).
+bool hal_hmac_sha256(const uint8_t *key, size_t key_len, const void *msg, size_t len, uint8_t out[32])
+{
+    return mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                           key, key_len, (const unsigned char *)msg, len, out) == 0;
+}
 
-    const char *zone_ptr = c1 + 1;
-    const char *zone_end = strchr(zone_ptr, '-');
-    if (!zone_end) return false;
+bool hal_gpio_get(int pin)
+{
+    return gpio_get_level((gpio_num_t)pin) != 0;
+}
 
-    size_t zone_len = (size_t)(zone_end - zone_ptr);
-    if (zone_len == 0 || zone_len >= out_zone_sz) return false;
-    memcpy(out_zone, zone_ptr, zone_len);
-    out_zone[zone_len] = 0;
+// One burst covers every configured channel; the other readings stay in
+// s_analog for battery_poll().
+bool hal_adc_read(int ch, int *raw, int *mv)
+{
+    if (!s_analog_ok || ch < 0 || ch >= ANALOG_N) return false;
+    if (analog_sample(s_analog) != ESP_OK) return false;
+    *raw = s_analog[ch].raw;
+    *mv = s_analog[ch].mv;
+    return true;
+}
 
-    const char *last_colon = strrchr(in, ':');
-    if (!last_colon) return false;
-    const char *name_ptr = last_colon + 1;
-    if (*name_ptr == 0) return false;
+bool hal_mqtt_publish(const char *topic, const void *payload, size_t len, int qos, bool retain)
+{
+    if (!s_mqtt_connected || !s_mqtt_client) return false;
+    return esp_mqtt_client_publish(s_mqtt_client, topic, (const char *)payload, (int)len, qos, retain) >= 0;
+}
 
-    snprintf(out_name, out_name_sz, "%s", name_ptr);
-    return true;
+void hal_lcd_show(const char *line0, const char *line1)
+{
+    display_show(line0, line1);
+}
+
+void hal_lcd_message(const char *line0, const char *line1, uint32_t hold_ms)
+{
+    display_message(line0, line1, hold_ms);
+}
+
+void hal_servo_set_angle(int deg)
+{
+    servo_set_angle(deg);
 }
 
 // ============================================================
-// TCP server task
+// Gate controller task (servo + screen state machine in gate.c)
 // ============================================================
-static int recv_line(int sock, char *out, int out_sz)
+static void gate_task(void *arg)
 {
-    int idx = 0;
-    while (idx < out_sz - 1) {
-        char c;
-        int r = recv(sock, &c, 1, 0);
-        if (r == 0) return 0;
-        if (r < 0) return -1;
-        if (c == '\r') continue;
-        if (c == '\n') break;
-        out[idx++] = c;
+    (void)arg;
+    gate_state_t st = GATE_IDLE;
+    gate_req_t req;
+    int64_t deadline_ms = 0;
+
+    while (1) {
+        if (st == GATE_IDLE) {
+            if (xQueueReceive(s_gate_queue, &req, portMAX_DELAY) == pdTRUE) {
+                st = gate_start(&GATE_CFG, &req, &deadline_ms);
+            }
+            continue;
+        }
+
+        int64_t t = now_ms();
+        if (t < deadline_ms) {
+            vTaskDelay(ms_to_ticks_ceil(deadline_ms - t));
+            task_jitter_record(&s_gate_jitter, deadline_ms * 1000);
+            continue;
+        }
+        gate_state_t prev = st;
+        st = gate_advance(&GATE_CFG, st, &req, uxQueueMessagesWaiting(s_gate_queue) > 0, &deadline_ms);
+        if (prev == GATE_WELCOME) {
+            lat_hist_record(&s_qr_open_hist, now_ms() - req.rx_ms);   // includes GATE_WELCOME_MS
+        }
     }
-    out[idx] = 0;
-    return idx;
 }
 
-static void handle_qr_payload(const char *payload)
+static bool gate_post(gate_req_kind_t kind, const char *name, const char *zone)
 {
-    if (!payload || payload[0] == 0) return;
+    gate_req_t req = { .kind = kind, .rx_ms = now_ms() };
+    if (name) snprintf(req.name, sizeof(req.name), "%s", name);
+    if (zone) snprintf(req.zone, sizeof(req.zone), "%s", zone);
 
-    int64_t t = now_ms();
+    if (xQueueSend(s_gate_queue, &req, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Gate queue full, drop request");
+        return false;
+    }
+    return true;
+}
 
-    if (s_gate_busy) {
-        ESP_LOGW(TAG, "Gate busy, ignore");
-        return;
+// ============================================================
+// TCP server task
+// ============================================================
+// *dropped: the gate queue was full, the scan gets no screen.
+static qr_result_t handle_qr_payload(const char *payload, bool *dropped)
+{
+    qr_token_t tok;
+    *dropped = false;
+
+    xSemaphoreTake(s_allow_lock, portMAX_DELAY);
+    qr_result_t r = qr_check(&s_qr_filter, payload, &QR_POLICY, &tok);
+    xSemaphoreGive(s_allow_lock);
+    if (r == QR_IGNORE) {
+        if (payload && payload[0]) ESP_LOGW(TAG, "Same QR repeated, ignore");
+        return r;
     }
-    if ((t - s_gate_last_action_ms) < GATE_COOLDOWN_MS) {
-        ESP_LOGW(TAG, "Gate cooldown, ignore");
+
+    ESP_LOGI(TAG, "QR RX: %s -> %s", payload, qr_result_str(r));
+
+    switch (r) {
+    case QR_OPEN:
+        *dropped = !gate_post(GATE_REQ_OPEN, tok.name, tok.zone);
+        break;
+    case QR_WRONG_ZONE:
+        *dropped = !gate_post(GATE_REQ_WRONG_ZONE, NULL, tok.zone);
+        break;
+    case QR_EXPIRED:
+        *dropped = !gate_post(GATE_REQ_EXPIRED, NULL, NULL);
+        break;
+    case QR_REPLAY:
+        *dropped = !gate_post(GATE_REQ_USED, NULL, NULL);
+        break;
+    case QR_NOT_BOOKED:
+        *dropped = !gate_post(GATE_REQ_NOT_BOOKED, NULL, NULL);
+        break;
+    default:
+        // BAD_TAG / NO_CLOCK: same screen as a malformed code, the log has the reason.
+        *dropped = !gate_post(GATE_REQ_INVALID, NULL, NULL);
+        break;
+    }
+    return r;
+}
+
+static void tcp_conn_close(tcp_conn_t *c, const char *why)
+{
+    ESP_LOGI(TAG, "TCP client fd=%d closed (%s)", c->fd, why);
+    shutdown(c->fd, 0);
+    close(c->fd);
+    c->fd = -1;
+}
+
+static void tcp_conn_accept(int listen_fd)
+{
+    struct sockaddr_in6 source_addr;
+    socklen_t socklen = sizeof(source_addr);
+    int sock = accept(listen_fd, (struct sockaddr *)&source_addr, &socklen);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "accept() failed: errno=%d", errno);
         return;
     }
-    if (strncmp(payload, s_last_qr, sizeof(s_last_qr)) == 0) {
-        ESP_LOGW(TAG, "Same QR repeated, ignore");
+
+    for (int i = 0; i < TCP_MAX_CLIENTS; i++) {
+        tcp_conn_t *c = &s_tcp_conns[i];
+        if (c->fd >= 0) continue;
+        if (TCP_DECISION_ECHO) {
+            // Decision lines are small: without this each one waits for the
+            // client's delayed ACK of the previous one.
+            int one = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        c->fd = sock;
+        qr_link_reset(&c->link);
+        c->last_rx_ms = now_ms();
+        ESP_LOGI(TAG, "TCP client connected (fd=%d, slot %d)", sock, i);
         return;
     }
-    strncpy(s_last_qr, payload, sizeof(s_last_qr) - 1);
 
-    ESP_LOGI(TAG, "QR RX: %s", payload);
+    ESP_LOGW(TAG, "TCP client rejected: %d clients already connected", TCP_MAX_CLIENTS);
+    close(sock);
+}
+
+static void tcp_on_line(void *ctx, char *line, int n)
+{
+    tcp_conn_t *c = ctx;
+    int64_t t0 = esp_timer_get_time();
+    const char *result = "too long";
+    const char *gate = "-";
+
+    if (line) {
+        ESP_LOGI(TAG, "TCP RX line (%d): '%s'", n, line);
+        bool dropped;
+        qr_result_t r = handle_qr_payload(line, &dropped);
+        result = qr_result_str(r);
+        if (r != QR_IGNORE) gate = dropped ? "full" : "queued";
+    } else {
+        ESP_LOGW(TAG, "TCP fd=%d: line longer than %d bytes, dropped", c->fd, QR_LINK_BUF_SIZE - 1);
+    }
 
-    char name[64] = {0};
-    char zone[8]  = {0};
+    if (TCP_DECISION_ECHO) {
+        char out[QR_DECISION_MAX];
+        int len = qr_decision_format(out, sizeof(out), c->link.seq, now_ms(),
+                                     (uint32_t)(esp_timer_get_time() - t0), gate, result);
+        send(c->fd, out, len, MSG_DONTWAIT);   // best effort, never blocks the link
+    }
+}
 
-    if (!parse_qr_payload(payload, name, sizeof(name), zone, sizeof(zone))) {
-        lcd_show_invalid();
-        vTaskDelay(pdMS_TO_TICKS(1200));
-        lcd_show_waiting();
+static void tcp_conn_read(tcp_conn_t *c)
+{
+    // One recv() into the contiguous free part of the ring.
+    size_t room;
+    char *dst = qr_link_space(&c->link, &room);
+    int r = recv(c->fd, dst, room, 0);
+    if (r == 0) {
+        tcp_conn_close(c, "disconnected");
         return;
     }
-
-    if (zone[0] != QR_EXPECTED_ZONE) {
-        show_wrong_parking(zone);
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        lcd_show_waiting();
+    if (r < 0) {
+        ESP_LOGE(TAG, "recv() error: errno=%d", errno);
+        tcp_conn_close(c, "error");
         return;
     }
 
-    show_welcome(name);
-    gate_open_close();
-    lcd_show_waiting();
+    c->last_rx_ms = now_ms();
+    qr_link_commit(&c->link, (size_t)r, tcp_on_line, c);
 }
 
 static void tcp_server_task(void *arg)
 {
     (void)arg;
 
+    for (int i = 0; i < TCP_MAX_CLIENTS; i++) s_tcp_conns[i].fd = -1;
+
     int listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
     if (listen_fd < 0) {
         ESP_LOGE(TAG, "socket() failed: errno=%d", errno);
@@ -434,144 +719,268 @@ static void tcp_server_task(void *arg)
         return;
     }
 
-    if (listen(listen_fd, 2) != 0) {
+    if (listen(listen_fd, TCP_MAX_CLIENTS) != 0) {
         ESP_LOGE(TAG, "listen() failed: errno=%d", errno);
         close(listen_fd);
         vTaskDelete(NULL);
         return;
     }
 
-    ESP_LOGI(TAG, "TCP server listening on port %d", TCP_LISTEN_PORT);
+    ESP_LOGI(TAG, "TCP server listening on port %d (max %d clients)", TCP_LISTEN_PORT, TCP_MAX_CLIENTS);
 
     while (1) {
-        struct sockaddr_in6 source_addr;
-        socklen_t socklen = sizeof(source_addr);
-        int sock = accept(listen_fd, (struct sockaddr *)&source_addr, &socklen);
-        if (sock < 0) {
-            ESP_LOGE(TAG, "accept() failed: errno=%d", errno);
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(listen_fd, &rfds);
+        int max_fd = listen_fd;
+        for (int i = 0; i < TCP_MAX_CLIENTS; i++) {
+            int fd = s_tcp_conns[i].fd;
+            if (fd < 0) continue;
+            FD_SET(fd, &rfds);
+            if (fd > max_fd) max_fd = fd;
+        }
+
+        struct timeval tv = {
+            .tv_sec = TCP_SELECT_TIMEOUT_MS / 1000,
+            .tv_usec = (TCP_SELECT_TIMEOUT_MS % 1000) * 1000,
+        };
+        int ready = select(max_fd + 1, &rfds, NULL, NULL, &tv);
+        if (ready < 0) {
+            ESP_LOGE(TAG, "select() failed: errno=%d", errno);
             vTaskDelay(pdMS_TO_TICKS(200));
             continue;
         }
 
-        ESP_LOGI(TAG, "TCP client connected");
+        if (ready > 0 && FD_ISSET(listen_fd, &rfds)) tcp_conn_accept(listen_fd);
 
-        char line[TCP_RX_BUF_SIZE];
-        while (1) {
-            int n = recv_line(sock, line, sizeof(line));
-            if (n == 0) {
-                ESP_LOGI(TAG, "TCP client disconnected");
-                break;
-            }
-            if (n < 0) {
-                ESP_LOGE(TAG, "recv() error: errno=%d", errno);
-                break;
+        int64_t t = now_ms();
+        for (int i = 0; i < TCP_MAX_CLIENTS; i++) {
+            tcp_conn_t *c = &s_tcp_conns[i];
+            if (c->fd < 0) continue;
+            if (ready > 0 && FD_ISSET(c->fd, &rfds)) {
+                tcp_conn_read(c);
+            } else if ((t - c->last_rx_ms) > TCP_IDLE_TIMEOUT_MS) {
+                tcp_conn_close(c, "idle timeout");
             }
-
-            while (n > 0 && (line[n-1] == ' ' || line[n-1] == '\t')) line[--n] = 0;
-
-            ESP_LOGI(TAG, "TCP RX line (%d): '%s'", n, line);
-            handle_qr_payload(line);
         }
-
-        shutdown(sock, 0);
-        close(sock);
     }
 }
 
 // ============================================================
 // Rain ADC
 // ============================================================
-static void rain_adc_init(void)
-{
-    adc_oneshot_unit_init_cfg_t unit_cfg = {
-        .unit_id = RAIN_ADC_UNIT,
-        .ulp_mode = ADC_ULP_MODE_DISABLE,
-    };
-    ESP_ERROR_CHECK(adc_oneshot_new_unit(&unit_cfg, &s_adc));
-
-    adc_oneshot_chan_cfg_t chan_cfg = {
-        .bitwidth = RAIN_ADC_BITWIDTH,
-        .atten = RAIN_ADC_ATTEN,
-    };
-    ESP_ERROR_CHECK(adc_oneshot_config_channel(s_adc, RAIN_ADC_CHANNEL, &chan_cfg));
-}
-
-static int rain_adc_read_raw(void)
+static void analog_start(void)
 {
-    int raw = 0;
-    if (adc_oneshot_read(s_adc, RAIN_ADC_CHANNEL, &raw) != ESP_OK) return -1;
-    return raw;
+    esp_err_t err = analog_init(ANALOG_CHANNELS, BATTERY_MONITOR ? ANALOG_N : ANALOG_BATTERY);
+    s_analog_ok = (err == ESP_OK);
+    if (!s_analog_ok) ESP_LOGE(TAG, "ADC init failed: %s", esp_err_to_name(err));
 }
 
-static int rain01_from_raw(int raw)
+static void battery_poll(void)
 {
-    if (raw < 0) return 0;
-    raw = clampi(raw, RAIN_WET_RAW, RAIN_DRY_RAW);
-    return (raw <= RAIN_RAW_THRESHOLD) ? 1 : 0;
+    if (!s_analog_ok || s_analog[ANALOG_BATTERY].mv < 0) return;
+    s_battery_mv = s_analog[ANALOG_BATTERY].mv * BATTERY_DIVIDER;
 }
 
 // ============================================================
 // MQTT publish
 // ============================================================
-static void publish_spot(int i, bool occupied)
+// Per-slot event; also used in snapshot mode to drain the outbox (not retained),
+// since every backfilled transition carries its own timestamp.
+static bool publish_spot(int i, bool occupied, const evtime_t *ts)
 {
-    if (!s_mqtt_connected || !s_mqtt_client) return;
+    if (!s_mqtt_connected || !s_mqtt_client) return false;
 
+#if WIRE_FORMAT == WIRE_FORMAT_BINARY
+    uint8_t payload[WIRE_SPOT_MAX_LEN];
+    size_t len = wire_encode_spot(payload, sizeof(payload), s_spots.id[i], occupied, s_battery_mv, ts);
+    if (len == 0) return false;
+    return esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_SPOTS, (const char *)payload, (int)len, PUBLISH_QOS, SPOT_EVENT_RETAIN) >= 0;
+#else
     char payload[220];
+    char battery[24] = "";
+    char when[64];
+    if (s_battery_mv >= 0) snprintf(battery, sizeof(battery), ",\"battery_mv\":%d", s_battery_mv);
+    evtime_json(ts, when, sizeof(when));
     snprintf(payload, sizeof(payload),
-             "{\"parking_id\":\"%s\",\"slot_id\":\"%s\",\"occupied\":%s,\"ts_ms\":%" PRId64 "}",
-             PARKING_ID, SLOT_IDS[i], occupied ? "true" : "false", now_ms());
+             "{\"parking_id\":\"%s\",\"slot_id\":\"%s\",\"occupied\":%s%s%s}",
+             PARKING_ID, s_spots.id[i], occupied ? "true" : "false", battery, when);
 
-    esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_SPOTS, payload, 0, PUBLISH_QOS, PUBLISH_RETAIN);
+    return esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_SPOTS, payload, 0, PUBLISH_QOS, SPOT_EVENT_RETAIN) >= 0;
+#endif
 }
 
-static void publish_rain01_as_rain_pct(int rain01)
+#if SPOT_PUBLISH_MODE == SPOT_PUBLISH_SNAPSHOT
+// {"seq":12,"occ":"1a","chg":"2","sent_at":"...","sync_age_s":..} - bit i = s_spots.id[i]
+// ("ts_ms" uptime instead of sent_at until the clock is synced)
+static bool publish_spot_delta(uint64_t chg)
 {
-    if (!s_mqtt_connected || !s_mqtt_client) return;
-
-    char payload[96];
+    if (!s_mqtt_connected || !s_mqtt_client) return false;
+    evtime_t ts = evtime_at(now_ms());
+
+#if WIRE_FORMAT == WIRE_FORMAT_BINARY
+    uint8_t payload[WIRE_DELTA_MAX_LEN];
+    size_t len = wire_encode_delta(payload, sizeof(payload), s_spot_seq + 1, occupancy_published_bitmap(&s_occ), chg, &ts);
+    if (len == 0) return false;
+    if (esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_DELTA, (const char *)payload, (int)len, PUBLISH_QOS, 0) < 0) return false;
+#else
+    char payload[160];
+    char when[64];
+    evtime_json(&ts, when, sizeof(when));
     snprintf(payload, sizeof(payload),
-             "{\"sensor_id\":\"%s\",\"rain_pct\":%d}",
-             RAIN_SENSOR_ID, rain01);
+             "{\"seq\":%" PRIu32 ",\"occ\":\"%" PRIx64 "\",\"chg\":\"%" PRIx64 "\"%s}",
+             s_spot_seq + 1, occupancy_published_bitmap(&s_occ), chg, when);
 
-    esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_RAIN, payload, 0, PUBLISH_QOS, PUBLISH_RETAIN);
+    if (esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_DELTA, payload, 0, PUBLISH_QOS, 0) < 0) return false;
+#endif
+    s_spot_seq++;
+    return true;
+}
+
+// Full retained state, carries the slot list the bitmaps refer to.
+static bool publish_spot_snapshot(void)
+{
+    if (!s_mqtt_connected || !s_mqtt_client) return false;
+
+    char payload[96 + MAX_SPOTS * (SPOT_ID_LEN + 3)];
+    int n = snprintf(payload, sizeof(payload),
+                     "{\"parking_id\":\"%s\",\"seq\":%" PRIu32 ",\"slots\":[",
+                     PARKING_ID, s_spot_seq);
+    for (int i = 0; i < N_SPOTS && n < (int)sizeof(payload); i++) {
+        n += snprintf(payload + n, sizeof(payload) - n, "%s\"%s\"", i ? "," : "", s_spots.id[i]);
+    }
+    if (n < (int)sizeof(payload)) {
+        n += snprintf(payload + n, sizeof(payload) - n, "],\"occ\":\"%" PRIx64 "\"", occupancy_bitmap(&s_occ));
+    }
+    if (n < (int)sizeof(payload) && s_battery_mv >= 0) {
+        n += snprintf(payload + n, sizeof(payload) - n, ",\"battery_mv\":%d", s_battery_mv);
+    }
+    if (n < (int)sizeof(payload)) {
+        evtime_t ts = evtime_at(now_ms());
+        n += evtime_json(&ts, payload + n, sizeof(payload) - n);
+    }
+    if (n < (int)sizeof(payload)) n += snprintf(payload + n, sizeof(payload) - n, "}");
+    if (n >= (int)sizeof(payload)) {
+        ESP_LOGE(TAG, "Snapshot payload too large");
+        return false;
+    }
+
+    return esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_SNAPSHOT, payload, 0, PUBLISH_QOS, PUBLISH_RETAIN) >= 0;
 }
 
+#endif
+
 // ============================================================
-// Software PWM timer (spot LEDs)
+// Spot LEDs (LEDC hardware PWM)
 // ============================================================
-static void pwm_timer_cb(void *arg)
+// Channels are handed out high-speed first (ESP32 only), then low-speed,
+// skipping the servo channel. Spots beyond the available channels fall
+// back to plain on/off GPIO.
+static bool led_pwm_alloc(led_pwm_chan_t *out)
 {
-    (void)arg;
-    uint32_t phase = s_pwm_phase + 1;
-    if (phase >= PWM_STEPS) phase = 0;
-    s_pwm_phase = phase;
+    static int s_next_mode = 0;
+    static int s_next_ch = 0;
 
-    for (int i = 0; i < N_SPOTS; i++) {
-        uint8_t gd = s_green_duty[i];
-        uint8_t bd = s_blue_duty[i];
+    static const ledc_mode_t modes[] = {
+#if SOC_LEDC_SUPPORT_HS_MODE
+        LEDC_HIGH_SPEED_MODE,
+#endif
+        LEDC_LOW_SPEED_MODE,
+    };
+    const int n_modes = sizeof(modes) / sizeof(modes[0]);
+
+    while (s_next_mode < n_modes) {
+        ledc_mode_t mode = modes[s_next_mode];
+        // Only low-speed channels can run from RC_FAST through light sleep.
+        if (LOW_POWER_MODE && mode != LEDC_LOW_SPEED_MODE) { s_next_mode++; continue; }
+        while (s_next_ch < SOC_LEDC_CHANNEL_NUM) {
+            ledc_channel_t ch = (ledc_channel_t)s_next_ch++;
+            if (mode == SERVO_LEDC_MODE && ch == SERVO_LEDC_CHANNEL) continue;
+            out->hw = true;
+            out->mode = mode;
+            out->channel = ch;
+            return true;
+        }
+        s_next_mode++;
+        s_next_ch = 0;
+    }
+    out->hw = false;
+    return false;
+}
 
-        bool green_on = (gd > 0) && (phase < gd);
-        bool blue_on  = (bd > 0) && (phase < bd);
+static void led_pwm_channel_init(led_pwm_chan_t *c, gpio_num_t pin)
+{
+    if (!led_pwm_alloc(c)) {
+        ESP_LOGW(TAG, "No LEDC channel left for GPIO%d, using on/off", (int)pin);
+        return;
+    }
+
+    ledc_channel_config_t ccfg = {
+        .gpio_num = pin,
+        .speed_mode = c->mode,
+        .channel = c->channel,
+        .timer_sel = LED_LEDC_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+        .flags.output_invert = (LED_ON_LEVEL == 0),
+    };
+    ESP_ERROR_CHECK(ledc_channel_config(&ccfg));
+}
 
-        if (green_on) blue_on = false;
-        if (blue_on)  green_on = false;
+static void led_pwm_write(const led_pwm_chan_t *c, gpio_num_t pin, uint8_t steps)
+{
+    if (!c->hw) {
+        gpio_set_level(pin, steps ? LED_ON_LEVEL : LED_OFF_LEVEL);
+        return;
+    }
+    const uint32_t max_duty = (1UL << LED_LEDC_RES_BITS) - 1;
+    ledc_set_duty(c->mode, c->channel, (max_duty * steps) / PWM_STEPS);
+    ledc_update_duty(c->mode, c->channel);
+}
 
-        gpio_set_level(LED_GREEN[i], green_on ? LED_ON_LEVEL : LED_OFF_LEVEL);
-        gpio_set_level(LED_BLUE[i],  blue_on  ? LED_ON_LEVEL : LED_OFF_LEVEL);
+static void set_spot_led_pwm(int i, bool occupied)
+{
+    if (spots_on_shiftreg()) {
+        shiftreg_set_led(i, !occupied, occupied);   // goes out with the next scan
+        return;
     }
+
+    uint8_t gd = occupied ? 0 : BRIGHTNESS_STEPS;
+    uint8_t bd = occupied ? BRIGHTNESS_STEPS : 0;
+
+    // Only touch the peripheral on an actual change; LEDC keeps running on its own.
+    if (gd != s_green_duty[i]) { s_green_duty[i] = gd; led_pwm_write(&s_green_ch[i], s_spots.led_green[i], gd); }
+    if (bd != s_blue_duty[i])  { s_blue_duty[i]  = bd; led_pwm_write(&s_blue_ch[i],  s_spots.led_blue[i],  bd); }
 }
 
-static void pwm_start(void)
+static void led_pwm_init(void)
 {
-    const esp_timer_create_args_t targs = {
-        .callback = &pwm_timer_cb,
-        .arg = NULL,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "soft_pwm"
+    ledc_timer_config_t tcfg = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .duty_resolution = LED_LEDC_RES_BITS,
+        .timer_num = LED_LEDC_TIMER,
+        .freq_hz = LED_LEDC_FREQ_HZ,
+        .clk_cfg = LOW_POWER_MODE ? LEDC_USE_RC_FAST_CLK : LEDC_AUTO_CLK   // APB stops in light sleep
     };
-    ESP_ERROR_CHECK(esp_timer_create(&targs, &s_pwm_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(s_pwm_timer, PWM_TICK_US));
+    ESP_ERROR_CHECK(ledc_timer_config(&tcfg));
+#if SOC_LEDC_SUPPORT_HS_MODE
+    if (!LOW_POWER_MODE) {
+        tcfg.speed_mode = LEDC_HIGH_SPEED_MODE;
+        ESP_ERROR_CHECK(ledc_timer_config(&tcfg));
+    }
+#endif
+
+    // Shift registers: one channel on the sink drivers' /OE dims every LED at once.
+    if (spots_on_shiftreg()) {
+        led_pwm_channel_init(&s_sr_oe_ch, SHIFTREG_OE_PIN);
+        led_pwm_write(&s_sr_oe_ch, SHIFTREG_OE_PIN, BRIGHTNESS_STEPS);
+        return;
+    }
+
+    for (int i = 0; i < N_SPOTS; i++) {
+        led_pwm_channel_init(&s_green_ch[i], s_spots.led_green[i]);
+        led_pwm_channel_init(&s_blue_ch[i],  s_spots.led_blue[i]);
+    }
 }
 
 // ============================================================
@@ -610,10 +1019,14 @@ static void wifi_init_sta(void)
     strncpy((char *)wifi_config.sta.ssid, WIFI_SSID, sizeof(wifi_config.sta.ssid));
     strncpy((char *)wifi_config.sta.password, WIFI_PASS, sizeof(wifi_config.sta.password));
     wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    if (LOW_POWER_MODE) wifi_config.sta.listen_interval = WIFI_LISTEN_INTERVAL;
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Max modem sleep: the radio only wakes every listen_interval beacons;
+    // needed for automatic light sleep while associated.
+    if (LOW_POWER_MODE) ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MAX_MODEM));
 
     ESP_LOGI(TAG, "Connecting Wi-Fi SSID=%s ...", WIFI_SSID);
     xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
@@ -622,6 +1035,57 @@ static void wifi_init_sta(void)
 // ============================================================
 // MQTT
 // ============================================================
+static bool topic_is(const esp_mqtt_event_t *e, const char *topic)
+{
+    size_t n = strlen(topic);
+    return e->topic_len == (int)n && memcmp(e->topic, topic, n) == 0;
+}
+
+static void allowlist_rx(const esp_mqtt_event_t *e)
+{
+    if (!topic_is(e, MQTT_TOPIC_ALLOWLIST) && !topic_is(e, MQTT_TOPIC_ALLOWLIST_DELTA)) return;
+    if (e->data_len != e->total_data_len) {
+        ESP_LOGW(TAG, "Allowlist message of %d bytes split by the MQTT client, dropped", e->total_data_len);
+        return;
+    }
+
+    xSemaphoreTake(s_allow_lock, portMAX_DELAY);
+    uint32_t gaps = s_allow.gaps;
+    bool ok = allowlist_apply(&s_allow, (const uint8_t *)e->data, (size_t)e->data_len);
+    int count = s_allow.count;
+    bool lost = s_allow.gaps != gaps;
+    xSemaphoreGive(s_allow_lock);
+
+    if (!ok) {
+        ESP_LOGW(TAG, "Allowlist message rejected (%d bytes)", e->data_len);
+    } else if (topic_is(e, MQTT_TOPIC_ALLOWLIST)) {
+        ESP_LOGI(TAG, "Allowlist snapshot: %d reservation(s)", count);
+    } else if (lost) {
+        ESP_LOGW(TAG, "Allowlist delta lost, kept until the next snapshot");
+    }
+}
+
+static void ota_rx(const esp_mqtt_event_t *e)
+{
+    if (!topic_is(e, MQTT_TOPIC_OTA)) return;
+    ota_cmd_t cmd;
+    if (e->data_len != e->total_data_len || !ota_parse_cmd(e->data, (size_t)e->data_len, &cmd)) {
+        ESP_LOGW(TAG, "OTA command rejected (%d bytes)", e->total_data_len);
+        return;
+    }
+    ota_start(&cmd);
+}
+
+// Retained, so the fleet tool sees the last state of a board that is offline.
+static void ota_report(const char *state, const char *detail)
+{
+    if (!s_mqtt_connected || !s_mqtt_client) return;
+    char payload[192];
+    int len = snprintf(payload, sizeof(payload), "{\"parking_id\":\"%s\",\"state\":\"%s\",\"detail\":\"%s\",\"running\":\"%s\"}",
+                       PARKING_ID, state, detail, ota_running_version());
+    esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_OTA_STATUS, payload, len, 1, 1);
+}
+
 static void mqtt_event_handler(void *args, esp_event_base_t base, int32_t id, void *data)
 {
     (void)args; (void)base;
@@ -629,22 +1093,64 @@ static void mqtt_event_handler(void *args, esp_event_base_t base, int32_t id, vo
     case MQTT_EVENT_CONNECTED:
         s_mqtt_connected = true;
         ESP_LOGI(TAG, "MQTT connected");
+        s_snapshot_due = true;
+#if SPOT_PUBLISH_MODE == SPOT_PUBLISH_SNAPSHOT
+        // Older firmware left backfill retained here; the bridge would replay it on every restart.
+        esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_SPOTS, "", 0, PUBLISH_QOS, 1);
+#endif
+        if (!LOW_POWER_MODE) {
+            // The retained snapshot comes first, deltas follow.
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_ALLOWLIST, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_ALLOWLIST_DELTA, 1);
+        }
+        esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_OTA, 1);
+        ota_confirm();
+        if (s_ir_evt_queue) {
+            uint8_t wake = IR_EVT_WAKE;
+            xQueueSend(s_ir_evt_queue, &wake, 0);
+        }
         break;
     case MQTT_EVENT_DISCONNECTED:
         s_mqtt_connected = false;
         ESP_LOGW(TAG, "MQTT disconnected");
         break;
+    case MQTT_EVENT_DATA:
+        if (!LOW_POWER_MODE) allowlist_rx((const esp_mqtt_event_t *)data);
+        ota_rx((const esp_mqtt_event_t *)data);
+        break;
     default:
         break;
     }
 }
 
+// ============================================================
+// Wall clock (SNTP)
+// ============================================================
+static void on_time_sync(struct timeval *tv)
+{
+    (void)tv;
+    s_clock_sync_s = (int32_t)(now_ms() / 1000);
+    ESP_LOGI(TAG, "Clock synced (SNTP)");
+}
+
+// Polls SNTP_SERVER once the network is up, then every SNTP_RESYNC_MS.
+static void clock_start(void)
+{
+    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, SNTP_SERVER);
+    esp_sntp_set_sync_interval(SNTP_RESYNC_MS);
+    sntp_set_time_sync_notification_cb(on_time_sync);
+    esp_sntp_init();
+}
+
 static void mqtt_start(void)
 {
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = MQTT_URI,
-        .session.keepalive = 30,
+        .session.keepalive = MQTT_KEEPALIVE_S,
         .network.reconnect_timeout_ms = 5000,
+        .buffer.size = MQTT_RX_BUFFER_SIZE,
+        .buffer.out_size = MQTT_TX_BUFFER_SIZE,
     };
 
     s_mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
@@ -655,23 +1161,106 @@ static void mqtt_start(void)
 // ============================================================
 // GPIO init (spots)
 // ============================================================
+// Low power: IR pins are level interrupts (the only kind that wakes light
+// sleep). The ISR masks the pin until parking_task re-arms it after the
+// debounce window, on the level opposite to the confirmed state.
+static void IRAM_ATTR ir_isr_handler(void *arg)
+{
+    uint8_t idx = (uint8_t)(uintptr_t)arg;
+    BaseType_t hp_woken = pdFALSE;
+#if LOW_POWER_MODE
+    gpio_intr_disable(s_spots.ir_pin[idx]);   // CONFIG_GPIO_CTRL_FUNC_IN_IRAM
+#endif
+    xQueueSendFromISR(s_ir_evt_queue, &idx, &hp_woken);
+    if (hp_woken) portYIELD_FROM_ISR();
+}
+
+// The GPIO interrupt is allocated on the calling core: parking_task runs
+// this on IO_CORE, away from the Wi-Fi interrupt on core 0.
+static void ir_isr_start(void)
+{
+    if (spots_on_shiftreg()) return;
+    ESP_ERROR_CHECK(gpio_install_isr_service(0));
+    for (int i = 0; i < N_SPOTS; i++) {
+        ESP_ERROR_CHECK(gpio_isr_handler_add(s_spots.ir_pin[i], ir_isr_handler, (void *)(uintptr_t)i));
+    }
+}
+
+static void ir_arm_wakeup(int i)
+{
+#if LOW_POWER_MODE
+    gpio_num_t pin = s_spots.ir_pin[i];
+    int level = (s_occ.occ[i] != IR_ACTIVE_LOW) ? 1 : 0;   // level of the confirmed state
+    gpio_wakeup_enable(pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    gpio_intr_enable(pin);
+#else
+    (void)i;
+#endif
+}
+
+static void power_init(void)
+{
+    if (!LOW_POWER_MODE) return;
+
+    esp_pm_config_t pm = {
+        .max_freq_mhz = PM_MAX_CPU_FREQ_MHZ,
+        .min_freq_mhz = PM_MIN_CPU_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Power management unavailable: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+    ESP_LOGI(TAG, "Power management: DFS %d-%d MHz, auto light sleep", PM_MIN_CPU_FREQ_MHZ, PM_MAX_CPU_FREQ_MHZ);
+}
+
+static void spot_table_init(void)
+{
+    if (spot_table_load(&s_spots) == ESP_OK) {
+        ESP_LOGI(TAG, "Spot table from NVS: %u spots on %s", s_spots.count,
+                 spots_on_shiftreg() ? "shift registers" : "GPIO");
+        return;
+    }
+
+    memset(&s_spots, 0, sizeof(s_spots));
+    s_spots.io = SPOT_IO_GPIO;
+    s_spots.count = DEFAULT_N_SPOTS;
+    for (int i = 0; i < DEFAULT_N_SPOTS; i++) {
+        snprintf(s_spots.id[i], SPOT_ID_LEN, "%s", DEFAULT_SLOT_IDS[i]);
+        s_spots.ir_pin[i] = DEFAULT_IR_PINS[i];
+        s_spots.led_green[i] = DEFAULT_LED_GREEN[i];
+        s_spots.led_blue[i] = DEFAULT_LED_BLUE[i];
+    }
+    ESP_LOGI(TAG, "No spot table in NVS, using %d built-in GPIO spots", DEFAULT_N_SPOTS);
+}
+
 static void gpio_init_all(void)
 {
+    // Also carries IR_EVT_WAKE, so it exists whatever the backend.
+    s_ir_evt_queue = xQueueCreate(IR_EVT_QUEUE_LEN, sizeof(uint8_t));
+
+    if (spots_on_shiftreg()) {
+        ESP_ERROR_CHECK(shiftreg_init(s_spots.count));
+        return;
+    }
+
     for (int i = 0; i < N_SPOTS; i++) {
         gpio_config_t in_cfg = {
-            .pin_bit_mask = 1ULL << IR_PINS[i],
+            .pin_bit_mask = 1ULL << s_spots.ir_pin[i],
             .mode = GPIO_MODE_INPUT,
             .pull_up_en = GPIO_PULLUP_DISABLE,
             .pull_down_en = GPIO_PULLDOWN_DISABLE,
-            .intr_type = GPIO_INTR_DISABLE
+            .intr_type = GPIO_INTR_ANYEDGE
         };
         ESP_ERROR_CHECK(gpio_config(&in_cfg));
     }
 
     uint64_t mask = 0;
     for (int i = 0; i < N_SPOTS; i++) {
-        mask |= (1ULL << LED_GREEN[i]);
-        mask |= (1ULL << LED_BLUE[i]);
+        mask |= (1ULL << s_spots.led_green[i]);
+        mask |= (1ULL << s_spots.led_blue[i]);
     }
 
     gpio_config_t out_cfg = {
@@ -684,58 +1273,329 @@ static void gpio_init_all(void)
     ESP_ERROR_CHECK(gpio_config(&out_cfg));
 
     for (int i = 0; i < N_SPOTS; i++) {
-        gpio_set_level(LED_GREEN[i], LED_OFF_LEVEL);
-        gpio_set_level(LED_BLUE[i],  LED_OFF_LEVEL);
+        gpio_set_level(s_spots.led_green[i], LED_OFF_LEVEL);
+        gpio_set_level(s_spots.led_blue[i],  LED_OFF_LEVEL);
     }
 }
 
 // ============================================================
 // Parking task (spots + rain)
 // ============================================================
+static void spot_latency_done(int i)
+{
+    if (!s_spot_edge_ms[i]) return;
+    lat_hist_record(&s_edge_pub_hist, now_ms() - s_spot_edge_ms[i]);
+    s_spot_edge_ms[i] = 0;
+}
+
+static void spot_publish_if_changed(int i)
+{
+    bool occ = s_occ.occ[i];
+
+    evtime_t ts = evtime_at(now_ms());
+
+    switch (occupancy_publish_decide(&s_occ, i, s_mqtt_connected, outbox_depth() > 0)) {
+    case OCC_PUB_OUTBOX:
+        // Offline, or a backlog still draining: queue behind it to keep order.
+        outbox_push((uint8_t)i, occ, &ts);
+        s_spot_edge_ms[i] = 0;   // backfill latency is outage time, not firmware latency
+        break;
+    case OCC_PUB_NOW:
+        if (publish_spot(i, occ, &ts)) spot_latency_done(i);
+        else outbox_push((uint8_t)i, occ, &ts);
+        break;
+    case OCC_PUB_REFRESH:
+        publish_spot(i, occ, &ts);
+        break;
+    case OCC_PUB_HELD:
+        // Rate limited: the holding time is deliberate, not firmware latency.
+        if (!s_occ.suppressed[i]) ESP_LOGW(TAG, "Rate limit: %s is flapping, holding changes", s_spots.id[i]);
+        s_spot_edge_ms[i] = 0;
+        break;
+    case OCC_PUB_BATCH:     // out with the next delta
+    case OCC_PUB_NONE:
+    default:
+        break;
+    }
+}
+
+// Backfill in order, a few events per step so reconnects don't flood the broker.
+static void outbox_drain(void)
+{
+    outbox_evt_t e;
+    for (int n = 0; n < OUTBOX_DRAIN_BURST && outbox_peek(&e); n++) {
+        if (e.spot < N_SPOTS && !publish_spot(e.spot, e.occupied, &e.ts)) break;
+        outbox_pop();
+    }
+    if (outbox_depth() == 0) ESP_LOGI(TAG, "Outbox drained");
+}
+
+// Re-read one pin and apply it as the confirmed state.
+static bool spot_confirm(int i)
+{
+    if (!occupancy_confirm_pin(&s_occ, i, s_spots.ir_pin[i], IR_ACTIVE_LOW)) return false;
+    set_spot_led_pwm(i, s_occ.occ[i]);
+    return true;
+}
+
+// {"up_s":..,"heap":..,"heap_min":..,"outbox":..,"jitter_us":{"<task>":{"avg":..,"max":..,"n":..},..},
+//  "allow_n":..,"allow_gaps":..,"sync_age_s":..,"suppressed":..,"flapping":{"<slot>":n,..},
+//  "qr_open_ms":[..],"qr_open_ms_max":..,"edge_pub_ms":[..],"edge_pub_ms_max":..,"tasks":[..]}
+// "suppressed":N,"flapping":{..}, since the last report: transitions the rate
+// limit never published, in total and for the TELEMETRY_FLAPPING_MAX worst slots.
+#define TELEMETRY_FLAPPING_MAX    4
+
+static int format_suppressed(char *buf, int cap)
+{
+    uint32_t total = 0;
+    int top[TELEMETRY_FLAPPING_MAX];
+    int n_top = 0;
+    for (int i = 0; i < N_SPOTS; i++) {
+        uint16_t c = s_occ.suppressed[i];
+        if (!c) continue;
+        total += c;
+        int k = n_top;
+        if (k == TELEMETRY_FLAPPING_MAX) {
+            if (c <= s_occ.suppressed[top[k - 1]]) continue;
+            k--;
+        } else {
+            n_top++;
+        }
+        for (; k > 0 && s_occ.suppressed[top[k - 1]] < c; k--) top[k] = top[k - 1];   // keep it sorted
+        top[k] = i;
+    }
+
+    int n = snprintf(buf, cap, "\"suppressed\":%" PRIu32 ",\"flapping\":{", total);
+    for (int k = 0; k < n_top && n < cap; k++) {
+        n += snprintf(buf + n, cap - n, "%s\"%s\":%u", k ? "," : "", s_spots.id[top[k]], s_occ.suppressed[top[k]]);
+    }
+    if (n < cap) n += snprintf(buf + n, cap - n, "},");
+    return n;
+}
+
+static bool publish_telemetry(void)
+{
+    if (!s_mqtt_connected || !s_mqtt_client) return false;
+
+    xSemaphoreTake(s_allow_lock, portMAX_DELAY);
+    int allow_n = s_allow.loaded ? s_allow.count : -1;
+    uint32_t allow_gaps = s_allow.gaps;
+    xSemaphoreGive(s_allow_lock);
+
+    static char payload[1536];
+    const int cap = (int)sizeof(payload);
+    int n = snprintf(payload, cap,
+                     "{\"up_s\":%" PRId64 ",\"heap\":%" PRIu32 ",\"heap_min\":%" PRIu32 ",\"outbox\":%d,"
+                     "\"allow_n\":%d,\"allow_gaps\":%" PRIu32 ",\"sync_age_s\":%d,\"jitter_us\":{",
+                     now_ms() / 1000, esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+                     (int)outbox_depth(), allow_n, allow_gaps, hal_clock_sync_age_s());
+    if (n < cap) n += task_jitter_format(payload + n, cap - n, "parking_task", &s_parking_jitter);
+    if (!LOW_POWER_MODE) {
+        if (n < cap) n += snprintf(payload + n, cap - n, ",");
+        if (n < cap) n += task_jitter_format(payload + n, cap - n, "gate_task", &s_gate_jitter);
+        if (n < cap) n += snprintf(payload + n, cap - n, ",");
+        if (n < cap) n += task_jitter_format(payload + n, cap - n, "display_task", display_jitter());
+    }
+    if (n < cap) n += snprintf(payload + n, cap - n, "},");
+    if (n < cap) n += format_suppressed(payload + n, cap - n);
+    if (n < cap) n += lat_hist_format(payload + n, cap - n, "qr_open_ms", &s_qr_open_hist);
+    if (n < cap) n += snprintf(payload + n, cap - n, ",");
+    if (n < cap) n += lat_hist_format(payload + n, cap - n, "edge_pub_ms", &s_edge_pub_hist);
+    if (n < cap) n += snprintf(payload + n, cap - n, ",");
+    if (n < cap) n += telemetry_format_tasks(payload + n, cap - n);
+    if (n < cap) n += snprintf(payload + n, cap - n, "}");
+    if (n >= cap) {
+        ESP_LOGE(TAG, "Telemetry payload too large");
+        return false;
+    }
+
+    if (esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_TELEMETRY, payload, n, 0, 0) < 0) return false;
+    // Only now: a report that did not go out leaves its counts for the next one.
+    memset(s_occ.suppressed, 0, sizeof(s_occ.suppressed));
+    return true;
+}
+
+// Shift-register backend: one bulk read for all spots, then 2-bit vertical
+// counters debounce every input at once (occupancy_scan).
+static bool spot_read_all(uint64_t *occ)
+{
+    uint64_t raw;
+    if (shiftreg_scan(&raw) != ESP_OK) return false;
+    *occ = (IR_ACTIVE_LOW ? ~raw : raw) & spot_table_mask(&s_spots);
+    return true;
+}
+
+static bool spot_scan(void)
+{
+    uint64_t occ;
+    if (!spot_read_all(&occ)) return false;
+
+    uint64_t flip = occupancy_scan(&s_occ, occ);
+    bool changed = (flip != 0);
+    while (flip) {
+        int i = __builtin_ctzll(flip);
+        flip &= flip - 1;
+        s_spot_edge_ms[i] = now_ms() - 2 * SPOT_SCAN_TICK_MS;   // first differing scan
+        set_spot_led_pwm(i, s_occ.occ[i]);
+        spot_publish_if_changed(i);
+    }
+    return changed;
+}
+
 static void parking_task(void *arg)
 {
     (void)arg;
-    for (int i = 0; i < N_SPOTS; i++) s_occ_prev[i] = !s_occ[i];
 
-    while (1) {
-        int rain_raw = rain_adc_read_raw();
-        s_rain01 = rain01_from_raw(rain_raw);
-
-#if RAIN_PUBLISH_ON_CHANGE_ONLY
-        if (s_rain01 != s_rain01_prev) {
-            ESP_LOGI(TAG, "Rain change: raw=%d => %d", rain_raw, s_rain01);
-            publish_rain01_as_rain_pct(s_rain01);
-            s_rain01_prev = s_rain01;
-        }
+    ir_isr_start();
+    occupancy_init(&s_occ, N_SPOTS, SPOT_PUBLISH_MODE == SPOT_PUBLISH_SNAPSHOT, PUBLISH_ON_CHANGE_ONLY);
+    occupancy_set_rate_limit(&s_occ, SPOT_RATE_BURST, SPOT_RATE_WINDOW_MS);
+    if (spots_on_shiftreg() && !spot_read_all(&s_occ.scan_state)) {
+        ESP_LOGE(TAG, "Shift register scan failed");
+    }
+
+    for (int i = 0; i < N_SPOTS; i++) {
+        s_occ.occ[i] = spots_on_shiftreg() ? ((s_occ.scan_state >> i) & 1)
+                                           : (hal_gpio_get(s_spots.ir_pin[i]) != IR_ACTIVE_LOW);
+#if SPOT_PUBLISH_MODE == SPOT_PUBLISH_SNAPSHOT
+        s_occ.prev[i] = s_occ.occ[i];    // the snapshot sent on connect carries the boot state
 #else
-        publish_rain01_as_rain_pct(s_rain01);
-        s_rain01_prev = s_rain01;
+        s_occ.prev[i] = !s_occ.occ[i];   // publish everything once at boot
+#endif
+        set_spot_led_pwm(i, s_occ.occ[i]);
+        spot_publish_if_changed(i);
+        if (!spots_on_shiftreg()) ir_arm_wakeup(i);
+    }
+
+    int64_t next_rain_ms = now_ms();
+    int64_t next_resync_ms = now_ms() + IR_RESYNC_EVERY_MS;
+    int64_t next_drain_ms = 0;
+    int64_t next_scan_ms = now_ms() + SPOT_SCAN_TICK_MS;
+    int64_t next_battery_ms = BATTERY_MONITOR ? now_ms() : INT64_MAX;
+    int64_t next_telemetry_ms = TELEMETRY_EVERY_MS ? now_ms() + TELEMETRY_EVERY_MS : INT64_MAX;
+#if SPOT_PUBLISH_MODE == SPOT_PUBLISH_SNAPSHOT
+    int64_t next_delta_ms = 0;
+    int64_t next_snapshot_ms = 0;
 #endif
 
+    while (1) {
+        // Sleep until the earliest deadline: pending debounce, rain read, resync or publish.
+        int64_t t = now_ms();
+        int64_t wake_ms = (next_rain_ms < next_resync_ms) ? next_rain_ms : next_resync_ms;
+        if (spots_on_shiftreg() && next_scan_ms < wake_ms) wake_ms = next_scan_ms;
+        if (next_battery_ms < wake_ms) wake_ms = next_battery_ms;
+        if (next_telemetry_ms < wake_ms) wake_ms = next_telemetry_ms;
+        int64_t release_ms = occupancy_next_release_ms(&s_occ);
+        if (release_ms < wake_ms) wake_ms = release_ms;
         for (int i = 0; i < N_SPOTS; i++) {
-            s_occ[i] = read_occupied(i);
-            set_spot_led_pwm(i, s_occ[i]);
+            if (s_ir_confirm_at_ms[i] && s_ir_confirm_at_ms[i] < wake_ms) wake_ms = s_ir_confirm_at_ms[i];
+        }
+        if (s_mqtt_connected && outbox_depth() > 0 && next_drain_ms < wake_ms) wake_ms = next_drain_ms;
+#if SPOT_PUBLISH_MODE == SPOT_PUBLISH_SNAPSHOT
+        if (s_mqtt_connected && outbox_depth() == 0) {
+            int64_t snap_ms = s_snapshot_due ? t : next_snapshot_ms;
+            if (snap_ms < wake_ms) wake_ms = snap_ms;
+            if (s_occ.chg && next_delta_ms < wake_ms) wake_ms = next_delta_ms;
         }
+#endif
+
+        uint8_t idx;
+        if (xQueueReceive(s_ir_evt_queue, &idx, ms_to_ticks_ceil(wake_ms - t)) == pdTRUE) {
+            // Every edge (re)arms the confirmation window: a flapping sensor never confirms.
+            if (idx < N_SPOTS) {
+                if (!s_ir_confirm_at_ms[idx]) s_spot_edge_ms[idx] = now_ms();
+                s_ir_confirm_at_ms[idx] = now_ms() + IR_DEBOUNCE_MS;
+            }
+            continue;
+        }
+
+        // Timed wake: how late did we run past the deadline we slept for? A deadline
+        // already past when we got here (zero-tick wait) is backlog, not scheduling jitter.
+        if (wake_ms > t) task_jitter_record(&s_parking_jitter, wake_ms * 1000);
+
+        t = now_ms();
+        bool changed = false;
 
         for (int i = 0; i < N_SPOTS; i++) {
-#if PUBLISH_ON_CHANGE_ONLY
-            if (s_occ[i] != s_occ_prev[i]) {
-                publish_spot(i, s_occ[i]);
-                s_occ_prev[i] = s_occ[i];
+            if (!s_ir_confirm_at_ms[i] || t < s_ir_confirm_at_ms[i]) continue;
+            s_ir_confirm_at_ms[i] = 0;
+            if (spot_confirm(i)) {
+                spot_publish_if_changed(i);
+                changed = true;
+            } else {
+                s_spot_edge_ms[i] = 0;   // bounced back, nothing to publish
+            }
+            ir_arm_wakeup(i);
+        }
+
+        if (spots_on_shiftreg() && t >= next_scan_ms) {
+            next_scan_ms += SPOT_SCAN_TICK_MS;
+            if (next_scan_ms <= t) next_scan_ms = t + SPOT_SCAN_TICK_MS;   // fell behind: don't burst
+            if (spot_scan()) changed = true;
+        }
+
+        // Polled backends are never out of sync; this is for missed GPIO edges.
+        if (t >= next_resync_ms) {
+            next_resync_ms = t + IR_RESYNC_EVERY_MS;
+            for (int i = 0; i < N_SPOTS; i++) {
+                if (s_ir_confirm_at_ms[i]) continue;   // still settling
+                if (!spots_on_shiftreg() && spot_confirm(i)) {
+                    ESP_LOGW(TAG, "Resync: %s changed without edge", s_spots.id[i]);
+                    changed = true;
+                }
+                spot_publish_if_changed(i);
+            }
+        }
+
+        // Rate-limited slots whose token is back: send their latest state.
+        if (s_occ.held && t >= occupancy_next_release_ms(&s_occ)) {
+            for (uint64_t m = s_occ.held; m; m &= m - 1) spot_publish_if_changed(__builtin_ctzll(m));
+        }
+
+        if (t >= next_rain_ms) {
+            next_rain_ms = t + RAIN_READ_EVERY_MS;
+            if (rain_poll(&s_rain)) {
+                ESP_LOGI(TAG, "Rain: raw=%d mv=%d => %d%%", s_rain.raw, s_rain.mv, s_rain.pct);
             }
-#else
-            publish_spot(i, s_occ[i]);
-            s_occ_prev[i] = s_occ[i];
-#endif
         }
 
-        static int tick = 0;
-        tick++;
-        if (tick % (1000 / READ_EVERY_MS) == 0) {
-            ESP_LOGI(TAG, "Free=%d/%d", count_free(), N_SPOTS);
+        if (t >= next_battery_ms) {
+            next_battery_ms = t + BATTERY_READ_EVERY_MS;
+            battery_poll();
         }
 
-        vTaskDelay(pdMS_TO_TICKS(READ_EVERY_MS));
+        if (t >= next_telemetry_ms) {
+            next_telemetry_ms = t + TELEMETRY_EVERY_MS;
+            publish_telemetry();
+        }
+
+        if (s_mqtt_connected && outbox_depth() > 0 && t >= next_drain_ms) {
+            outbox_drain();
+            next_drain_ms = t + OUTBOX_DRAIN_EVERY_MS;
+        }
+        outbox_persist(t, OUTBOX_PERSIST_EVERY_MS);
+
+#if SPOT_PUBLISH_MODE == SPOT_PUBLISH_SNAPSHOT
+        // The snapshot is current state: only after the backlog is out.
+        if (s_mqtt_connected && outbox_depth() == 0 && (s_snapshot_due || t >= next_snapshot_ms)) {
+            if (publish_spot_snapshot()) {
+                s_snapshot_due = false;
+                for (int i = 0; i < N_SPOTS; i++) spot_latency_done(i);
+                occupancy_snapshot_sent(&s_occ);   // changes and held slots are part of it
+                next_snapshot_ms = t + SPOT_SNAPSHOT_EVERY_MS;
+            }
+        }
+        if (s_mqtt_connected && s_occ.chg && t >= next_delta_ms) {
+            if (publish_spot_delta(s_occ.chg)) {
+                for (uint64_t m = s_occ.chg; m; m &= m - 1) spot_latency_done(__builtin_ctzll(m));
+                s_occ.chg = 0;
+            }
+            next_delta_ms = t + SPOT_DELTA_TICK_MS;
+        }
+#endif
+
+        if (changed) {
+            ESP_LOGI(TAG, "Free=%d/%d", occupancy_count_free(&s_occ), N_SPOTS);
+        }
     }
 }
 
@@ -749,27 +1609,52 @@ void app_main(void)
         ESP_ERROR_CHECK(nvs_flash_erase());
         ESP_ERROR_CHECK(nvs_flash_init());
     }
+    outbox_init();
+    allowlist_init(&s_allow);
+    s_allow_lock = xSemaphoreCreateMutex();
 
-    gpio_init_all();
-    pwm_start();
-    rain_adc_init();
-
-    // ---- LCD init using your working library ----
-    lcd_init(LCD_COLS, LCD_ROWS);
-    backlight();
-    clear();
-    lcd_show_waiting();
+    power_init();
 
-    // ---- Servo ----
-    servo_init();
+    spot_table_init();
+    gpio_init_all();
+    led_pwm_init();
+    analog_start();
+    rain_init(&s_rain, &RAIN_CFG);
+
+    // Sensor-only nodes have no LCD, servo or camera link.
+    if (!LOW_POWER_MODE) {
+        // ---- LCD: init runs in the display task, boot does not wait for it ----
+        display_start();
+        gate_show_waiting();
+
+        // ---- Servo ----
+        servo_init();
+    }
 
     // ---- Wi-Fi + MQTT ----
+    ota_init(ota_report, OTA_CONFIRM_TIMEOUT_MS);
     wifi_init_sta();
     mqtt_start();
 
-    // ---- TCP server ----
-    xTaskCreate(tcp_server_task, "tcp_server", 6144, NULL, 7, NULL);
+    clock_start();
+
+    if (!LOW_POWER_MODE) {
+        // ---- QR keys for signed tokens ----
+        if (qr_keys_load(&s_qr_keys) != ESP_OK) {
+            ESP_LOGW(TAG, "No QR keys provisioned, signed tokens will be refused");
+        }
+    }
+
+    if (!LOW_POWER_MODE) {
+        // ---- Gate controller (owns the servo, posts screens to the display task) ----
+        s_gate_queue = xQueueCreate(GATE_QUEUE_LEN, sizeof(gate_req_t));
+        xTaskCreatePinnedToCore(gate_task, "gate_task", GATE_TASK_STACK, NULL, GATE_TASK_PRIO, NULL, IO_CORE);
+
+        // ---- TCP server ----
+        xTaskCreatePinnedToCore(tcp_server_task, "tcp_server", TCP_SERVER_TASK_STACK, NULL, TCP_SERVER_TASK_PRIO,
+                                NULL, NET_CORE);
+    }
 
-    // ---- Parking logic ----
-    xTaskCreate(parking_task, "parking_task", 7168, NULL, 5, NULL);
+    // ---- Parking logic (cores and priorities: task_plan.h) ----
+    xTaskCreatePinnedToCore(parking_task, "parking_task", PARKING_TASK_STACK, NULL, PARKING_TASK_PRIO, NULL, IO_CORE);
 }
@@ -0,0 +1,129 @@
+/* @file  display.c
+   @brief display service: a task that owns the LCD and renders queued requests
+
+   Nobody else touches the LCD: callers post a request and return, so the
+   network and sensor tasks never wait on I2C or on the HD44780 timings.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lcd_i2c.h"
+#include "lcd_fb.h"
+#include "display.h"
+#include "task_plan.h"
+
+#define DISPLAY_QUEUE_LEN   8
+
+typedef enum {
+    DISPLAY_REQ_SHOW,
+    DISPLAY_REQ_MESSAGE,
+} display_req_kind_t;
+
+typedef struct {
+    display_req_kind_t kind;
+    uint32_t hold_ms;
+    char line[LCD_FB_ROWS][LCD_FB_COLS + 1];
+} display_req_t;
+
+static const char *TAG = "DISPLAY";
+static QueueHandle_t s_display_queue = NULL;
+static task_jitter_t s_jitter = TASK_JITTER_INIT;
+
+static int64_t display_now_ms(void) { return esp_timer_get_time() / 1000; }
+
+static void display_render(char line[LCD_FB_ROWS][LCD_FB_COLS + 1])
+{
+    for (int r = 0; r < LCD_FB_ROWS; r++) lcd_fb_print_line((uint8_t)r, line[r]);
+    esp_err_t err = lcd_fb_flush();
+    if (err != ESP_OK) ESP_LOGW(TAG, "LCD write failed: %s", esp_err_to_name(err));
+}
+
+static void display_task(void *arg)
+{
+    (void)arg;
+    char base[LCD_FB_ROWS][LCD_FB_COLS + 1] = {{0}};
+    bool base_dirty = true;
+    int64_t msg_until_ms = 0;   // 0 = base screen is up
+    display_req_t req;
+
+    // lcd_begin()/clear() waits go through delay_us(), which yields here.
+    lcd_init(LCD_FB_COLS, LCD_FB_ROWS);
+    backlight();
+    clear();
+    lcd_fb_init();
+    ESP_LOGI(TAG, "LCD ready");
+
+    while (1) {
+        TickType_t wait = portMAX_DELAY;
+
+        if (msg_until_ms) {
+            int64_t left = msg_until_ms - display_now_ms();
+            if (left <= 0) {
+                msg_until_ms = 0;
+                base_dirty = true;
+                continue;
+            }
+            wait = (TickType_t)((left + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+        } else if (base_dirty) {
+            display_render(base);
+            base_dirty = false;
+        }
+
+        if (xQueueReceive(s_display_queue, &req, wait) != pdTRUE) {
+            // only a wait that timed out on the message deadline is a jitter sample
+            if (msg_until_ms) task_jitter_record(&s_jitter, msg_until_ms * 1000);
+            continue;
+        }
+
+        if (req.kind == DISPLAY_REQ_SHOW) {
+            // a new base screen is newer than the timed message: drop the message
+            memcpy(base, req.line, sizeof(base));
+            msg_until_ms = 0;
+            base_dirty = true;
+        } else {
+            display_render(req.line);
+            msg_until_ms = display_now_ms() + (req.hold_ms ? req.hold_ms : 1);
+        }
+    }
+}
+
+static void display_post(display_req_kind_t kind, const char *line0, const char *line1, uint32_t hold_ms)
+{
+    if (!s_display_queue) return;
+
+    display_req_t req = { .kind = kind, .hold_ms = hold_ms };
+    snprintf(req.line[0], sizeof(req.line[0]), "%s", line0 ? line0 : "");
+    snprintf(req.line[1], sizeof(req.line[1]), "%s", line1 ? line1 : "");
+
+    if (xQueueSend(s_display_queue, &req, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Display queue full, drop request");
+    }
+}
+
+void display_start(void)
+{
+    if (s_display_queue) return;
+    s_display_queue = xQueueCreate(DISPLAY_QUEUE_LEN, sizeof(display_req_t));
+    xTaskCreatePinnedToCore(display_task, "display_task", DISPLAY_TASK_STACK, NULL, DISPLAY_TASK_PRIO, NULL, IO_CORE);
+}
+
+void display_show(const char *line0, const char *line1)
+{
+    display_post(DISPLAY_REQ_SHOW, line0, line1, 0);
+}
+
+void display_message(const char *line0, const char *line1, uint32_t hold_ms)
+{
+    display_post(DISPLAY_REQ_MESSAGE, line0, line1, hold_ms);
+}
+
+task_jitter_t *display_jitter(void)
+{
+    return &s_jitter;
+}
@@ -0,0 +1,26 @@
+/* @file  display.h
+   @brief display service: a task that owns the LCD and renders queued requests
+*/
+
+#ifndef _DISPLAY_H_
+#define _DISPLAY_H_
+
+#include <stdint.h>
+#include "telemetry.h"
+
+// Create the queue and the task. LCD init (~1 s of power-up waits) runs in
+// the task, so this returns immediately; requests posted meanwhile are kept.
+void display_start(void);
+
+// Set the base screen, shown whenever no timed message is up. NULL = blank line.
+// It also cancels the current timed message, so it is shown immediately.
+void display_show(const char *line0, const char *line1);
+
+// Show a message for hold_ms, then fall back to the base screen. A newer
+// message replaces the current one immediately.
+void display_message(const char *line0, const char *line1, uint32_t hold_ms);
+
+// Lateness of the display task at message expiry, for the telemetry report.
+task_jitter_t *display_jitter(void);
+
+#endif
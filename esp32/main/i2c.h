@@ -6,12 +6,15 @@
 #ifndef _I2C_H_
 #define _I2C_H_
 
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 
 
 int i2c_init(void);
+esp_err_t master_write_buf(const uint8_t *data, size_t len, uint8_t i2c_addr);
 esp_err_t master_write_slave(uint8_t data,uint8_t i2c_addr);
-void master_send_data(uint8_t data,uint8_t i2c_addr);
+esp_err_t master_send_data(uint8_t data,uint8_t i2c_addr);
 
 #endif
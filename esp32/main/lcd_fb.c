@@ -0,0 +1,69 @@
+/* @file  lcd_fb.c
+   @brief in-RAM shadow of the 16x2 LCD, flushes only the cells that changed
+*/
+
+#include <string.h>
+#include "lcd_i2c.h"
+#include "lcd_fb.h"
+
+#define LCD_FB_UNKNOWN 0   // never a printable char: forces a redraw of the cell
+
+static char s_back[LCD_FB_ROWS][LCD_FB_COLS];    // wanted
+static char s_front[LCD_FB_ROWS][LCD_FB_COLS];   // on the glass
+static int s_cur_row = -1;                       // LCD address counter, -1 = unknown
+static int s_cur_col = -1;
+
+void lcd_fb_init(void)
+{
+    memset(s_back, ' ', sizeof(s_back));
+    memset(s_front, ' ', sizeof(s_front));
+    s_cur_row = 0;
+    s_cur_col = 0;
+}
+
+void lcd_fb_invalidate(void)
+{
+    memset(s_front, LCD_FB_UNKNOWN, sizeof(s_front));
+    s_cur_row = -1;
+    s_cur_col = -1;
+}
+
+void lcd_fb_print_line(uint8_t row, const char *s)
+{
+    if (row >= LCD_FB_ROWS) return;
+    size_t n = s ? strlen(s) : 0;
+    if (n > LCD_FB_COLS) n = LCD_FB_COLS;
+    memset(s_back[row], ' ', LCD_FB_COLS);
+    if (n) memcpy(s_back[row], s, n);
+}
+
+esp_err_t lcd_fb_flush(void)
+{
+    for (int row = 0; row < LCD_FB_ROWS; row++) {
+        int col = 0;
+        while (col < LCD_FB_COLS) {
+            if (s_back[row][col] == s_front[row][col]) { col++; continue; }
+
+            // One transaction per run of dirty cells: [cursor move] + chars
+            int end = col;
+            while (end < LCD_FB_COLS && s_back[row][end] != s_front[row][end]) end++;
+
+            esp_err_t err;
+            if (row == s_cur_row && col == s_cur_col) {
+                err = lcd_write_buf(&s_back[row][col], (size_t)(end - col));
+            } else {
+                err = lcd_write_at((uint8_t)col, (uint8_t)row, &s_back[row][col], (size_t)(end - col));
+            }
+            if (err != ESP_OK) {
+                lcd_fb_invalidate();   // glass state unknown, repaint next time
+                return err;
+            }
+
+            memcpy(&s_front[row][col], &s_back[row][col], (size_t)(end - col));
+            s_cur_row = row;
+            s_cur_col = end;   // DDRAM address auto-increments
+            col = end;
+        }
+    }
+    return ESP_OK;
+}
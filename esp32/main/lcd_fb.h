@@ -0,0 +1,29 @@
+/* @file  lcd_fb.h
+   @brief in-RAM shadow of the 16x2 LCD, flushes only the cells that changed
+*/
+
+#ifndef _LCD_FB_H_
+#define _LCD_FB_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define LCD_FB_COLS 16
+#define LCD_FB_ROWS 2
+
+// Call right after clear(): the shadow starts as all spaces.
+void lcd_fb_init(void);
+
+// Write a line into the back buffer, space padded / truncated to LCD_FB_COLS.
+void lcd_fb_print_line(uint8_t row, const char *s);
+
+// Send the cells that differ from what is on the glass, one I2C transaction
+// per run of dirty cells. A cursor move is only issued when the run does not
+// start where the last write left the cursor. On error the shadow is
+// invalidated so the next flush repaints everything.
+esp_err_t lcd_fb_flush(void);
+
+// Forget what is on the glass (e.g. after a clear() or a glitch): next flush redraws everything.
+void lcd_fb_invalidate(void);
+
+#endif
@@ -3,12 +3,15 @@
    @author Avinashee Tech
 */
 
+#include <string.h>
 #include "lcd_i2c.h"
 //platform dependent headers
 #include "i2c.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 
 
@@ -18,6 +21,10 @@
 #define DELAY(microseconds)           (delay_us(microseconds))                //for delay in microseconds (platform dependent)
 #define PRINT(fmt)                    (print_message(fmt))                    //print statement (platform dependent)
 #define I2C_MASTER_SEND_DATA(...)     (master_send_data(__VA_ARGS__))         //i2c data function (platfrom dependent) in i2c.h
+#define I2C_MASTER_WRITE_BUF(...)     (master_write_buf(__VA_ARGS__))         //i2c buffer write (platfrom dependent) in i2c.h
+#define LCD_NIBBLE_BYTES              3                                       //data, data|En, data&~En
+#define LCD_BYTE_BYTES                (2*LCD_NIBBLE_BYTES)
+#define LCD_BATCH_MAX_CHARS           20                                      //characters per i2c transaction (120 bytes)
 #define I2C_INIT(...)                 (i2c_init(##__VA_ARGS__))               //i2c initialize function (platfrom dependent) in i2c.h         
 
 //variables
@@ -32,8 +39,16 @@ uint8_t _backlightval = LCD_NOBACKLIGHT;
 * @brief delay function for lcd 
 * @retval None
 * @param us microseconds
+* @note ms-scale waits (power-up, clear/home) block the calling task instead of
+        spinning once the scheduler runs. One tick is added because vTaskDelay(n)
+        can return up to a tick early; short waits still use the ROM busy loop.
 */
 void delay_us(int us){
+    const int tick_us = portTICK_PERIOD_MS * 1000;
+    if (us >= 1000 && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+        vTaskDelay((TickType_t)((us + tick_us - 1) / tick_us) + 1);
+        return;
+    }
     esp_rom_delay_us(us);
 }
 
@@ -179,16 +194,26 @@ void display(void) {
 }
 
 /**  
-* @brief LCD Display set cursor command
-* @retval None
-* @param None
+* @brief DDRAM address of a cell
+* @retval LCD_SETDDRAMADDR command byte
+* @param col column
+* @param row row
 */
-void setCursor(uint8_t col, uint8_t row){
-	int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+static uint8_t ddram_cmd(uint8_t col, uint8_t row){
+	static const uint8_t row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
 	if ( row > _numlines ) {
 		row = _numlines-1;    // we count rows starting w/0
 	}
-	command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+	return LCD_SETDDRAMADDR | (col + row_offsets[row & 3]);
+}
+
+/**  
+* @brief LCD Display set cursor command
+* @retval i2c status
+* @param None
+*/
+esp_err_t setCursor(uint8_t col, uint8_t row){
+	return command(ddram_cmd(col, row));
 }
 
 
@@ -211,8 +236,8 @@ void createChar(uint8_t location, uint8_t *charmap) {
 * @retval None
 * @param None
 */
-void command(uint8_t value) {
-	lcd_send(value, 0);
+esp_err_t command(uint8_t value) {
+	return lcd_send(value, 0);
 }
 
 /**  
@@ -220,70 +245,136 @@ void command(uint8_t value) {
 * @retval None
 * @param None
 */
-void lcd_write(uint8_t value) {
-	lcd_send(value, Rs);
+esp_err_t lcd_write(uint8_t value) {
+	return lcd_send(value, Rs);
+}
+
+/**  
+* @brief pack one half byte into expander writes
+* @retval number of bytes written to out (LCD_NIBBLE_BYTES)
+* @param out destination buffer
+* @param value 4 bit command/data in the high nibble, RS in bit 0
+* @note same sequence as expanderWrite + pulseEnable, but sent in one
+        transaction. At 400kHz one byte is ~22.5us on the wire, so En stays
+        high for a full byte (>450ns) and two bytes separate a falling edge
+        from the next rising one (>37us settle), without explicit delays.
+        At 100kHz every byte is 4x longer, so the margins only grow.
+*/
+static size_t pack4bits(uint8_t *out, uint8_t value) {
+	uint8_t d = value | _backlightval;
+	out[0] = d;
+	out[1] = d | En;
+	out[2] = d & ~En;
+	return LCD_NIBBLE_BYTES;
+}
+
+/**  
+* @brief pack a command/data byte as two half bytes
+* @retval number of bytes written to out (LCD_BYTE_BYTES)
+*/
+static size_t pack_byte(uint8_t *out, uint8_t value, uint8_t mode) {
+	size_t n = pack4bits(out, (value & 0xf0) | mode);
+	return n + pack4bits(out + n, ((value << 4) & 0xf0) | mode);
 }
 
 /**  
 * @brief LCD Display send command/data
-* @retval None
+* @retval i2c status
 * @param value command or data byte
 * @param mode RS pin status
 * @note write either command or data based on RS pin value and resolve the byte value
-        into two half bytes
+        into two half bytes, all six expander writes in one transaction
 */
-void lcd_send(uint8_t value, uint8_t mode) {
-	uint8_t highnib=value&0xf0;
-	uint8_t lownib=(value<<4)&0xf0;
-    write4bits((highnib)|mode);
-	write4bits((lownib)|mode); 
+esp_err_t lcd_send(uint8_t value, uint8_t mode) {
+	uint8_t buf[LCD_BYTE_BYTES];
+	return I2C_MASTER_WRITE_BUF(buf, pack_byte(buf, value, mode), LCD_I2C_ADDR);
 }
 
 /**  
 * @brief LCD Display send half byte
-* @retval None
+* @retval i2c status
 * @param value 4 bit command/data
 */
-void write4bits(uint8_t value) {
-	expanderWrite(value);
-	pulseEnable(value);
+esp_err_t write4bits(uint8_t value) {
+	uint8_t buf[LCD_NIBBLE_BYTES];
+	return I2C_MASTER_WRITE_BUF(buf, pack4bits(buf, value), LCD_I2C_ADDR);
 }
 
 /**  
 * @brief LCD Display send i2c data
-* @retval None
+* @retval i2c status
 * @param _data data byte to send over i2c
 */
-void expanderWrite(uint8_t _data){                                        
-	I2C_MASTER_SEND_DATA(((int)(_data) | _backlightval),LCD_I2C_ADDR); 
+esp_err_t expanderWrite(uint8_t _data){                                        
+	return I2C_MASTER_SEND_DATA(((int)(_data) | _backlightval),LCD_I2C_ADDR); 
 }
 
 /**  
 * @brief LCD Display send enable pulse
-* @retval None
+* @retval i2c status
 * @param _data data byte to send over i2c
 * @note refer timing diagram for 4 bit operations
 */
-void pulseEnable(uint8_t _data){
-	expanderWrite(_data | En);	// En high
-	DELAY(1);		// enable pulse must be >450ns
-	
-	expanderWrite(_data & ~En);	// En low
+esp_err_t pulseEnable(uint8_t _data){
+	uint8_t buf[2] = { (uint8_t)(_data | En | _backlightval),      // En high
+	                   (uint8_t)((_data & ~En) | _backlightval) };  // En low
+	esp_err_t err = I2C_MASTER_WRITE_BUF(buf, sizeof(buf), LCD_I2C_ADDR);
 	DELAY(50);		// commands need > 37us to settle
+	return err;
 } 
 
+/**  
+* @brief send characters, LCD_BATCH_MAX_CHARS per transaction
+* @retval i2c status of the first failed transaction, ESP_OK otherwise
+* @param prefix optional command sent ahead of the characters (0 for none)
+* @param str characters
+* @param len number of characters
+*/
+static esp_err_t send_chars(uint8_t prefix, const char *str, size_t len){
+	uint8_t buf[LCD_BYTE_BYTES * (LCD_BATCH_MAX_CHARS + 1)];
+	size_t n = 0;
+
+	if (prefix) n += pack_byte(buf, prefix, 0);
+	do {
+		for (size_t i = 0; i < LCD_BATCH_MAX_CHARS && len; i++, len--) {
+			n += pack_byte(buf + n, (uint8_t)*str++, Rs);
+		}
+		if (n) {
+			esp_err_t err = I2C_MASTER_WRITE_BUF(buf, n, LCD_I2C_ADDR);
+			if (err != ESP_OK) return err;
+		}
+		n = 0;
+	} while (len);
+	return ESP_OK;
+}
+
 /**  
 * @brief LCD Display send characters
-* @retval None
+* @retval i2c status
 * @param str pointer to strings of character
 */
-void send_string(char *str){
-    int i = 0;
-    while (str[i]!='\0')
-    {
-        /* send character code */
-        lcd_write(str[i]);
-        i++;
-    }
-    
+esp_err_t send_string(char *str){
+	return send_chars(0, str, strlen(str));
+}
+
+/**  
+* @brief LCD Display move cursor and send characters in one transaction
+* @retval i2c status
+* @param col column
+* @param row row
+* @param str characters (not necessarily NUL terminated)
+* @param len number of characters
+*/
+esp_err_t lcd_write_at(uint8_t col, uint8_t row, const char *str, size_t len){
+	return send_chars(ddram_cmd(col, row), str, len);
+}
+
+/**  
+* @brief LCD Display send characters at the current cursor
+* @retval i2c status
+* @param str characters (not necessarily NUL terminated)
+* @param len number of characters
+*/
+esp_err_t lcd_write_buf(const char *str, size_t len){
+	return send_chars(0, str, len);
 }
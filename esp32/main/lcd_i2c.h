@@ -6,7 +6,9 @@
 #ifndef _LCD_I2c_H_
 #define _LCD_I2C_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include "esp_err.h"
 
 // commands
 #define LCD_CLEARDISPLAY 0x01
@@ -55,17 +57,19 @@
 #define Rs 0x01  // Register select bit
 
 //function declarations
-void send_string(char *str);
-void pulseEnable(uint8_t _data);
-void expanderWrite(uint8_t _data);
-void write4bits(uint8_t value);
-void lcd_send(uint8_t value, uint8_t mode);
+esp_err_t send_string(char *str);
+esp_err_t lcd_write_at(uint8_t col, uint8_t row, const char *str, size_t len);
+esp_err_t lcd_write_buf(const char *str, size_t len);
+esp_err_t pulseEnable(uint8_t _data);
+esp_err_t expanderWrite(uint8_t _data);
+esp_err_t write4bits(uint8_t value);
+esp_err_t lcd_send(uint8_t value, uint8_t mode);
 
-void command(uint8_t value);
-void lcd_write(uint8_t value);
+esp_err_t command(uint8_t value);
+esp_err_t lcd_write(uint8_t value);
 
 void createChar(uint8_t location, uint8_t *charmap);
-void setCursor(uint8_t col, uint8_t row);
+esp_err_t setCursor(uint8_t col, uint8_t row);
 void display(void);
 void noDisplay(void);
 void backlight(void);
@@ -78,7 +82,8 @@ void lcd_init(uint8_t lcd_cols,uint8_t lcd_rows);
 //platform dependent functions
 void delay_us(int us);
 void print_message(const char* msg);
-void master_send_data(uint8_t data,uint8_t i2c_addr);
+esp_err_t master_send_data(uint8_t data,uint8_t i2c_addr);
+esp_err_t master_write_buf(const uint8_t *data, size_t len, uint8_t i2c_addr);
 int i2c_init(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,301 @@
+/* @file  ota.c
+   @brief delta OTA: a binary patch against the running image, applied to the
+          inactive app slot, with rollback until MQTT connects
+
+   The patch (detools, heatshrink, see tools/ota_delta.py) is streamed from
+   HTTP into esp_delta_ota, which reads the old bytes from the running slot
+   and writes the rebuilt image to the other one. A campus-Wi-Fi rollout then
+   moves tens of kB per board instead of the full 1 MB image.
+
+   Nothing is trusted until it is checked: the patch must be built for the
+   running image (base), its size and SHA-256 must match the command, and
+   esp_ota_end() verifies the rebuilt image, and its signature when built
+   with sdkconfig.ota_signing, before the new slot is selected.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_delta_ota.h"
+#include "mbedtls/sha256.h"
+#include "cJSON.h"
+#include "ota.h"
+#include "task_plan.h"
+
+#define OTA_CHUNK             1024
+#define OTA_HTTP_TIMEOUT_MS   10000
+#define OTA_REBOOT_DELAY_MS   500     // lets the "rebooting" status out first
+
+static const char *TAG = "OTA";
+
+static ota_report_fn s_report;
+static const esp_partition_t *s_running;    // delta base, read by the patcher
+static esp_timer_handle_t s_trial_timer;
+static bool s_on_trial;
+static bool s_reported;
+static char s_rolled_back[OTA_VERSION_LEN]; // version the bootloader gave up on
+static volatile bool s_busy;
+
+static void report(const char *state, const char *detail)
+{
+    ESP_LOGI(TAG, "%s %s", state, detail);
+    if (s_report) s_report(state, detail);
+}
+
+const char *ota_running_version(void)
+{
+    return esp_app_get_description()->version;
+}
+
+// ============================================================
+// Trial boot / rollback
+// ============================================================
+static void trial_expired(void *arg)
+{
+    (void)arg;
+    ESP_LOGE(TAG, "No MQTT connect within the trial window, rolling back");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+void ota_init(ota_report_fn report_fn, uint32_t confirm_timeout_ms)
+{
+    s_report = report_fn;
+    s_running = esp_ota_get_running_partition();
+
+    // Crashing before the deadline rolls back too: the bootloader does not
+    // start a PENDING_VERIFY image twice (CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE).
+    esp_ota_img_states_t st;
+    if (esp_ota_get_state_partition(s_running, &st) == ESP_OK && st == ESP_OTA_IMG_PENDING_VERIFY) {
+        s_on_trial = true;
+        const esp_timer_create_args_t args = { .callback = trial_expired, .name = "ota_trial" };
+        if (esp_timer_create(&args, &s_trial_timer) == ESP_OK) {
+            esp_timer_start_once(s_trial_timer, (uint64_t)confirm_timeout_ms * 1000);
+        }
+        ESP_LOGW(TAG, "Running %s on trial, %" PRIu32 " s to reach MQTT", ota_running_version(),
+                 confirm_timeout_ms / 1000);
+    }
+
+    const esp_partition_t *bad = esp_ota_get_last_invalid_partition();
+    esp_app_desc_t desc;
+    if (bad && esp_ota_get_partition_description(bad, &desc) == ESP_OK) {
+        snprintf(s_rolled_back, sizeof(s_rolled_back), "%s", desc.version);
+    }
+}
+
+void ota_confirm(void)
+{
+    if (s_on_trial) {
+        s_on_trial = false;
+        if (s_trial_timer) esp_timer_stop(s_trial_timer);
+        esp_ota_mark_app_valid_cancel_rollback();
+        report("confirmed", ota_running_version());
+    } else if (s_rolled_back[0] && !s_reported) {
+        report("rolled_back", s_rolled_back);
+    }
+    s_reported = true;
+}
+
+// ============================================================
+// Command
+// ============================================================
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool parse_hex(const cJSON *item, uint8_t *out, size_t n)
+{
+    if (!cJSON_IsString(item) || strlen(item->valuestring) != 2 * n) return false;
+    for (size_t i = 0; i < n; i++) {
+        int hi = hex_nibble(item->valuestring[2 * i]);
+        int lo = hex_nibble(item->valuestring[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+static bool copy_str(const cJSON *item, char *out, size_t cap)
+{
+    if (!cJSON_IsString(item) || !item->valuestring[0] || strlen(item->valuestring) >= cap) return false;
+    strcpy(out, item->valuestring);
+    return true;
+}
+
+bool ota_parse_cmd(const char *json, size_t len, ota_cmd_t *cmd)
+{
+    cJSON *root = cJSON_ParseWithLength(json, len);
+    if (!root) return false;
+
+    ota_cmd_t tmp = { 0 };
+    const cJSON *size = cJSON_GetObjectItemCaseSensitive(root, "size");
+    bool ok = copy_str(cJSON_GetObjectItemCaseSensitive(root, "version"), tmp.version, sizeof(tmp.version)) &&
+              copy_str(cJSON_GetObjectItemCaseSensitive(root, "url"), tmp.url, sizeof(tmp.url)) &&
+              parse_hex(cJSON_GetObjectItemCaseSensitive(root, "base"), tmp.base, OTA_BASE_LEN) &&
+              parse_hex(cJSON_GetObjectItemCaseSensitive(root, "sha256"), tmp.sha256, sizeof(tmp.sha256)) &&
+              cJSON_IsNumber(size) && size->valuedouble >= 1 && size->valuedouble <= UINT32_MAX;
+    if (ok) {
+        tmp.size = (uint32_t)size->valuedouble;
+        *cmd = tmp;
+    }
+    cJSON_Delete(root);
+    return ok;
+}
+
+// ============================================================
+// Download + patch
+// ============================================================
+static esp_err_t base_read(uint8_t *buf, size_t size, int src_offset)
+{
+    return esp_partition_read(s_running, (size_t)src_offset, buf, size);
+}
+
+static esp_err_t merged_write(const uint8_t *buf, size_t size, void *user_data)
+{
+    return esp_ota_write(*(esp_ota_handle_t *)user_data, buf, size);
+}
+
+static const char *ota_err_str(esp_err_t err)
+{
+    switch (err) {
+    case ESP_ERR_INVALID_VERSION:       return "base";      // patch built for another image
+    case ESP_ERR_INVALID_CRC:           return "sha256";
+    case ESP_ERR_INVALID_SIZE:          return "size";
+    case ESP_ERR_OTA_VALIDATE_FAILED:   return "image";     // corrupt or unsigned result
+    default:                            return esp_err_to_name(err);
+    }
+}
+
+static esp_err_t ota_apply(const ota_cmd_t *cmd)
+{
+    if (memcmp(esp_app_get_description()->app_elf_sha256, cmd->base, OTA_BASE_LEN) != 0) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    const esp_partition_t *target = esp_ota_get_next_update_partition(NULL);
+    if (!target) return ESP_ERR_NOT_FOUND;
+
+    esp_http_client_config_t http_cfg = {
+        .url = cmd->url,
+        .timeout_ms = OTA_HTTP_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,   // https:// URLs; signed builds check the image anyway
+    };
+    esp_http_client_handle_t http = esp_http_client_init(&http_cfg);
+    if (!http) return ESP_ERR_NO_MEM;
+
+    esp_ota_handle_t ota = 0;
+    bool begun = false;
+    esp_delta_ota_handle_t delta = NULL;
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    uint8_t *buf = malloc(OTA_CHUNK);
+    uint32_t got = 0;
+
+    esp_err_t err = buf ? esp_http_client_open(http, 0) : ESP_ERR_NO_MEM;
+    if (err == ESP_OK) {
+        int64_t len = esp_http_client_fetch_headers(http);
+        if (esp_http_client_get_status_code(http) != 200) err = ESP_ERR_INVALID_RESPONSE;
+        else if (len > 0 && len != (int64_t)cmd->size) err = ESP_ERR_INVALID_SIZE;
+    }
+    // Sequential writes: sectors are erased as the image grows, not the whole slot up front.
+    if (err == ESP_OK) {
+        err = esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &ota);
+        begun = (err == ESP_OK);
+    }
+    if (err == ESP_OK) {
+        esp_delta_ota_cfg_t cfg = { .user_data = &ota, .read_cb = base_read, .write_cb_with_user_data = merged_write };
+        delta = esp_delta_ota_init(&cfg);
+        if (!delta) err = ESP_ERR_NO_MEM;
+    }
+    if (err == ESP_OK) report("downloading", cmd->version);
+
+    while (err == ESP_OK && got < cmd->size) {
+        int n = esp_http_client_read(http, (char *)buf, OTA_CHUNK);
+        if (n <= 0 || got + (uint32_t)n > cmd->size) {
+            err = ESP_ERR_INVALID_SIZE;     // short body, timeout or more than announced
+            break;
+        }
+        got += (uint32_t)n;
+        mbedtls_sha256_update(&sha, buf, (size_t)n);
+        err = esp_delta_ota_feed_patch(delta, buf, n);
+    }
+    if (err == ESP_OK) err = esp_delta_ota_finalize(delta);
+    if (err == ESP_OK) {
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&sha, digest);
+        if (memcmp(digest, cmd->sha256, sizeof(digest)) != 0) err = ESP_ERR_INVALID_CRC;
+    }
+    if (delta) esp_delta_ota_deinit(delta);
+
+    // esp_ota_end() validates the image and, with CONFIG_SECURE_SIGNED_ON_UPDATE_NO_SECURE_BOOT,
+    // its signature. Only then does the boot slot change.
+    if (begun) {
+        if (err == ESP_OK) err = esp_ota_end(ota);
+        else esp_ota_abort(ota);
+    }
+    if (err == ESP_OK) err = esp_ota_set_boot_partition(target);
+
+    mbedtls_sha256_free(&sha);
+    free(buf);
+    esp_http_client_close(http);
+    esp_http_client_cleanup(http);
+
+    if (err == ESP_OK) ESP_LOGI(TAG, "%s: %" PRIu32 " byte patch written to %s", cmd->version, got, target->label);
+    return err;
+}
+
+static void ota_task(void *arg)
+{
+    ota_cmd_t *cmd = arg;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ota_apply(cmd);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Update ready in %" PRId64 " ms", (esp_timer_get_time() - t0) / 1000);
+        report("rebooting", cmd->version);
+        vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+        esp_restart();
+    }
+
+    ESP_LOGE(TAG, "Update to %s failed: %s", cmd->version, esp_err_to_name(err));
+    report("failed", ota_err_str(err));
+    free(cmd);
+    s_busy = false;
+    vTaskDelete(NULL);
+}
+
+bool ota_start(const ota_cmd_t *cmd)
+{
+    if (strcmp(cmd->version, ota_running_version()) == 0) {
+        ESP_LOGI(TAG, "Already running %s", cmd->version);
+        return false;
+    }
+    if (s_busy) {
+        ESP_LOGW(TAG, "Update already in progress, %s ignored", cmd->version);
+        return false;
+    }
+
+    ota_cmd_t *copy = malloc(sizeof(*copy));
+    if (!copy) return false;
+    *copy = *cmd;
+    s_busy = true;
+    if (xTaskCreatePinnedToCore(ota_task, "ota", OTA_TASK_STACK, copy, OTA_TASK_PRIO, NULL, NET_CORE) != pdPASS) {
+        free(copy);
+        s_busy = false;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+/* @file  ota.h
+   @brief delta OTA: a binary patch against the running image, applied to the
+          inactive app slot, with rollback until MQTT connects
+*/
+
+#ifndef _OTA_H_
+#define _OTA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OTA_BASE_LEN      8     // prefix of the base image's ELF SHA-256
+#define OTA_VERSION_LEN   32    // esp_app_desc_t.version
+
+/*
+ * Command on parking/<parking_id>/ota (JSON, see tools/ota_delta.py):
+ *   {"version":"1.4.0","url":"http://host/optipark-1.4.0-3f2a9c1b.patch",
+ *    "base":"3f2a9c1b5e7d0a44","size":48213,"sha256":"<64 hex>"}
+ * base:   first 8 bytes (hex) of the ELF SHA-256 of the image the patch applies to
+ * size / sha256: of the patch file, checked before the new slot is selected
+ */
+typedef struct {
+    char version[OTA_VERSION_LEN];
+    char url[192];
+    uint8_t base[OTA_BASE_LEN];
+    uint32_t size;
+    uint8_t sha256[32];
+} ota_cmd_t;
+
+// Progress and outcome, e.g. ("downloading", "1.4.0"), ("failed", "sha256"),
+// ("confirmed", "1.4.0"), ("rolled_back", "1.4.0"). Called from the OTA task,
+// the MQTT task or the rollback timer.
+typedef void (*ota_report_fn)(const char *state, const char *detail);
+
+// At boot, before MQTT starts. A freshly updated image is on trial: unless
+// ota_confirm() runs within confirm_timeout_ms, the bootloader goes back to
+// the previous slot.
+void ota_init(ota_report_fn report, uint32_t confirm_timeout_ms);
+
+// On every MQTT connect: keeps a trial image for good, and reports a
+// confirm or a rollback once per boot.
+void ota_confirm(void);
+
+bool ota_parse_cmd(const char *json, size_t len, ota_cmd_t *cmd);
+
+// Download, patch and verify in a task of its own, then reboot into the new
+// slot. False if an update is already running or the command is a no-op.
+bool ota_start(const ota_cmd_t *cmd);
+
+// Running image version (esp_app_desc_t.version).
+const char *ota_running_version(void);
+
+#endif
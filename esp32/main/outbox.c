@@ -0,0 +1,144 @@
+/* @file  outbox.c
+   @brief bounded store-and-forward queue for spot transitions while MQTT is down
+   @note  only used from parking_task, no locking
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "outbox.h"
+
+#define OUTBOX_NVS_NAMESPACE  "outbox"
+#define OUTBOX_NVS_KEY        "ring"
+#define OUTBOX_NVS_VERSION    2     // 2: evtime_t timestamps
+
+static const char *TAG = "OUTBOX";
+
+static outbox_evt_t s_ring[OUTBOX_CAPACITY];
+static int s_head = 0;
+static int s_count = 0;
+static bool s_dirty = false;
+static int64_t s_last_persist_ms = 0;
+
+typedef struct {
+    uint8_t version;
+    uint8_t count;
+    outbox_evt_t evts[OUTBOX_CAPACITY];
+} outbox_blob_t;
+
+static outbox_evt_t *at(int k)
+{
+    return &s_ring[(s_head + k) % OUTBOX_CAPACITY];
+}
+
+// Keep only the newest event of each spot, order preserved.
+static void outbox_coalesce(void)
+{
+    outbox_evt_t tmp[OUTBOX_CAPACITY];
+    int n = 0;
+    for (int k = 0; k < s_count; k++) {
+        bool superseded = false;
+        for (int j = k + 1; j < s_count; j++) {
+            if (at(j)->spot == at(k)->spot) { superseded = true; break; }
+        }
+        if (!superseded) tmp[n++] = *at(k);
+    }
+    ESP_LOGW(TAG, "Full: coalesced %d -> %d events", s_count, n);
+    memcpy(s_ring, tmp, n * sizeof(outbox_evt_t));
+    s_head = 0;
+    s_count = n;
+}
+
+void outbox_push(uint8_t spot, bool occupied, const evtime_t *ts)
+{
+    if (s_count == OUTBOX_CAPACITY) outbox_coalesce();
+    if (s_count == OUTBOX_CAPACITY) {
+        ESP_LOGW(TAG, "Full: dropping oldest event");
+        s_head = (s_head + 1) % OUTBOX_CAPACITY;
+        s_count--;
+    }
+
+    outbox_evt_t *e = at(s_count);
+    e->ts = *ts;
+    e->spot = spot;
+    e->occupied = occupied ? 1 : 0;
+    s_count++;
+    s_dirty = true;
+}
+
+bool outbox_peek(outbox_evt_t *out)
+{
+    if (s_count == 0) return false;
+    *out = *at(0);
+    return true;
+}
+
+void outbox_pop(void)
+{
+    if (s_count == 0) return;
+    s_head = (s_head + 1) % OUTBOX_CAPACITY;
+    s_count--;
+    s_dirty = true;
+}
+
+int outbox_depth(void)
+{
+    return s_count;
+}
+
+void outbox_persist(int64_t now_ms, int64_t min_interval_ms)
+{
+    if (!s_dirty || (now_ms - s_last_persist_ms) < min_interval_ms) return;
+
+    nvs_handle_t h;
+    if (nvs_open(OUTBOX_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+
+    esp_err_t err;
+    if (s_count == 0) {
+        err = nvs_erase_key(h, OUTBOX_NVS_KEY);
+        if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+    } else {
+        static outbox_blob_t blob;
+        blob.version = OUTBOX_NVS_VERSION;
+        blob.count = (uint8_t)s_count;
+        for (int k = 0; k < s_count; k++) blob.evts[k] = *at(k);
+        err = nvs_set_blob(h, OUTBOX_NVS_KEY, &blob,
+                           offsetof(outbox_blob_t, evts) + s_count * sizeof(outbox_evt_t));
+    }
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Persist failed: %s", esp_err_to_name(err));
+        return;
+    }
+    s_dirty = false;
+    s_last_persist_ms = now_ms;
+}
+
+void outbox_init(void)
+{
+    nvs_handle_t h;
+    if (nvs_open(OUTBOX_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return;
+
+    static outbox_blob_t blob;
+    size_t len = sizeof(blob);
+    esp_err_t err = nvs_get_blob(h, OUTBOX_NVS_KEY, &blob, &len);
+    nvs_close(h);
+    if (err != ESP_OK) return;
+
+    if (blob.version != OUTBOX_NVS_VERSION || blob.count > OUTBOX_CAPACITY ||
+        len != offsetof(outbox_blob_t, evts) + blob.count * sizeof(outbox_evt_t)) {
+        ESP_LOGW(TAG, "Ignoring persisted outbox (bad format)");
+        return;
+    }
+
+    memcpy(s_ring, blob.evts, blob.count * sizeof(outbox_evt_t));
+    s_head = 0;
+    s_count = blob.count;
+    for (int k = 0; k < s_count; k++) {
+        if (!s_ring[k].ts.epoch) s_ring[k].ts.ms = -1;
+    }
+    ESP_LOGI(TAG, "Restored %d pending events", s_count);
+}
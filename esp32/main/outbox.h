@@ -0,0 +1,35 @@
+/* @file  outbox.h
+   @brief bounded store-and-forward queue for spot transitions while MQTT is down
+*/
+
+#ifndef _OUTBOX_H_
+#define _OUTBOX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "evtime.h"
+
+#define OUTBOX_CAPACITY 64
+
+typedef struct {
+    evtime_t ts;        // when the transition was confirmed
+    uint8_t spot;       // index into the spot table
+    uint8_t occupied;
+} outbox_evt_t;
+
+// Restore events persisted before a reboot (nvs_flash_init() must have run).
+// Uptime timestamps of the previous boot mean nothing now and are dropped.
+void outbox_init(void);
+
+// Append a transition. When full, the ring is first compacted down to the
+// latest event per spot; only if that is not enough is the oldest dropped.
+void outbox_push(uint8_t spot, bool occupied, const evtime_t *ts);
+
+bool outbox_peek(outbox_evt_t *out);
+void outbox_pop(void);
+int  outbox_depth(void);
+
+// Write the ring to NVS if it changed and at least min_interval_ms passed.
+void outbox_persist(int64_t now_ms, int64_t min_interval_ms);
+
+#endif
@@ -0,0 +1,45 @@
+/* @file  qr_keys.c
+   @brief HMAC keys for signed gate QR tokens, provisioned in NVS
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "qr_keys.h"
+
+#define QR_KEYS_NVS_NS "qrkeys"
+
+static const char *TAG = "QR_KEYS";
+
+esp_err_t qr_keys_load(qr_keyring_t *kr)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(QR_KEYS_NVS_NS, NVS_READONLY, &h);
+    if (err != ESP_OK) return err;
+
+    uint8_t kids[QR_MAX_KEYS];
+    size_t n = sizeof(kids);
+    err = nvs_get_blob(h, "kids", kids, &n);
+    if (err == ESP_OK && n == 0) err = ESP_ERR_INVALID_SIZE;
+
+    qr_keyring_t tmp = { 0 };
+    for (size_t i = 0; err == ESP_OK && i < n; i++) {
+        char name[8];
+        snprintf(name, sizeof(name), "k%u", (unsigned)kids[i]);
+        size_t len = QR_KEY_LEN;
+        err = nvs_get_blob(h, name, tmp.key[i].key, &len);
+        if (err == ESP_OK && len != QR_KEY_LEN) err = ESP_ERR_INVALID_SIZE;
+        tmp.key[i].kid = kids[i];
+        tmp.count++;
+    }
+    nvs_close(h);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "QR keys in NVS rejected: %s", esp_err_to_name(err));
+        return err;
+    }
+    *kr = tmp;
+    ESP_LOGI(TAG, "%d QR key(s) loaded", kr->count);
+    return ESP_OK;
+}
@@ -0,0 +1,23 @@
+/* @file  qr_keys.h
+   @brief HMAC keys for signed gate QR tokens, provisioned in NVS
+*/
+
+#ifndef _QR_KEYS_H_
+#define _QR_KEYS_H_
+
+#include "esp_err.h"
+#include "qr.h"
+
+/*
+ * NVS namespace "qrkeys":
+ *   kids   blob   one u8 key id per key, at most QR_MAX_KEYS
+ *   k<id>  blob   QR_KEY_LEN bytes for that id, e.g. "k1", "k2"
+ *
+ * Rotation: add the new key and list both ids, switch the backend to the new
+ * id, then drop the old one once its last tokens have expired.
+ *
+ * Returns ESP_OK with kr filled, or an error and kr untouched.
+ */
+esp_err_t qr_keys_load(qr_keyring_t *kr);
+
+#endif
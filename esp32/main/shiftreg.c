@@ -0,0 +1,104 @@
+/* @file  shiftreg.c
+   @brief spot I/O through chained shift registers on one SPI bus
+*/
+
+#include <string.h>
+#include "driver/spi_master.h"
+#include "esp_log.h"
+#include "shiftreg.h"
+#include "spot_table.h"
+
+#define SHIFTREG_SPI_HOST   SPI3_HOST
+#define SHIFTREG_SPI_HZ     2000000        // 64 spots = 16 bytes = 64 us per scan
+#define SHIFTREG_MAX_BYTES  ((2 * MAX_SPOTS + 7) / 8)
+
+static const char *TAG = "SHIFTREG";
+
+static spi_device_handle_t s_spi = NULL;
+static uint8_t s_in_bytes = 0;     // 74HC165 count
+static uint8_t s_xfer_bytes = 0;   // max(inputs, LED sinks)
+static uint8_t s_tx[SHIFTREG_MAX_BYTES];
+static uint8_t s_rx[SHIFTREG_MAX_BYTES];
+
+esp_err_t shiftreg_init(uint8_t n_spots)
+{
+    if (n_spots == 0 || n_spots > MAX_SPOTS) return ESP_ERR_INVALID_ARG;
+
+    s_in_bytes = (uint8_t)((n_spots + 7) / 8);
+    s_xfer_bytes = (uint8_t)((2 * n_spots + 7) / 8);
+    if (s_xfer_bytes < s_in_bytes) s_xfer_bytes = s_in_bytes;
+    memset(s_tx, 0, sizeof(s_tx));
+
+    gpio_config_t out_cfg = {
+        .pin_bit_mask = (1ULL << SHIFTREG_LOAD_PIN) | (1ULL << SHIFTREG_LATCH_PIN),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+    esp_err_t err = gpio_config(&out_cfg);
+    if (err != ESP_OK) return err;
+    gpio_set_level(SHIFTREG_LOAD_PIN, 1);
+    gpio_set_level(SHIFTREG_LATCH_PIN, 0);
+
+    spi_bus_config_t bus = {
+        .mosi_io_num = SHIFTREG_MOSI_PIN,
+        .miso_io_num = SHIFTREG_MISO_PIN,
+        .sclk_io_num = SHIFTREG_SCLK_PIN,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = SHIFTREG_MAX_BYTES,
+    };
+    err = spi_bus_initialize(SHIFTREG_SPI_HOST, &bus, SPI_DMA_DISABLED);
+    if (err != ESP_OK) return err;
+
+    spi_device_interface_config_t dev = {
+        .mode = 0,
+        .clock_speed_hz = SHIFTREG_SPI_HZ,
+        .spics_io_num = -1,          // /PL and LE are pulsed by hand
+        .queue_size = 1,
+    };
+    err = spi_bus_add_device(SHIFTREG_SPI_HOST, &dev, &s_spi);
+    if (err != ESP_OK) return err;
+
+    ESP_LOGI(TAG, "%u spots: %u input / %u transfer bytes", n_spots, s_in_bytes, s_xfer_bytes);
+    return ESP_OK;
+}
+
+esp_err_t shiftreg_scan(uint64_t *inputs)
+{
+    if (!s_spi) return ESP_ERR_INVALID_STATE;
+
+    gpio_set_level(SHIFTREG_LOAD_PIN, 0);   // parallel load
+    gpio_set_level(SHIFTREG_LOAD_PIN, 1);   // shift mode, D7 of register 0 on MISO
+
+    spi_transaction_t t = {
+        .length = (size_t)s_xfer_bytes * 8,
+        .tx_buffer = s_tx,
+        .rx_buffer = s_rx,
+    };
+    esp_err_t err = spi_device_polling_transmit(s_spi, &t);
+    if (err != ESP_OK) return err;
+
+    gpio_set_level(SHIFTREG_LATCH_PIN, 1);  // LED outputs take the new bits
+    gpio_set_level(SHIFTREG_LATCH_PIN, 0);
+
+    // MSB first: rx[k] bit b = D(b) of register k.
+    uint64_t v = 0;
+    for (int k = 0; k < s_in_bytes; k++) v |= (uint64_t)s_rx[k] << (8 * k);
+    *inputs = v;
+    return ESP_OK;
+}
+
+void shiftreg_set_led(int i, bool green, bool blue)
+{
+    if (i < 0 || i >= MAX_SPOTS || s_xfer_bytes == 0) return;
+
+    // The last byte clocked out ends up in register 0.
+    int reg = i / 4;
+    if (reg >= s_xfer_bytes) return;
+    uint8_t *b = &s_tx[s_xfer_bytes - 1 - reg];
+    uint8_t shift = (uint8_t)(2 * (i % 4));
+
+    *b = (uint8_t)((*b & ~(0x3u << shift)) | ((green ? 1u : 0u) << shift) | ((blue ? 2u : 0u) << shift));
+}
@@ -0,0 +1,38 @@
+/* @file  shiftreg.h
+   @brief spot I/O through chained shift registers on one SPI bus
+
+   Sensors: 74HC165 parallel-in chain on MISO, spot i is input D(i%8) of
+   register i/8 counted from the one wired to MISO.
+   LEDs:    constant-current sink chain (TLC5916 / STP16CP05, 74HC595
+            compatible) on MOSI, spot i uses outputs 2*(i%4) (green) and
+            2*(i%4)+1 (blue) of register i/4 counted from the one wired to MOSI.
+
+   One full-duplex transfer per scan both reads every sensor and refreshes
+   every LED, so the cost per tick depends only on the chain length.
+*/
+
+#ifndef _SHIFTREG_H_
+#define _SHIFTREG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#define SHIFTREG_SCLK_PIN   GPIO_NUM_18
+#define SHIFTREG_MISO_PIN   GPIO_NUM_19   // 74HC165 Q7 of the first register
+#define SHIFTREG_MOSI_PIN   GPIO_NUM_23   // LED sink SDI of the first register
+#define SHIFTREG_LOAD_PIN   GPIO_NUM_5    // 74HC165 /PL, pulsed low before a scan
+#define SHIFTREG_LATCH_PIN  GPIO_NUM_4    // LED sink LE, pulsed high after a scan
+#define SHIFTREG_OE_PIN     GPIO_NUM_25   // LED sink /OE, PWM for brightness
+
+esp_err_t shiftreg_init(uint8_t n_spots);
+
+// Latch the inputs, clock the chain once, latch the LED outputs.
+// *inputs: bit i = raw level of spot i's sensor (1 = high).
+esp_err_t shiftreg_scan(uint64_t *inputs);
+
+// Update the LED shadow; it goes out with the next scan.
+void shiftreg_set_led(int i, bool green, bool blue);
+
+#endif
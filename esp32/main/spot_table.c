@@ -0,0 +1,93 @@
+/* @file  spot_table.c
+   @brief runtime spot table (slot ids, I/O backend, pins) provisioned in NVS
+*/
+
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "spot_table.h"
+
+#define SPOT_TABLE_NVS_NS "spots"
+
+static const char *TAG = "SPOT_TABLE";
+
+esp_err_t spot_table_parse_ids(spot_table_t *t, const char *csv)
+{
+    uint8_t n = 0;
+    const char *p = csv;
+
+    while (*p) {
+        while (*p == ' ') p++;
+        const char *start = p;
+        while (*p && *p != ',') p++;
+        const char *end = p;
+        while (end > start && end[-1] == ' ') end--;
+
+        size_t len = (size_t)(end - start);
+        if (len == 0 || len >= SPOT_ID_LEN) return ESP_ERR_INVALID_ARG;
+        if (n >= MAX_SPOTS) return ESP_ERR_INVALID_SIZE;
+
+        memcpy(t->id[n], start, len);
+        t->id[n][len] = '\0';
+        n++;
+
+        if (*p == ',') p++;
+    }
+    if (n == 0) return ESP_ERR_INVALID_ARG;
+    t->count = n;
+    return ESP_OK;
+}
+
+// output: the pins drive LEDs, so input-only pads (34-39 on the ESP32) are refused too.
+static esp_err_t load_pins(nvs_handle_t h, const char *key, gpio_num_t *out, uint8_t count, bool output)
+{
+    int8_t pins[MAX_SPOTS];
+    size_t len = sizeof(pins);
+    esp_err_t err = nvs_get_blob(h, key, pins, &len);
+    if (err != ESP_OK) return err;
+    if (len != count) return ESP_ERR_INVALID_SIZE;
+    for (uint8_t i = 0; i < count; i++) {
+        int pin = pins[i];
+        bool ok = pin >= 0 && (output ? GPIO_IS_VALID_OUTPUT_GPIO(pin) : GPIO_IS_VALID_GPIO(pin));
+        if (!ok) {
+            ESP_LOGW(TAG, "Bad %s pin %d for slot %u", key, pin, (unsigned)i);
+            return ESP_ERR_INVALID_ARG;
+        }
+        out[i] = (gpio_num_t)pin;
+    }
+    return ESP_OK;
+}
+
+esp_err_t spot_table_load(spot_table_t *t)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(SPOT_TABLE_NVS_NS, NVS_READONLY, &h);
+    if (err != ESP_OK) return err;
+
+    // Build into a scratch copy so a half-valid table never replaces t.
+    static spot_table_t s_tmp;
+    memset(&s_tmp, 0, sizeof(s_tmp));
+
+    uint8_t io = SPOT_IO_GPIO;
+    nvs_get_u8(h, "io", &io);   // optional
+    s_tmp.io = (io == SPOT_IO_SHIFTREG) ? SPOT_IO_SHIFTREG : SPOT_IO_GPIO;
+
+    char ids[MAX_SPOTS * SPOT_ID_LEN];
+    size_t len = sizeof(ids);
+    err = nvs_get_str(h, "ids", ids, &len);
+    if (err == ESP_OK) err = spot_table_parse_ids(&s_tmp, ids);
+
+    if (err == ESP_OK && s_tmp.io == SPOT_IO_GPIO) {
+        err = load_pins(h, "ir", s_tmp.ir_pin, s_tmp.count, false);
+        if (err == ESP_OK) err = load_pins(h, "green", s_tmp.led_green, s_tmp.count, true);
+        if (err == ESP_OK) err = load_pins(h, "blue", s_tmp.led_blue, s_tmp.count, true);
+    }
+    nvs_close(h);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Spot table in NVS rejected: %s", esp_err_to_name(err));
+        return err;
+    }
+    *t = s_tmp;
+    return ESP_OK;
+}
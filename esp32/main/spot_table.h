@@ -0,0 +1,51 @@
+/* @file  spot_table.h
+   @brief runtime spot table (slot ids, I/O backend, pins) provisioned in NVS
+*/
+
+#ifndef _SPOT_TABLE_H_
+#define _SPOT_TABLE_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "occupancy.h"       // MAX_SPOTS
+
+#define SPOT_ID_LEN   12     // "A-20" + NUL, with room for longer ids
+
+typedef enum {
+    SPOT_IO_GPIO = 0,        // one IR pin + two LED pins per spot (ISR + LEDC)
+    SPOT_IO_SHIFTREG = 1,    // chained 74HC165 inputs + LED sink drivers on SPI
+} spot_io_t;
+
+typedef struct {
+    spot_io_t io;
+    uint8_t count;
+    char id[MAX_SPOTS][SPOT_ID_LEN];
+    gpio_num_t ir_pin[MAX_SPOTS];      // SPOT_IO_GPIO only
+    gpio_num_t led_green[MAX_SPOTS];   // SPOT_IO_GPIO only
+    gpio_num_t led_blue[MAX_SPOTS];    // SPOT_IO_GPIO only
+} spot_table_t;
+
+/*
+ * NVS namespace "spots":
+ *   io    u8      0 = GPIO, 1 = shift registers (default 0)
+ *   ids   string  comma separated slot ids in bit order, e.g. "A-1,A-2,A-3"
+ *   ir    blob    one int8 GPIO number per spot    (GPIO backend only)
+ *   green blob    one int8 GPIO number per spot    (GPIO backend only)
+ *   blue  blob    one int8 GPIO number per spot    (GPIO backend only)
+ *
+ * Returns ESP_OK with t filled, or an error and t untouched.
+ */
+esp_err_t spot_table_load(spot_table_t *t);
+
+// Parse "A-1, A-2,A-3" into t->id / t->count. ESP_ERR_INVALID_ARG on an
+// empty or too long id, ESP_ERR_INVALID_SIZE past MAX_SPOTS.
+esp_err_t spot_table_parse_ids(spot_table_t *t, const char *csv);
+
+// Bitmap with one bit set per configured spot.
+static inline uint64_t spot_table_mask(const spot_table_t *t)
+{
+    return (t->count >= 64) ? ~0ULL : ((1ULL << t->count) - 1);
+}
+
+#endif
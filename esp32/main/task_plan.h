@@ -0,0 +1,45 @@
+/* @file  task_plan.h
+   @brief core affinity and priority of every firmware task
+   @note  core 0 runs the radio and everything network-facing, core 1 the
+          sensors, actuators and LEDs, so a Wi-Fi burst cannot delay a spot
+          scan or a servo deadline
+*/
+
+#ifndef _TASK_PLAN_H_
+#define _TASK_PLAN_H_
+
+#include "sdkconfig.h"
+
+//  core 0 (PRO_CPU)                          core 1 (APP_CPU)
+//  23  wifi            (IDF)                  7  gate_task      servo + screen deadlines, µs of work per wake
+//  22  esp_timer       (IDF)                  6  parking_task   IR edges / scan, debounce, LEDs, publish
+//  18  tcpip_thread    (lwIP, SNTP)           3  display_task   I2C LCD writes (~1 ms each)
+//   5  mqtt_task       (sdkconfig.defaults)
+//   5  tcp_server      camera QR link
+//   4  ota             delta OTA download + patch, only while updating
+//
+// The IR GPIO interrupt is allocated on core 1 as well (parking_task installs
+// it), so an edge never waits behind the Wi-Fi interrupt. The IDF tasks are
+// pinned by sdkconfig.defaults; on a single-core build everything shares core 0.
+
+#ifdef CONFIG_FREERTOS_UNICORE
+#define NET_CORE                0
+#define IO_CORE                 0
+#else
+#define NET_CORE                0
+#define IO_CORE                 1
+#endif
+
+#define GATE_TASK_PRIO          7
+#define PARKING_TASK_PRIO       6
+#define DISPLAY_TASK_PRIO       3
+#define TCP_SERVER_TASK_PRIO    5
+#define OTA_TASK_PRIO           4
+
+#define GATE_TASK_STACK         4096
+#define PARKING_TASK_STACK      7168
+#define DISPLAY_TASK_STACK      3072
+#define TCP_SERVER_TASK_STACK   6144
+#define OTA_TASK_STACK          8192
+
+#endif
@@ -0,0 +1,106 @@
+/* @file  telemetry.c
+   @brief runtime telemetry helpers: latency histograms, scheduling jitter and
+          FreeRTOS task stats
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "telemetry.h"
+
+#define TELEMETRY_MAX_TASKS 24
+
+// Run-time counters of the previous call, by task number, for the CPU deltas.
+typedef struct {
+    UBaseType_t num;
+    uint32_t runtime;
+} task_prev_t;
+
+static task_prev_t s_prev[TELEMETRY_MAX_TASKS];
+static int s_prev_n = 0;
+static uint32_t s_prev_total = 0;
+
+void lat_hist_record(lat_hist_t *h, int64_t ms)
+{
+    if (ms < 0) ms = 0;
+    int k = 0;
+    while (k < LAT_HIST_BUCKETS - 1 && ms >= (1LL << k)) k++;
+    h->count[k]++;
+    if (ms > h->max_ms) h->max_ms = (ms > UINT32_MAX) ? UINT32_MAX : (uint32_t)ms;
+}
+
+int lat_hist_format(char *buf, size_t cap, const char *name, const lat_hist_t *h)
+{
+    int n = snprintf(buf, cap, "\"%s\":[", name);
+    for (int k = 0; k < LAT_HIST_BUCKETS && n < (int)cap; k++) {
+        n += snprintf(buf + n, cap - n, "%s%" PRIu32, k ? "," : "", h->count[k]);
+    }
+    if (n < (int)cap) n += snprintf(buf + n, cap - n, "],\"%s_max\":%" PRIu32, name, h->max_ms);
+    return n;
+}
+
+void task_jitter_record(task_jitter_t *j, int64_t deadline_us)
+{
+    int64_t late_us = esp_timer_get_time() - deadline_us;
+    if (late_us < 0) return;
+    portENTER_CRITICAL(&j->lock);
+    j->sum_us += late_us;
+    if (late_us > j->max_us) j->max_us = late_us;
+    j->n++;
+    portEXIT_CRITICAL(&j->lock);
+}
+
+int task_jitter_format(char *buf, size_t cap, const char *name, task_jitter_t *j)
+{
+    portENTER_CRITICAL(&j->lock);
+    int64_t avg = j->n ? j->sum_us / j->n : 0;
+    int64_t max = j->max_us;
+    uint32_t n = j->n;
+    j->sum_us = 0;
+    j->max_us = 0;
+    j->n = 0;
+    portEXIT_CRITICAL(&j->lock);
+
+    return snprintf(buf, cap, "\"%s\":{\"avg\":%" PRId64 ",\"max\":%" PRId64 ",\"n\":%" PRIu32 "}",
+                    name, avg, max, n);
+}
+
+static uint32_t prev_runtime(UBaseType_t num)
+{
+    for (int i = 0; i < s_prev_n; i++) if (s_prev[i].num == num) return s_prev[i].runtime;
+    return 0;
+}
+
+int telemetry_format_tasks(char *buf, size_t cap)
+{
+    static TaskStatus_t s_tasks[TELEMETRY_MAX_TASKS];
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(s_tasks, TELEMETRY_MAX_TASKS, &total);
+
+    // total is wall-clock run-time ticks; every core accumulates that much.
+    uint32_t span = (total - s_prev_total) * portNUM_PROCESSORS;
+
+    int n = snprintf(buf, cap, "\"tasks\":[");
+    for (UBaseType_t i = 0; i < count && n < (int)cap; i++) {
+        const TaskStatus_t *t = &s_tasks[i];
+        uint32_t used = t->ulRunTimeCounter - prev_runtime(t->xTaskNumber);
+        unsigned cpu = span ? (unsigned)(((uint64_t)used * 100 + span / 2) / span) : 0;
+        int core = (t->xCoreID == 0 || t->xCoreID == 1) ? (int)t->xCoreID : -1;   // -1 = unpinned
+
+        n += snprintf(buf + n, cap - n, "%s{\"n\":\"%s\",\"cpu\":%u,\"stk\":%u,\"core\":%d}",
+                      i ? "," : "", t->pcTaskName, cpu, (unsigned)t->usStackHighWaterMark, core);
+    }
+    if (n < (int)cap) n += snprintf(buf + n, cap - n, "]");
+
+    s_prev_n = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+        s_prev[s_prev_n].num = s_tasks[i].xTaskNumber;
+        s_prev[s_prev_n].runtime = s_tasks[i].ulRunTimeCounter;
+        s_prev_n++;
+    }
+    s_prev_total = total;
+    return n;
+}
@@ -0,0 +1,50 @@
+/* @file  telemetry.h
+   @brief runtime telemetry helpers: latency histograms, scheduling jitter and
+          FreeRTOS task stats
+*/
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// Bucket k counts samples below 2^k ms (k = 0..10), the last one >= 1024 ms.
+// Counters are cumulative since boot, so a collector can diff two reports and
+// a lost message loses nothing. One writer per histogram, no locking.
+#define LAT_HIST_BUCKETS 12
+
+typedef struct {
+    uint32_t count[LAT_HIST_BUCKETS];
+    uint32_t max_ms;
+} lat_hist_t;
+
+void lat_hist_record(lat_hist_t *h, int64_t ms);
+
+// "name":[c0,...,c11],"name_max":N
+int lat_hist_format(char *buf, size_t cap, const char *name, const lat_hist_t *h);
+
+// How late a task woke past the deadline it slept for. Written by the task,
+// read and reset by the telemetry report from another one, hence the lock.
+typedef struct {
+    portMUX_TYPE lock;
+    int64_t sum_us;
+    int64_t max_us;
+    uint32_t n;
+} task_jitter_t;
+
+#define TASK_JITTER_INIT { .lock = portMUX_INITIALIZER_UNLOCKED }
+
+// deadline_us: esp_timer_get_time() scale. Early wakes are not counted.
+void task_jitter_record(task_jitter_t *j, int64_t deadline_us);
+
+// "name":{"avg":..,"max":..,"n":..} since the previous call, then resets j.
+int task_jitter_format(char *buf, size_t cap, const char *name, task_jitter_t *j);
+
+// "tasks":[{"n":"tcp_server","cpu":3,"stk":2210,"core":0},...]
+// cpu: % of all cores since the previous call; stk: stack high-water mark (bytes).
+// Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+int telemetry_format_tasks(char *buf, size_t cap);
+
+#endif
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Delta OTA for the parking boards (see esp32/main/ota.c).
+
+  make:    builds the patch from the image the fleet runs to the new one
+           and prints the command for parking/<parking_id>/ota
+  publish: sends that command to a set of boards and times each of them
+           until it reports the new version confirmed
+
+    python tools/ota_delta.py make --old optipark-1.3.0.bin --new build/optipark.bin \
+        --out-dir /srv/ota --url-base http://10.0.0.5/ota > cmd.json
+    python tools/ota_delta.py publish --cmd cmd.json --broker 10.0.0.5 \
+        nice_sophia.A nice_sophia.B nice_sophia.C
+
+Both images must be the .bin files as flashed (signed, for boards built with
+sdkconfig.ota_signing): the patch is applied against the bytes of the running slot.
+
+Needs: pip install detools paho-mqtt
+"""
+import argparse
+import hashlib
+import io
+import json
+import os
+import sys
+import time
+
+# esp_app_desc_t sits right after the image header (24 B) and the first
+# segment header (8 B)
+APP_DESC_OFFSET = 32
+VERSION_OFFSET = APP_DESC_OFFSET + 16        # char version[32]
+ELF_SHA_OFFSET = APP_DESC_OFFSET + 144       # uint8_t app_elf_sha256[32]
+BASE_LEN = 8                                 # OTA_BASE_LEN in ota.h
+URL_MAX = 191                                # ota_cmd_t.url
+
+DONE_STATES = ("confirmed", "failed", "rolled_back")
+
+
+def app_version(image):
+    raw = image[VERSION_OFFSET:VERSION_OFFSET + 32]
+    return raw.split(b"\0", 1)[0].decode()
+
+
+def app_base(image):
+    return image[ELF_SHA_OFFSET:ELF_SHA_OFFSET + BASE_LEN].hex()
+
+
+def cmd_make(args):
+    import detools
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+    version, base = app_version(new), app_base(old)
+    if version == app_version(old):
+        sys.exit("old and new images are both version %s" % version)
+
+    patch = io.BytesIO()
+    # heatshrink: the only detools compression esp_delta_ota decodes, and it
+    # runs in a few hundred bytes of RAM
+    detools.create_patch(io.BytesIO(old), io.BytesIO(new), patch, compression="heatshrink")
+    patch = patch.getvalue()
+
+    name = "optipark-%s-%s.patch" % (version, base)
+    os.makedirs(args.out_dir, exist_ok=True)
+    with open(os.path.join(args.out_dir, name), "wb") as f:
+        f.write(patch)
+
+    url = "%s/%s" % (args.url_base.rstrip("/"), name)
+    if len(url) > URL_MAX:
+        sys.exit("URL longer than %d bytes: %s" % (URL_MAX, url))
+    cmd = {"version": version, "url": url, "base": base,
+           "size": len(patch), "sha256": hashlib.sha256(patch).hexdigest()}
+    print(json.dumps(cmd))
+    print("%s: %d byte patch for a %d byte image (%.1f %%)"
+          % (name, len(patch), len(new), 100.0 * len(patch) / len(new)), file=sys.stderr)
+
+
+def cmd_publish(args):
+    import paho.mqtt.client as mqtt
+
+    with open(args.cmd) as f:
+        cmd = json.load(f)
+    payload = json.dumps(cmd, separators=(",", ":"))
+    boards = {pid: {"state": "sent", "detail": "", "t": None} for pid in args.parking_ids}
+    t0 = {}
+
+    def on_message(client, userdata, msg):
+        pid = msg.topic.split("/")[1]
+        if pid not in boards or msg.retain:      # retained = status from before this run
+            return
+        st = json.loads(msg.payload)
+        b = boards[pid]
+        b["state"], b["detail"] = st["state"], st.get("detail", "")
+        if st["state"] == "confirmed" and st.get("running") != cmd["version"]:
+            b["state"] = "failed"                 # confirmed the wrong image
+        if b["state"] in DONE_STATES:
+            b["t"] = time.monotonic() - t0[pid]
+        print("%-16s %-12s %s" % (pid, st["state"], b["detail"]), file=sys.stderr)
+
+    try:
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    except AttributeError:                        # paho-mqtt 1.x
+        client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(args.broker, args.port)
+    client.loop_start()
+    for pid in boards:
+        client.subscribe("parking/%s/ota/status" % pid, qos=1)
+    time.sleep(1)                                 # let the retained statuses go by
+
+    # A few boards at a time, so the patch server and the AP are not hit at once
+    pending = list(boards)
+    while pending or any(b["t"] is None for b in boards.values()):
+        busy = sum(1 for pid, b in boards.items() if pid in t0 and b["t"] is None)
+        while pending and busy < args.parallel:
+            pid = pending.pop(0)
+            t0[pid] = time.monotonic()
+            client.publish("parking/%s/ota" % pid, payload, qos=1)
+            busy += 1
+        timed_out = [pid for pid in t0 if boards[pid]["t"] is None
+                     and time.monotonic() - t0[pid] > args.timeout]
+        for pid in timed_out:
+            boards[pid]["state"], boards[pid]["t"] = "timeout", args.timeout
+        time.sleep(0.2)
+    client.loop_stop()
+
+    print("%-16s %-12s %8s  %s" % ("parking_id", "result", "seconds", "detail"))
+    for pid, b in boards.items():
+        print("%-16s %-12s %8.1f  %s" % (pid, b["state"], b["t"], b["detail"]))
+    return 0 if all(b["state"] == "confirmed" for b in boards.values()) else 1
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="action", required=True)
+
+    mk = sub.add_parser("make", help="build a patch and print its OTA command")
+    mk.add_argument("--old", required=True, help="image the boards run now")
+    mk.add_argument("--new", required=True, help="image to roll out")
+    mk.add_argument("--out-dir", required=True, help="where the HTTP server serves patches from")
+    mk.add_argument("--url-base", required=True, help="URL of --out-dir as the boards see it")
+
+    pb = sub.add_parser("publish", help="send a command and time each board")
+    pb.add_argument("--cmd", required=True, help="output of make")
+    pb.add_argument("--broker", default="localhost")
+    pb.add_argument("--port", type=int, default=1883)
+    pb.add_argument("--parallel", type=int, default=4, help="boards updating at once")
+    pb.add_argument("--timeout", type=float, default=300, help="seconds per board")
+    pb.add_argument("parking_ids", nargs="+")
+
+    args = ap.parse_args()
+    if args.action == "make":
+        cmd_make(args)
+        return 0
+    return cmd_publish(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,332 @@
+#!/usr/bin/env python3
+"""QR gate load generator: plays ESP32-CAM clients against the gate's camera
+link (TCP_LISTEN_PORT, 3333) and reports decision latency and drops.
+
+Each connection sends QR lines like the camera does. For every line the gate
+answers with one decision line (TCP_DECISION_ECHO in app_main.c, format in
+components/optipark_core/include/qr_link.h):
+    OPK-D <seq> <t_ms> <decide_us> <gate> <result>
+
+Against a board (keys as provisioned, see README "Gate QR Tokens"):
+    python tools/qr_loadgen.py --host 192.168.1.50 --keys 1:<64 hex> --rate 20 --conns 2 --duration 30
+
+Against the host build of the firmware core (components/optipark_core, gate_sim):
+    python tools/qr_loadgen.py --spawn ../_build/gate_sim --rate 200 --burst 8 --count 2000
+
+Line kinds (--mix, weights):
+    valid       fresh signed token for --zone                     -> open
+    duplicate   replay of a token that already opened             -> already used (ignored if back-to-back)
+    wrong_zone  signed token for another zone                     -> wrong zone
+    bad_tag     signed token with a corrupted tag                 -> bad signature
+    garbage     not a token at all                                -> invalid
+    expired     signed token past exp + clock skew                -> expired
+    overlong    longer than the gate's line buffer                -> too long
+
+A board with a loaded reservation allowlist answers "no reservation" to the
+generated tokens unless they are booked; run it before the first allowlist
+snapshot or count those with --accept-not-booked.
+"""
+import argparse
+import asyncio
+import base64
+import hashlib
+import hmac
+import json
+import random
+import shlex
+import socket
+import statistics
+import sys
+import time
+
+DECISION_PREFIX = "OPK-D "
+LINE_MAX = 255                      # QR_LINK_BUF_SIZE - 1
+USED_WINDOW = 16                    # replay within QR_USED_MAX (32) opened tokens
+CLOCK_SKEW_S = 120                  # QR_CLOCK_SKEW_S
+
+EXPECTED = {
+    "valid": {"open"},
+    "duplicate": {"already used", "ignored"},
+    "wrong_zone": {"wrong zone"},
+    "bad_tag": {"bad signature"},
+    "garbage": {"invalid"},
+    "expired": {"expired"},
+    "overlong": {"too long"},
+}
+DEFAULT_MIX = "valid=60,duplicate=10,wrong_zone=10,bad_tag=10,garbage=10"
+
+
+def parse_keys(spec):
+    """'1:<64 hex>,2:<64 hex>' -> [(1, bytes), ...], same format as QR_KEYS"""
+    keys = []
+    for item in spec.split(","):
+        kid, hexkey = item.strip().split(":", 1)
+        key = bytes.fromhex(hexkey)
+        if len(key) != 32:
+            raise ValueError("key %s is not 32 bytes" % kid)
+        keys.append((int(kid), key))
+    return keys
+
+
+def sign(kid, key, slot, exp, user):
+    # OPK2|<kid>|<slot>|<exp>|<user>|<tag>, see Reservation/qr_token.py and qr.h
+    msg = "OPK2|%d|%s|%d|%s" % (kid, slot, exp, user)
+    tag = hmac.new(key, msg.encode(), hashlib.sha256).digest()[:16]
+    return msg + "|" + base64.urlsafe_b64encode(tag).rstrip(b"=").decode()
+
+
+class Generator:
+    def __init__(self, args):
+        self.keys = parse_keys(args.keys)
+        self.zone = args.zone
+        self.other_zone = "B" if args.zone != "B" else "C"
+        kinds, weights = [], []
+        for item in args.mix.split(","):
+            name, w = item.split("=")
+            if name not in EXPECTED:
+                raise ValueError("unknown kind %s" % name)
+            kinds.append(name)
+            weights.append(float(w))
+        self.kinds, self.weights = kinds, weights
+        self.rng = random.Random(args.seed)
+        self.n = 0
+        self.opened = []            # tokens the gate opened for, newest last
+
+    def token(self, zone, exp):
+        kid, key = self.rng.choice(self.keys)
+        self.n += 1
+        return sign(kid, key, "%s-%d" % (zone, self.rng.randint(1, 40)), exp, "load%06d" % self.n)
+
+    def next(self):
+        kind = self.rng.choices(self.kinds, self.weights)[0]
+        now = int(time.time())
+        if kind == "duplicate" and not self.opened:
+            kind = "valid"
+        if kind == "valid":
+            return kind, self.token(self.zone, now + 3600)
+        if kind == "duplicate":
+            return kind, self.rng.choice(self.opened[-USED_WINDOW:])
+        if kind == "wrong_zone":
+            return kind, self.token(self.other_zone, now + 3600)
+        if kind == "bad_tag":
+            # Flip the tag's first char: the last one carries zero padding bits,
+            # and changing those makes the token invalid base64url, not a bad tag.
+            tok = self.token(self.zone, now + 3600)
+            head, tag = tok.rsplit("|", 1)
+            return kind, head + "|" + ("B" if tag[0] != "B" else "C") + tag[1:]
+        if kind == "expired":
+            return kind, self.token(self.zone, now - CLOCK_SKEW_S - 60)
+        if kind == "overlong":
+            return kind, "X" * (LINE_MAX + 40)
+        self.n += 1
+        return kind, "HELLO-%06d" % self.n
+
+    def decided(self, line, result):
+        if result == "open":
+            self.opened.append(line)
+            del self.opened[:-USED_WINDOW]
+
+
+class Stats:
+    def __init__(self):
+        self.sent = {}
+        self.results = {}
+        self.gate = {}
+        self.rtt_ms = []
+        self.decide_us = []
+        self.unexpected = {}
+        self.refused = 0
+        self.closed = 0
+        self.missing = 0
+
+    def count(self, d, key):
+        d[key] = d.get(key, 0) + 1
+
+
+class Conn:
+    def __init__(self, idx, args, gen, stats):
+        self.idx, self.args, self.gen, self.stats = idx, args, gen, stats
+        self.pending = {}           # seq -> (kind, line, t_sent)
+        self.seq = 0
+        self.writer = None
+        self.reader_task = None
+
+    async def open(self):
+        try:
+            reader, self.writer = await asyncio.open_connection(self.args.host, self.args.port)
+        except OSError:
+            self.stats.refused += 1
+            return False
+        sock = self.writer.get_extra_info("socket")
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)    # one segment per line, like the camera
+        self.reader_task = asyncio.ensure_future(self.read(reader))
+        return True
+
+    async def read(self, reader):
+        while True:
+            raw = await reader.readline()
+            if not raw:
+                if self.pending:
+                    self.stats.closed += 1
+                return
+            t = time.monotonic()
+            text = raw.decode(errors="replace").rstrip("\n")
+            if not text.startswith(DECISION_PREFIX):
+                continue
+            seq, t_ms, decide_us, gate, result = text[len(DECISION_PREFIX):].split(" ", 4)
+            entry = self.pending.pop(int(seq), None)
+            if entry is None:
+                continue
+            kind, line, t_sent = entry
+            st = self.stats
+            st.rtt_ms.append((t - t_sent) * 1000.0)
+            st.decide_us.append(int(decide_us))
+            st.count(st.results, result)
+            st.count(st.gate, gate)
+            ok = EXPECTED[kind] | ({"no reservation"} if self.args.accept_not_booked else set())
+            if result not in ok:
+                st.count(st.unexpected, "%s -> %s" % (kind, result))
+            self.gen.decided(line, result)
+
+    def send(self, lines):
+        if self.writer is None or self.writer.is_closing():
+            return
+        now = time.monotonic()
+        for kind, line in lines:
+            self.seq += 1
+            self.pending[self.seq] = (kind, line, now)
+            self.stats.count(self.stats.sent, kind)
+        self.writer.write("".join(line + "\n" for _, line in lines).encode())
+
+    async def close(self, wait_s):
+        deadline = time.monotonic() + wait_s
+        while self.pending and time.monotonic() < deadline and not self.reader_task.done():
+            await asyncio.sleep(0.01)
+        self.stats.missing += len(self.pending)
+        self.writer.close()
+        self.reader_task.cancel()
+
+
+def pct(values, p):
+    if not values:
+        return float("nan")
+    s = sorted(values)
+    return s[min(len(s) - 1, int(round(p / 100.0 * (len(s) - 1))))]
+
+
+async def run(args):
+    gen = Generator(args)
+    stats = Stats()
+    conns = [Conn(i, args, gen, stats) for i in range(args.conns)]
+    live = [c for c in conns if await c.open()]
+    if not live:
+        sys.exit("no connection to %s:%d" % (args.host, args.port))
+
+    # Open loop: bursts go out on schedule whether or not the gate keeps up.
+    interval = args.burst / float(args.rate)
+    total = args.count if args.count else int(args.duration * args.rate)
+    t0 = time.monotonic()
+    sent = 0
+    tick = 0
+    while sent < total:
+        n = min(args.burst, total - sent)
+        live[tick % len(live)].send([gen.next() for _ in range(n)])
+        sent += n
+        tick += 1
+        delay = t0 + tick * interval - time.monotonic()
+        await asyncio.sleep(max(0.0, delay))
+    elapsed = time.monotonic() - t0
+
+    await asyncio.gather(*(c.close(args.drain) for c in live))
+    return stats, elapsed
+
+
+def report(args, stats, elapsed):
+    total = sum(stats.sent.values())
+    out = {
+        "target": "%s:%d" % (args.host, args.port),
+        "sent": total,
+        "rate": round(total / elapsed, 1) if elapsed > 0 else total,
+        "conns": args.conns,
+        "burst": args.burst,
+        "sent_by_kind": stats.sent,
+        "results": stats.results,
+        "gate": stats.gate,
+        "rtt_ms": {"p50": pct(stats.rtt_ms, 50), "p90": pct(stats.rtt_ms, 90),
+                   "p99": pct(stats.rtt_ms, 99), "max": max(stats.rtt_ms, default=float("nan")),
+                   "mean": statistics.fmean(stats.rtt_ms) if stats.rtt_ms else float("nan")},
+        "decide_us": {"p50": pct(stats.decide_us, 50), "p99": pct(stats.decide_us, 99),
+                      "max": max(stats.decide_us, default=0)},
+        "drops": {"no_decision": stats.missing, "gate_queue_full": stats.gate.get("full", 0),
+                  "conn_refused": stats.refused, "conn_closed": stats.closed},
+        "unexpected": stats.unexpected,
+    }
+    if args.json:
+        print(json.dumps(out, indent=2))
+        return out
+
+    print("%s  %d lines in %.1f s (%.1f/s), %d conn(s), bursts of %d"
+          % (out["target"], total, elapsed, out["rate"], args.conns, args.burst))
+    r = out["rtt_ms"]
+    print("decision latency  p50 %.2f ms  p90 %.2f ms  p99 %.2f ms  max %.2f ms"
+          % (r["p50"], r["p90"], r["p99"], r["max"]))
+    d = out["decide_us"]
+    print("QR check on gate  p50 %d us  p99 %d us  max %d us" % (d["p50"], d["p99"], d["max"]))
+    print("results  " + "  ".join("%s=%d" % kv for kv in sorted(stats.results.items())))
+    print("drops    " + "  ".join("%s=%d" % kv for kv in out["drops"].items()))
+    for k, v in sorted(stats.unexpected.items()):
+        print("unexpected  %-36s %d" % (k, v))
+    return out
+
+
+async def spawn(cmd):
+    proc = await asyncio.create_subprocess_exec(*shlex.split(cmd), "--port", "0",
+                                                stdout=asyncio.subprocess.PIPE)
+    line = (await asyncio.wait_for(proc.stdout.readline(), 10)).decode()
+    if "listening on" not in line:
+        proc.kill()
+        sys.exit("unexpected output from %s: %r" % (cmd, line))
+    return proc, int(line.rsplit(" ", 1)[1])
+
+
+async def main_async(args):
+    proc = None
+    if args.spawn:
+        proc, args.port = await spawn(args.spawn + (" --keys " + args.keys) + (" --zone " + args.zone))
+        args.host = "127.0.0.1"
+    try:
+        stats, elapsed = await run(args)
+    finally:
+        if proc:
+            proc.kill()
+            await proc.wait()
+    out = report(args, stats, elapsed)
+    if args.check and (out["drops"]["no_decision"] or out["drops"]["conn_refused"] or out["unexpected"]):
+        return 1
+    return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--host", default="127.0.0.1")
+    ap.add_argument("--port", type=int, default=3333)
+    ap.add_argument("--spawn", help="start this gate_sim binary on a free port and test it")
+    ap.add_argument("--keys", default="1:" + "11" * 32, help="kid:<64 hex>[,...], as provisioned on the gate")
+    ap.add_argument("--zone", default="A", help="zone the gate serves (QR_EXPECTED_ZONE)")
+    ap.add_argument("--mix", default=DEFAULT_MIX, help="kind=weight,... (default %(default)s)")
+    ap.add_argument("--rate", type=float, default=10, help="lines per second, all connections")
+    ap.add_argument("--burst", type=int, default=1, help="lines sent back-to-back per tick")
+    ap.add_argument("--conns", type=int, default=1, help="concurrent camera connections (the gate takes 4)")
+    ap.add_argument("--duration", type=float, default=10, help="seconds, unless --count")
+    ap.add_argument("--count", type=int, help="lines to send")
+    ap.add_argument("--drain", type=float, default=5, help="seconds to wait for the last decisions")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--accept-not-booked", action="store_true", help="'no reservation' is a valid answer")
+    ap.add_argument("--json", action="store_true", help="print the report as JSON")
+    ap.add_argument("--check", action="store_true", help="exit 1 on missing decisions or unexpected results")
+    args = ap.parse_args()
+    return asyncio.run(main_async(args))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
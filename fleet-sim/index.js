@@ -0,0 +1,574 @@
+/**
+ * Fleet simulator: N virtual gate nodes publishing like the ESP32 firmware
+ * (PER_SLOT mode, esp32/main/app_main.c), to load-test the
+ * MQTT -> bridge -> Kafka -> redis-writer -> Redis pipeline without hardware.
+ *
+ * Every node has its own MQTT connection and SLOTS_PER_NODE spots. It sends
+ * publish_spot() events on parking/<parking_id>/status and
+ * publish_rain01_as_rain_pct() events on parking/rain (same JSON or binary
+ * payloads, QoS 1, retained). The firmware's per-slot rate limit and its outbox
+ * are also emulated: changes are held or coalesced, and queued while offline,
+ * then backfilled.
+ *
+ * Each spot event is followed through the stack by (slot_id, sent_at):
+ *   MQTT PUBACK     -> broker throughput and publish latency
+ *   Kafka record    -> bridge latency (record CreateTime - publish)
+ *   Redis hash      -> Kafka -> Redis latency (keyspace notification on spot:*)
+ * plus the consumer-group lag of parking-redis-writer.
+ */
+
+const mqtt = require("mqtt");
+const { Kafka, logLevel } = require("kafkajs");
+const Redis = require("ioredis");
+const wire = require("@optipark/shared/wire");
+
+const env = (k, d) => process.env[k] ?? d;
+const num = (k, d) => Number(env(k, d));
+
+const mqttUrl = env("MQTT_URL", "mqtt://mosquitto:1883");
+const kafkaBrokers = env("KAFKA_BROKERS", "kafka:9092").split(",");
+const redisHost = env("REDIS_HOST", "redis");
+const redisPort = num("REDIS_PORT", 6379);
+
+// Dedicated parkings, so a run (and its cleanup) never touches the real ones.
+// The bridge and parking-redis-writer must list them in EXTRA_PARKING_IDS.
+const PARKING_IDS = env("SIM_PARKING_IDS", "sim.X,sim.Y,sim.Z").split(",");
+const NODES = num("SIM_NODES", 100);
+const SLOTS_PER_NODE = num("SIM_SLOTS_PER_NODE", 5);
+const DURATION_S = num("SIM_DURATION_S", 300);
+const WIRE = env("SIM_WIRE", "json"); // "json" | "binary", like WIRE_FORMAT
+// Arrivals and departures: exponential vacant / parked times per slot
+const VACANT_S = num("SIM_VACANT_S", 60);
+const DWELL_S = num("SIM_DWELL_S", 120);
+// Flapping: after a transition, the sensor toggles FLAP_TOGGLES more times
+const FLAP_PROB = num("SIM_FLAP_PROB", 0.05);
+const FLAP_TOGGLES = num("SIM_FLAP_TOGGLES", 6);
+const FLAP_GAP_MS = num("SIM_FLAP_GAP_MS", 150);
+// Firmware SPOT_RATE_BURST / SPOT_RATE_WINDOW_MS (0 = firmware without the limit)
+const RATE_BURST = num("SIM_RATE_BURST", 4);
+const RATE_WINDOW_MS = num("SIM_RATE_WINDOW_MS", 60000);
+// Rain: one sensor per node, at most every RAIN_EVERY_S (0 = off)
+const RAIN_EVERY_S = num("SIM_RAIN_EVERY_S", 60);
+// Reconnect storms: every STORM_EVERY_S, STORM_FRACTION of the nodes drop at
+// once and all come back STORM_DOWN_S later (0 = off)
+const STORM_EVERY_S = num("SIM_STORM_EVERY_S", 120);
+const STORM_FRACTION = num("SIM_STORM_FRACTION", 0.3);
+const STORM_DOWN_S = num("SIM_STORM_DOWN_S", 10);
+// Firmware outbox (OUTBOX_CAPACITY, OUTBOX_DRAIN_BURST / OUTBOX_DRAIN_EVERY_MS)
+const OUTBOX_CAPACITY = 64;
+const OUTBOX_DRAIN_BURST = 4;
+const OUTBOX_DRAIN_EVERY_MS = 250;
+const REPORT_EVERY_S = num("SIM_REPORT_EVERY_S", 10);
+const DRAIN_S = num("SIM_DRAIN_S", 20); // wait for the pipeline after the last publish
+const CLEANUP = env("SIM_CLEANUP", "1") === "1";
+
+const KAFKA_TOPICS = PARKING_IDS.map((p) => `parking.${p}`);
+const WRITER_GROUP = env("SIM_WRITER_GROUP", "parking-redis-writer");
+
+// ------------------------------------------------------------
+// Measurements
+// ------------------------------------------------------------
+function pct(sorted, p) {
+  if (sorted.length === 0) return null;
+  return sorted[Math.min(sorted.length - 1, Math.ceil((p / 100) * sorted.length) - 1)];
+}
+
+class Dist {
+  constructor() {
+    this.all = [];
+    this.window = [];
+  }
+  add(ms) {
+    this.all.push(ms);
+    this.window.push(ms);
+  }
+  static summary(values) {
+    const s = [...values].sort((a, b) => a - b);
+    return { n: s.length, p50_ms: pct(s, 50), p90_ms: pct(s, 90), p99_ms: pct(s, 99), max_ms: s.length ? s[s.length - 1] : null };
+  }
+  take() {
+    const w = Dist.summary(this.window);
+    this.window = [];
+    return w;
+  }
+  total() {
+    return Dist.summary(this.all);
+  }
+}
+
+const stats = {
+  published: 0, // spot events handed to MQTT
+  acked: 0,
+  publishErrors: 0,
+  rain: 0,
+  held: 0, // rate limit: changes delayed
+  coalesced: 0, // rate limit: transitions never published
+  outboxed: 0,
+  outboxDropped: 0,
+  reconnects: 0,
+  brokerSeen: 0, // delivered back to the monitor subscriber
+  kafkaSeen: 0,
+  redisSeen: 0,
+  puback: new Dist(),
+  bridge: new Dist(), // MQTT publish -> Kafka record timestamp
+  toRedis: new Dist(), // Kafka record timestamp -> Redis write seen
+  endToEnd: new Dist(), // MQTT publish -> Redis write seen
+  writerLag: null,
+};
+let windowCounts = { published: 0, acked: 0, brokerSeen: 0, kafkaSeen: 0, redisSeen: 0 };
+
+// `${slot_id}|${sent_at}` -> { pubMs, kafkaMs }
+const inflight = new Map();
+
+// ------------------------------------------------------------
+// Virtual nodes
+// ------------------------------------------------------------
+const expRand = (meanS) => -Math.log(1 - Math.random()) * meanS * 1000;
+const rateIntervalMs = RATE_BURST > 0 ? Math.max(1, Math.floor(RATE_WINDOW_MS / RATE_BURST)) : 0;
+
+class Node {
+  constructor(idx) {
+    this.idx = idx;
+    this.parkingId = PARKING_IDS[idx % PARKING_IDS.length];
+    const zone = this.parkingId.split(".").pop();
+    this.topic = `parking/${this.parkingId}/status`;
+    this.sensorId = `rain-sim-${idx}`;
+    this.batteryMv = 3300 + Math.floor(Math.random() * 900);
+    this.rainPct = Math.floor(Math.random() * 30);
+    this.outbox = [];
+    this.online = false;
+    this.down = false;
+    this.timers = new Set();
+    this.slots = [];
+    for (let k = 0; k < SLOTS_PER_NODE; k++) {
+      const occ = Math.random() < DWELL_S / (DWELL_S + VACANT_S);
+      this.slots.push({ id: `${zone}-S${String(idx).padStart(3, "0")}-${k + 1}`, occ, pubOcc: occ, tat: 0, held: false });
+    }
+  }
+
+  later(ms, fn) {
+    const t = setTimeout(() => {
+      this.timers.delete(t);
+      fn();
+    }, ms);
+    this.timers.add(t);
+  }
+
+  connect() {
+    this.client = mqtt.connect(mqttUrl, {
+      clientId: `fleet-sim-${process.pid}-${this.idx}`,
+      keepalive: 30,
+      reconnectPeriod: 5000,
+      clean: true,
+    });
+    this.client.on("connect", () => {
+      this.online = true;
+      this.drain();
+    });
+    this.client.on("close", () => {
+      this.online = false;
+    });
+    this.client.on("error", () => {});
+  }
+
+  start() {
+    this.connect();
+    for (const s of this.slots) this.scheduleTransition(s);
+    if (RAIN_EVERY_S > 0) this.later(Math.random() * RAIN_EVERY_S * 1000, () => this.rainTick());
+  }
+
+  // ---- arrival / departure process ----
+  scheduleTransition(s) {
+    this.later(expRand(s.occ ? DWELL_S : VACANT_S), () => {
+      this.flip(s);
+      if (Math.random() < FLAP_PROB) {
+        for (let i = 1; i <= FLAP_TOGGLES; i++) this.later(i * FLAP_GAP_MS, () => this.flip(s));
+      }
+      this.scheduleTransition(s);
+    });
+  }
+
+  flip(s) {
+    s.occ = !s.occ;
+    this.decide(s);
+  }
+
+  // ---- occupancy_publish_decide(): per-slot token bucket, held changes coalesce ----
+  decide(s) {
+    const now = Date.now();
+    if (s.occ === s.pubOcc) {
+      if (s.held) {
+        s.held = false;
+        stats.coalesced += 2;
+      }
+      return;
+    }
+    if (rateIntervalMs > 0) {
+      const ready = s.tat - (RATE_BURST - 1) * rateIntervalMs;
+      if (now < ready) {
+        if (!s.held) {
+          s.held = true;
+          stats.held++;
+          this.later(ready - now, () => {
+            if (s.held) {
+              s.held = false;
+              this.decide(s);
+            }
+          });
+        }
+        return;
+      }
+      s.tat = Math.max(s.tat, now) + rateIntervalMs;
+    }
+    s.pubOcc = s.occ;
+    this.emit({ slot_id: s.id, occupied: s.occ, sent_at: new Date(now).toISOString() });
+  }
+
+  // ---- publish_spot() or the outbox while offline ----
+  emit(ev) {
+    if (!this.online || this.outbox.length > 0) {
+      if (this.outbox.length >= OUTBOX_CAPACITY) {
+        this.outbox.shift(); // firmware: full, dropping oldest
+        stats.outboxDropped++;
+      }
+      this.outbox.push(ev);
+      stats.outboxed++;
+      return;
+    }
+    this.publishSpot(ev);
+  }
+
+  publishSpot(ev) {
+    const body = { parking_id: this.parkingId, slot_id: ev.slot_id, occupied: ev.occupied, battery_mv: this.batteryMv, sent_at: ev.sent_at, sync_age_s: 60 };
+    const payload = WIRE === "binary" ? wire.encodeSpot({ ...body, parking_id: undefined }) : JSON.stringify(body);
+    const pubMs = Date.now();
+    inflight.set(`${ev.slot_id}|${ev.sent_at}`, { pubMs, kafkaMs: null });
+    stats.published++;
+    windowCounts.published++;
+    this.client.publish(this.topic, payload, { qos: 1, retain: true }, (err) => {
+      if (err) {
+        stats.publishErrors++;
+        return;
+      }
+      stats.acked++;
+      windowCounts.acked++;
+      stats.puback.add(Date.now() - pubMs);
+    });
+  }
+
+  drain() {
+    if (!this.online || this.outbox.length === 0) return;
+    for (const ev of this.outbox.splice(0, OUTBOX_DRAIN_BURST)) this.publishSpot(ev);
+    if (this.outbox.length > 0) this.later(OUTBOX_DRAIN_EVERY_MS, () => this.drain());
+  }
+
+  // ---- publish_rain01_as_rain_pct(): random walk, hysteresis 5 % ----
+  rainTick() {
+    const next = Math.max(0, Math.min(100, this.rainPct + Math.round((Math.random() - 0.5) * 20)));
+    if (Math.abs(next - this.rainPct) >= 5 && this.online) {
+      this.rainPct = next;
+      const ev = { sensor_id: this.sensorId, rain_pct: next, raw: 3500 - next * 23, sent_at: new Date().toISOString(), sync_age_s: 60 };
+      const payload = WIRE === "binary" ? wire.encodeRain(ev) : JSON.stringify(ev);
+      this.client.publish("parking/rain", payload, { qos: 1, retain: true });
+      stats.rain++;
+    }
+    this.later(RAIN_EVERY_S * 1000 * (0.5 + Math.random()), () => this.rainTick());
+  }
+
+  // ---- reconnect storm: the link drops without a DISCONNECT ----
+  drop() {
+    if (this.down) return;
+    this.down = true;
+    this.online = false;
+    this.client.end(true);
+  }
+
+  restore() {
+    if (!this.down) return;
+    this.down = false;
+    stats.reconnects++;
+    this.connect();
+  }
+
+  stop() {
+    for (const t of this.timers) clearTimeout(t);
+    this.timers.clear();
+    if (this.client) this.client.end(true);
+  }
+}
+
+// ------------------------------------------------------------
+// Observers: broker, Kafka, Redis
+// ------------------------------------------------------------
+// Also keeps the retained parking/rain found at start: that topic is shared
+// with the real sensors, so cleanup puts it back instead of clearing it.
+function startBrokerMonitor() {
+  const mon = mqtt.connect(mqttUrl, { clientId: `fleet-sim-${process.pid}-monitor` });
+  mon.prevRain = null;
+  mon.on("connect", () => mon.subscribe([...PARKING_IDS.map((p) => `parking/${p}/status`), "parking/rain"], { qos: 0 }));
+  mon.on("message", (topic, payload, packet) => {
+    if (topic === "parking/rain") {
+      if (packet.retain && mon.prevRain === null) mon.prevRain = Buffer.from(payload);
+      return;
+    }
+    if (packet.retain) return;
+    stats.brokerSeen++;
+    windowCounts.brokerSeen++;
+  });
+  return mon;
+}
+
+function decodeValue(buf) {
+  if (wire.isBinary(buf)) return wire.decode(buf)?.value ?? null;
+  try {
+    return JSON.parse(buf.toString());
+  } catch {
+    return null;
+  }
+}
+
+async function startKafka(state) {
+  const kafka = new Kafka({ clientId: "fleet-sim", brokers: kafkaBrokers, logLevel: logLevel.WARN });
+  const admin = kafka.admin();
+  await admin.connect();
+  state.admin = admin;
+  // kafka-init creates the sim topics in the compose stack; this covers other
+  // brokers (auto-creation is off, and the bridge cannot produce without them).
+  await admin.createTopics({ topics: KAFKA_TOPICS.map((topic) => ({ topic, numPartitions: 3 })) });
+
+  const consumer = kafka.consumer({ groupId: `fleet-sim-${process.pid}` });
+  state.consumer = consumer;
+  await consumer.connect();
+  await consumer.subscribe({ topics: KAFKA_TOPICS, fromBeginning: false });
+  await consumer.run({
+    eachMessage: async ({ message }) => {
+      const ev = message.value ? decodeValue(message.value) : null;
+      const entry = ev && inflight.get(`${ev.slot_id}|${ev.sent_at}`);
+      if (!entry || entry.kafkaMs !== null) return;
+      entry.kafkaMs = Number(message.timestamp);
+      stats.kafkaSeen++;
+      windowCounts.kafkaSeen++;
+      stats.bridge.add(entry.kafkaMs - entry.pubMs);
+    },
+  });
+}
+
+// parking-redis-writer lag: end offsets - committed offsets, all partitions.
+async function writerLag(admin) {
+  let lag = 0;
+  for (const topic of KAFKA_TOPICS) {
+    const ends = await admin.fetchTopicOffsets(topic);
+    const [committed] = await admin.fetchOffsets({ groupId: WRITER_GROUP, topics: [topic] });
+    for (const p of ends) {
+      const c = committed?.partitions.find((x) => x.partition === p.partition);
+      const done = c && Number(c.offset) >= 0 ? Number(c.offset) : Number(p.low);
+      lag += Number(p.high) - done;
+    }
+  }
+  return lag;
+}
+
+async function startRedis(state) {
+  const redis = new Redis({ host: redisHost, port: redisPort });
+  const sub = new Redis({ host: redisHost, port: redisPort });
+  // Keyspace events for hashes. teardown() restores the previous value as
+  // soon as it is recorded here, whatever fails later.
+  const [, prevNotify] = await redis.config("GET", "notify-keyspace-events");
+  const prevRain = await redis.get("weather:rain");
+  state.r = { redis, sub, prevNotify: prevNotify || "", prevRain };
+  await redis.config("SET", "notify-keyspace-events", `${prevNotify || ""}Kh`);
+
+  await sub.psubscribe("__keyspace@*__:spot:*-S*");
+  sub.on("pmessage", async (_pattern, channel, op) => {
+    if (op !== "hset") return;
+    const key = channel.slice(channel.indexOf(":") + 1);
+    const now = Date.now();
+    const sentAt = await redis.hget(key, "sent_at");
+    const entry = inflight.get(`${key.slice("spot:".length)}|${sentAt}`);
+    if (!entry) return;
+    inflight.delete(`${key.slice("spot:".length)}|${sentAt}`);
+    stats.redisSeen++;
+    windowCounts.redisSeen++;
+    stats.endToEnd.add(now - entry.pubMs);
+    if (entry.kafkaMs !== null) stats.toRedis.add(now - entry.kafkaMs);
+  });
+}
+
+// ------------------------------------------------------------
+// Report
+// ------------------------------------------------------------
+const fmt = (d) => (d.n ? `p50 ${d.p50_ms} p90 ${d.p90_ms} p99 ${d.p99_ms} max ${d.max_ms} ms (n=${d.n})` : "-");
+
+function report(elapsedS) {
+  const w = windowCounts;
+  windowCounts = { published: 0, acked: 0, brokerSeen: 0, kafkaSeen: 0, redisSeen: 0 };
+  const rate = (n) => (n / REPORT_EVERY_S).toFixed(1);
+  console.log(
+    `[sim] t=${elapsedS}s  pub ${rate(w.published)}/s  ack ${rate(w.acked)}/s  broker ${rate(w.brokerSeen)}/s  ` +
+      `kafka ${rate(w.kafkaSeen)}/s  redis ${rate(w.redisSeen)}/s  inflight ${inflight.size}  ` +
+      `writer lag ${stats.writerLag ?? "?"}  outbox +${stats.outboxed} -${stats.outboxDropped}`
+  );
+  console.log(`[sim]   puback ${fmt(stats.puback.take())}`);
+  console.log(`[sim]   mqtt->kafka ${fmt(stats.bridge.take())}`);
+  console.log(`[sim]   kafka->redis ${fmt(stats.toRedis.take())}`);
+  console.log(`[sim]   end-to-end ${fmt(stats.endToEnd.take())}`);
+}
+
+function summary(elapsedS) {
+  return {
+    nodes: NODES,
+    slots: NODES * SLOTS_PER_NODE,
+    wire: WIRE,
+    duration_s: elapsedS,
+    spot_events: stats.published,
+    rain_events: stats.rain,
+    publish_rate: +(stats.published / elapsedS).toFixed(1),
+    acked: stats.acked,
+    publish_errors: stats.publishErrors,
+    rate_limit: { held: stats.held, coalesced: stats.coalesced },
+    outbox: { queued: stats.outboxed, dropped: stats.outboxDropped },
+    reconnects: stats.reconnects,
+    seen: { broker: stats.brokerSeen, kafka: stats.kafkaSeen, redis: stats.redisSeen },
+    lost_before_kafka: stats.published - stats.kafkaSeen,
+    lost_before_redis: stats.published - stats.redisSeen,
+    writer_lag: stats.writerLag,
+    puback: stats.puback.total(),
+    mqtt_to_kafka: stats.bridge.total(),
+    kafka_to_redis: stats.toRedis.total(),
+    end_to_end: stats.endToEnd.total(),
+  };
+}
+
+// Remove what the run left behind: sim spots in Redis, retained MQTT messages.
+// Only the sim parkings are cleared; parking/rain gets its previous retained value back.
+async function cleanup(nodes, r, mon) {
+  const pipe = r.redis.pipeline();
+  for (const n of nodes) {
+    const zone = n.parkingId.split(".").pop();
+    for (const s of n.slots) {
+      pipe.del(`spot:${s.id}`);
+      pipe.srem(`parking:${zone}:free`, s.id);
+    }
+  }
+  if (r.prevRain === null) pipe.del("weather:rain");
+  else pipe.set("weather:rain", r.prevRain);
+  await pipe.exec();
+  const retained = PARKING_IDS.map((p) => [`parking/${p}/status`, ""]);
+  if (stats.rain > 0) retained.push(["parking/rain", mon.prevRain ?? ""]);
+  await withTimeout(
+    Promise.all(retained.map(([topic, payload]) => new Promise((res) => mon.publish(topic, payload, { qos: 1, retain: true }, res)))),
+    5000
+  );
+  console.log("[sim] Cleanup done: sim spots removed from Redis, retained messages restored");
+}
+
+const sleep = (ms) => new Promise((res) => setTimeout(res, ms));
+const withTimeout = (p, ms) => Promise.race([p, sleep(ms)]);
+
+// Everything the run holds, so teardown() can undo it from any point:
+// normal end, fatal error or SIGINT / SIGTERM.
+const state = { nodes: [], timers: [], mon: null, admin: null, consumer: null, r: null };
+let tearingDown = null;
+
+function teardown() {
+  if (tearingDown) return tearingDown;
+  const step = async (what, fn) => {
+    try {
+      await withTimeout(fn(), 10000);
+    } catch (err) {
+      console.error(`[sim] Teardown: ${what} failed:`, err?.message || err);
+    }
+  };
+  tearingDown = (async () => {
+    state.timers.forEach((t) => clearInterval(t));
+    state.nodes.forEach((n) => n.stop());
+    const { r, mon } = state;
+    if (r) await step("notify-keyspace-events", () => r.redis.config("SET", "notify-keyspace-events", r.prevNotify));
+    if (CLEANUP && r && mon) await step("cleanup", () => cleanup(state.nodes, r, mon));
+    if (state.consumer) await step("Kafka consumer", () => state.consumer.disconnect());
+    if (state.admin) await step("Kafka admin", () => state.admin.disconnect());
+    if (r) {
+      r.sub.disconnect();
+      r.redis.disconnect();
+    }
+    if (mon) mon.end(true);
+  })();
+  return tearingDown;
+}
+
+async function run() {
+  const perSlotRate = 2 / (VACANT_S + DWELL_S);
+  console.log(
+    `[sim] ${NODES} nodes x ${SLOTS_PER_NODE} slots on ${PARKING_IDS.join(",")}, ~${(NODES * SLOTS_PER_NODE * perSlotRate).toFixed(1)} transitions/s ` +
+      `(+ flapping), ${WIRE}, ${DURATION_S}s`
+  );
+
+  state.mon = startBrokerMonitor();
+  await startKafka(state);
+  await startRedis(state);
+  await sleep(3000); // consumer group join
+
+  const nodes = Array.from({ length: NODES }, (_, i) => new Node(i));
+  state.nodes = nodes;
+  nodes.forEach((n) => n.start());
+
+  const t0 = Date.now();
+  const elapsed = () => Math.round((Date.now() - t0) / 1000);
+  const lagTimer = setInterval(async () => {
+    try {
+      stats.writerLag = await writerLag(state.admin);
+    } catch (e) {
+      stats.writerLag = null;
+    }
+  }, 2000);
+  const reportTimer = setInterval(() => report(elapsed()), REPORT_EVERY_S * 1000);
+  const stormTimer =
+    STORM_EVERY_S > 0
+      ? setInterval(() => {
+          const victims = nodes.filter(() => Math.random() < STORM_FRACTION);
+          console.log(`[sim] Reconnect storm: ${victims.length} node(s) down for ${STORM_DOWN_S}s`);
+          victims.forEach((n) => n.drop());
+          setTimeout(() => victims.forEach((n) => n.restore()), STORM_DOWN_S * 1000);
+        }, STORM_EVERY_S * 1000)
+      : null;
+  state.timers.push(lagTimer, reportTimer, stormTimer);
+
+  await sleep(DURATION_S * 1000);
+  if (stormTimer) clearInterval(stormTimer);
+  nodes.forEach((n) => n.restore()); // storm victims still down: let their outbox drain
+  const publishing = Date.now();
+  while (nodes.some((n) => n.outbox.length > 0) && Date.now() - publishing < DRAIN_S * 1000) await sleep(250);
+  nodes.forEach((n) => n.stop());
+
+  const drainUntil = Date.now() + DRAIN_S * 1000;
+  while (stats.redisSeen < stats.published && Date.now() < drainUntil) await sleep(500);
+  clearInterval(reportTimer);
+  clearInterval(lagTimer);
+  stats.writerLag = await writerLag(state.admin).catch(() => null);
+
+  const result = summary(elapsed());
+  console.log(JSON.stringify(result, null, 2));
+}
+
+for (const [sig, code] of [["SIGINT", 130], ["SIGTERM", 143]]) {
+  process.on(sig, () => {
+    if (tearingDown) return;
+    console.log(`[sim] ${sig}: restoring Redis and MQTT state before exit`);
+    teardown().finally(() => process.exit(code));
+  });
+}
+
+async function main() {
+  let code = 0;
+  try {
+    await run();
+  } catch (err) {
+    console.error("[sim] Fatal error:", err?.message || err);
+    code = 1;
+  } finally {
+    await teardown();
+  }
+  process.exit(code);
+}
+
+main();
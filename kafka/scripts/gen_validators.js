@@ -0,0 +1,138 @@
+#!/usr/bin/env node
+/**
+ * Compile kafka/schemas/*.json into plain JS validator functions.
+ *
+ *   node kafka/scripts/gen_validators.js           # writes mqtt-kafka-bridge/validators.js
+ *   node kafka/scripts/gen_validators.js --check   # exit 1 if validators.js is stale
+ *
+ * The output has no dependency (each service is its own Docker build context,
+ * so the schemas cannot be read at run time) and does one straight-line check
+ * per property, with no schema walk per message. Only the keywords the
+ * schemas use are supported; anything else stops the generator, so a schema
+ * change can never be silently ignored.
+ */
+
+const fs = require("fs");
+const path = require("path");
+
+const ROOT = path.resolve(__dirname, "..", "..");
+const SCHEMA_DIR = path.join(ROOT, "kafka", "schemas");
+const OUT = path.join(ROOT, "mqtt-kafka-bridge", "validators.js");
+
+const ANNOTATIONS = new Set(["$id", "$schema", "$comment", "title", "description"]);
+const OBJECT_KEYWORDS = new Set(["type", "required", "properties", "additionalProperties"]);
+const VALUE_KEYWORDS = new Set(["type", "minimum", "maximum", "minLength", "format"]);
+const TYPE_CHECKS = {
+  string: (x) => `typeof ${x} !== "string"`,
+  boolean: (x) => `typeof ${x} !== "boolean"`,
+  integer: (x) => `!Number.isInteger(${x})`,
+  number: (x) => `typeof ${x} !== "number" || !Number.isFinite(${x})`,
+};
+const FORMATS = new Set(["date-time"]);
+
+function fail(file, msg) {
+  throw new Error(`${path.basename(file)}: ${msg}`);
+}
+
+function checkKeywords(file, where, schema, allowed) {
+  for (const k of Object.keys(schema)) {
+    if (!ANNOTATIONS.has(k) && !allowed.has(k)) fail(file, `unsupported keyword "${k}" at ${where}`);
+  }
+}
+
+function propertyChecks(file, name, schema) {
+  checkKeywords(file, name, schema, VALUE_KEYWORDS);
+  const x = `v[${JSON.stringify(name)}]`;
+  const lines = [];
+  const typeCheck = TYPE_CHECKS[schema.type];
+  if (!typeCheck) fail(file, `unsupported type "${schema.type}" for ${name}`);
+  lines.push(`if (${typeCheck(x)}) return "${name}: must be ${schema.type}";`);
+  if (schema.minimum !== undefined) lines.push(`if (${x} < ${schema.minimum}) return "${name}: must be >= ${schema.minimum}";`);
+  if (schema.maximum !== undefined) lines.push(`if (${x} > ${schema.maximum}) return "${name}: must be <= ${schema.maximum}";`);
+  if (schema.minLength !== undefined) {
+    lines.push(`if (${x}.length < ${schema.minLength}) return "${name}: must not be shorter than ${schema.minLength}";`);
+  }
+  if (schema.format !== undefined) {
+    if (!FORMATS.has(schema.format)) fail(file, `unsupported format "${schema.format}" for ${name}`);
+    lines.push(`if (!isDateTime(${x})) return "${name}: must be a ${schema.format}";`);
+  }
+  return lines;
+}
+
+function compile(file) {
+  const schema = JSON.parse(fs.readFileSync(file, "utf8"));
+  checkKeywords(file, "root", schema, OBJECT_KEYWORDS);
+  if (schema.type !== "object") fail(file, "root must be an object schema");
+  if (!/^[A-Z][A-Za-z0-9]*$/.test(schema.title || "")) fail(file, "title must be a type name");
+  if (![undefined, false].includes(schema.additionalProperties)) fail(file, "additionalProperties must be false or absent");
+
+  const props = schema.properties || {};
+  const required = schema.required || [];
+  for (const r of required) if (!props[r]) fail(file, `required "${r}" has no property schema`);
+
+  const body = [`if (typeof v !== "object" || v === null || Array.isArray(v)) return "not an object";`];
+  if (schema.additionalProperties === false) {
+    const known = Object.keys(props).map((p) => `case ${JSON.stringify(p)}:`).join(" ");
+    body.push(`for (const k in v) {`, `  switch (k) {`, `    ${known}`, `      break;`,
+      `    default:`, "      return `${k}: not allowed`;", `  }`, `}`);
+  }
+  // An undefined property is treated as absent, as JSON.stringify does.
+  for (const [name, ps] of Object.entries(props)) {
+    const checks = propertyChecks(file, name, ps);
+    const x = `v[${JSON.stringify(name)}]`;
+    if (required.includes(name)) {
+      body.push(`if (${x} === undefined) return "${name}: required";`, ...checks);
+    } else {
+      body.push(`if (${x} !== undefined) {`, ...checks.map((l) => `  ${l}`), `}`);
+    }
+  }
+  body.push(`return null;`);
+
+  const fn = `validate${schema.title}`;
+  return {
+    fn,
+    code: [
+      `// ${schema.title} (kafka/schemas/${path.basename(file)})`,
+      `function ${fn}(v) {`,
+      ...body.map((l) => `  ${l}`),
+      `}`,
+    ].join("\n"),
+  };
+}
+
+function generate() {
+  const files = fs.readdirSync(SCHEMA_DIR).filter((f) => f.endsWith(".json")).sort();
+  const compiled = files.map((f) => compile(path.join(SCHEMA_DIR, f)));
+  return [
+    `/**`,
+    ` * Validators for the Kafka event schemas. GENERATED from kafka/schemas/*.json`,
+    ` * by kafka/scripts/gen_validators.js: do not edit, re-run the script instead.`,
+    ` *`,
+    ` * Each function returns null when the object matches its schema, or a short`,
+    ` * reason ("slot_id: must be string") when it does not.`,
+    ` */`,
+    ``,
+    `const DATE_TIME = /^\\d{4}-\\d{2}-\\d{2}[Tt]\\d{2}:\\d{2}:\\d{2}(\\.\\d+)?([Zz]|[+-]\\d{2}:\\d{2})$/;`,
+    ``,
+    `function isDateTime(s) {`,
+    `  return typeof s === "string" && DATE_TIME.test(s) && Number.isFinite(Date.parse(s));`,
+    `}`,
+    ``,
+    ...compiled.map((c) => `${c.code}\n`),
+    `module.exports = { ${compiled.map((c) => c.fn).join(", ")} };`,
+    ``,
+  ].join("\n");
+}
+
+const out = generate();
+if (process.argv.includes("--check")) {
+  const current = fs.existsSync(OUT) ? fs.readFileSync(OUT, "utf8") : "";
+  if (current !== out) {
+    console.error(`${path.relative(ROOT, OUT)} is out of date: run node kafka/scripts/gen_validators.js`);
+    process.exit(1);
+  }
+  console.log(`${path.relative(ROOT, OUT)} is up to date`);
+} else {
+  fs.writeFileSync(OUT, out);
+  console.log(`wrote ${path.relative(ROOT, OUT)}`);
+}
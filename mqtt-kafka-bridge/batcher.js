@@ -0,0 +1,167 @@
+/**
+ * Producer pipeline: events are queued per topic and sent with one sendBatch()
+ * per flush instead of one producer.send() round trip per MQTT message.
+ *
+ * A flush starts when BATCH_MAX_MESSAGES or BATCH_MAX_BYTES are queued, or
+ * lingerMs after the first queued event. Only one batch is in flight at a
+ * time: what arrives during the round trip forms the next batch, so the batch
+ * size follows the load on its own.
+ *
+ * Order per key is kept across failures: a failed batch stays at the head of
+ * the queue and is retried before anything queued after it. After maxRetries
+ * failed attempts it is dropped (logged) so one poison batch cannot stall the
+ * bridge forever. KafkaJS retries each request on its own before that, and
+ * the idempotent producer makes those retries duplicate-free.
+ */
+
+class KafkaBatcher {
+  /**
+   * @param {object} producer  connected KafkaJS producer (idempotent)
+   * @param {object} [opts]
+   * @param {number} [opts.maxMessages]  flush threshold, events
+   * @param {number} [opts.maxBytes]     flush threshold, key + value bytes
+   * @param {number} [opts.lingerMs]     longest wait for more events before a flush
+   * @param {number} [opts.maxQueued]    events held while Kafka is down, newer ones are dropped
+   * @param {number} [opts.maxRetries]   attempts per batch before it is dropped
+   * @param {number} [opts.compression]  KafkaJS CompressionTypes value
+   */
+  constructor(producer, opts = {}) {
+    this.producer = producer;
+    this.maxMessages = opts.maxMessages || 1000;
+    this.maxBytes = opts.maxBytes || 1024 * 1024;
+    this.lingerMs = opts.lingerMs ?? 5;
+    this.maxQueued = opts.maxQueued || 200000;
+    this.maxRetries = opts.maxRetries || 5;
+    this.compression = opts.compression;
+
+    this.queue = new Map(); // topic -> [{ key, value, bytes }]
+    this.queued = 0;
+    this.queuedBytes = 0;
+    this.inflight = null; // { topicMessages, count, attempts }
+    this.timer = null;
+    this.idle = [];
+    this.resetStats();
+  }
+
+  resetStats() {
+    this.sent = 0;
+    this.batches = 0;
+    this.dropped = 0;
+    this.failed = 0;
+    this.sendMs = 0;
+  }
+
+  /**
+   * Queue one message. Returns false (and counts a drop) when the queue is full.
+   */
+  push(topic, key, value) {
+    if (this.queued >= this.maxQueued) {
+      if (this.dropped++ === 0) console.warn(`[bridge] Kafka queue full (${this.queued}), dropping events`);
+      return false;
+    }
+    let list = this.queue.get(topic);
+    if (!list) this.queue.set(topic, (list = []));
+    const bytes = (key ? Buffer.byteLength(key) : 0) + Buffer.byteLength(value);
+    list.push({ key, value, bytes });
+    this.queued++;
+    this.queuedBytes += bytes;
+
+    if (this.queued >= this.maxMessages || this.queuedBytes >= this.maxBytes) this.flush();
+    else if (!this.timer && !this.inflight) this.timer = setTimeout(() => this.flush(), this.lingerMs);
+    return true;
+  }
+
+  /**
+   * Start a batch now if none is in flight. The running batch triggers the next one when it completes.
+   * A batch takes at most maxMessages / maxBytes from the head of each topic, so a backlog built up
+   * while Kafka was away goes out in several requests of the usual size.
+   */
+  flush() {
+    if (this.timer) {
+      clearTimeout(this.timer);
+      this.timer = null;
+    }
+    if (this.inflight || this.queued === 0) return;
+
+    const topicMessages = [];
+    let count = 0;
+    let bytes = 0;
+    for (const [topic, list] of this.queue) {
+      let n = 0;
+      while (n < list.length && count < this.maxMessages && (count === 0 || bytes + list[n].bytes <= this.maxBytes)) {
+        bytes += list[n].bytes;
+        count++;
+        n++;
+      }
+      if (n === 0) break;
+      const messages = list.splice(0, n).map(({ key, value }) => ({ key, value }));
+      topicMessages.push({ topic, messages });
+      if (list.length === 0) this.queue.delete(topic);
+    }
+    this.inflight = { topicMessages, count, attempts: 0 };
+    this.queued -= count;
+    this.queuedBytes -= bytes;
+    this.sendInflight();
+  }
+
+  async sendInflight() {
+    const batch = this.inflight;
+    const t0 = Date.now();
+    try {
+      batch.attempts++;
+      await this.producer.sendBatch({ topicMessages: batch.topicMessages, acks: -1, compression: this.compression });
+      this.sent += batch.count;
+      this.batches++;
+      this.sendMs += Date.now() - t0;
+    } catch (e) {
+      if (batch.attempts < this.maxRetries) {
+        const waitMs = Math.min(200 * Math.pow(2, batch.attempts), 10000);
+        console.error(
+          `[bridge] Kafka batch of ${batch.count} failed (attempt ${batch.attempts}), retry in ${waitMs}ms:`,
+          e?.message || e
+        );
+        setTimeout(() => this.sendInflight(), waitMs);
+        return;
+      }
+      this.failed += batch.count;
+      console.error(`[bridge] Kafka batch of ${batch.count} dropped after ${batch.attempts} attempts:`, e?.message || e);
+    }
+
+    this.inflight = null;
+    if (this.queued > 0) this.flush();
+    else this.idle.splice(0).forEach((resolve) => resolve());
+  }
+
+  /**
+   * Resolves once everything queued so far has been sent (or dropped).
+   */
+  drain() {
+    this.flush();
+    if (!this.inflight && this.queued === 0) return Promise.resolve();
+    return new Promise((resolve) => this.idle.push(resolve));
+  }
+
+  /**
+   * { sent, batches, avg_batch, avg_send_ms, queued, dropped, failed } since the last resetStats().
+   */
+  stats() {
+    return {
+      sent: this.sent,
+      batches: this.batches,
+      avg_batch: this.batches ? Math.round(this.sent / this.batches) : 0,
+      avg_send_ms: this.batches ? Math.round(this.sendMs / this.batches) : 0,
+      queued: this.queued + (this.inflight ? this.inflight.count : 0),
+      dropped: this.dropped,
+      failed: this.failed,
+    };
+  }
+}
+
+function formatBatchStats(s, periodMs) {
+  return (
+    `${((s.sent * 1000) / periodMs).toFixed(1)} msg/s in ${s.batches} batches ` +
+    `(avg ${s.avg_batch} msg, ${s.avg_send_ms}ms), queued ${s.queued}, dropped ${s.dropped}, failed ${s.failed}`
+  );
+}
+
+module.exports = { KafkaBatcher, formatBatchStats };
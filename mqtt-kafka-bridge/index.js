@@ -1,11 +1,33 @@
 const mqtt = require("mqtt");
-const { Kafka, logLevel } = require("kafkajs");
+const { Kafka, logLevel, CompressionTypes } = require("kafkajs");
+const wire = require("@optipark/shared/wire");
+const { LatencyWindow, formatStats } = require("@optipark/shared/latency");
+const { KafkaBatcher, formatBatchStats } = require("./batcher");
+const { validateMagneticRawEvent, validateRainEvent } = require("./validators");
 
 const mqttUrl = process.env.MQTT_URL || "mqtt://mosquitto:1883";
 const kafkaBrokers = (process.env.KAFKA_BROKERS || "kafka:9092").split(",");
-
-// Allowed parking IDs (must match your Kafka topics)
-const ALLOWED_PARKING_IDS = new Set(["nice_sophia.A", "nice_sophia.B", "nice_sophia.C"]);
+// Kafka value encoding: "json" (default, compatible) or "binary" (kafka/schemas/wire-format-v2.md)
+const kafkaValueFormat = (process.env.KAFKA_VALUE_FORMAT || "json").toLowerCase();
+// Sensor -> bridge latency log period (0 = off) and the oldest device SNTP sync trusted for it
+const latencyReportMs = parseInt(process.env.LATENCY_REPORT_MS || "60000", 10);
+const latencyMaxSyncAgeS = parseInt(process.env.LATENCY_MAX_SYNC_AGE_S || "3600", 10);
+// Producer batching (see batcher.js): flush thresholds, linger and compression ("gzip" or "none")
+const batchMaxMessages = parseInt(process.env.KAFKA_BATCH_MAX_MESSAGES || "1000", 10);
+const batchMaxBytes = parseInt(process.env.KAFKA_BATCH_MAX_BYTES || "1048576", 10);
+const batchLingerMs = parseInt(process.env.KAFKA_LINGER_MS || "5", 10);
+const kafkaCompression = (process.env.KAFKA_COMPRESSION || "gzip").toLowerCase();
+// One log line per MQTT message; off by default, it costs more than the rest of the bridge under load
+const logMessages = process.env.LOG_MESSAGES === "1";
+
+// Allowed parking IDs (must match your Kafka topics). EXTRA_PARKING_IDS adds more,
+// e.g. the fleet simulator's own parkings (comma-separated).
+const ALLOWED_PARKING_IDS = new Set([
+  "nice_sophia.A",
+  "nice_sophia.B",
+  "nice_sophia.C",
+  ...(process.env.EXTRA_PARKING_IDS || "").split(",").map((p) => p.trim()).filter(Boolean),
+]);
 
 const kafka = new Kafka({
   clientId: "mqtt-kafka-bridge",
@@ -16,7 +38,25 @@ const kafka = new Kafka({
   requestTimeout: 30000,
 });
 
-const producer = kafka.producer();
+// Idempotent: KafkaJS retries cannot duplicate or reorder a batch (acks=all, one request in flight).
+const producer = kafka.producer({ idempotent: true, maxInFlightRequests: 1 });
+const batcher = new KafkaBatcher(producer, {
+  maxMessages: batchMaxMessages,
+  maxBytes: batchMaxBytes,
+  lingerMs: batchLingerMs,
+  compression: kafkaCompression === "none" ? CompressionTypes.None : CompressionTypes.GZIP,
+});
+const latency = new LatencyWindow({ maxSyncAgeS: latencyMaxSyncAgeS });
+
+/**
+ * Copy the device time fields (sent_at, sync_age_s, or ts_ms uptime before the first SNTP sync) of src into ev.
+ */
+function copyDeviceTime(ev, src) {
+  if (typeof src?.sent_at === "string") ev.sent_at = src.sent_at;
+  if (Number.isInteger(src?.sync_age_s) && src.sync_age_s >= 0) ev.sync_age_s = src.sync_age_s;
+  if (Number.isInteger(src?.ts_ms) && src.ts_ms >= 0) ev.ts_ms = src.ts_ms;
+  return ev;
+}
 
 /**
  * Safe JSON parse
@@ -30,10 +70,9 @@ function safeJsonParse(str) {
 }
 
 /**
- * Extract parking_id either from JSON payload or topic parking/<parking_id>/status
+ * Extract parking_id either from the parsed JSON payload or topic parking/<parking_id>/status
  */
-function deriveParkingId(mqttTopic, payloadStr) {
-  const parsed = safeJsonParse(payloadStr);
+function deriveParkingId(mqttTopic, parsed) {
   if (parsed && typeof parsed.parking_id === "string") return parsed.parking_id;
 
   const parts = mqttTopic.split("/");
@@ -79,6 +118,94 @@ function parseRainPayload(value) {
   return obj;
 }
 
+/**
+ * Snapshot/delta mode (ESP32 SPOT_PUBLISH_SNAPSHOT):
+ * - parking/<id>/snapshot (retained): {"parking_id","seq","slots":[...],"occ":"<hex>"}
+ * - parking/<id>/delta: {"seq","occ":"<hex>","chg":"<hex>"}
+ * (plus sent_at / sync_age_s once the device clock is synced)
+ * Bit i of the bitmaps is slots[i]. Both are expanded here into one
+ * MagneticRawEvent per changed slot, so Kafka consumers are unchanged.
+ */
+const spotState = new Map(); // parking_id -> { slots, occ: BigInt, seq }
+
+function parkingIdFromTopic(mqttTopic) {
+  const parts = mqttTopic.split("/");
+  return parts.length >= 3 && parts[0] === "parking" ? parts[1] : null;
+}
+
+function parseBitmap(hex) {
+  if (typeof hex !== "string" || !/^[0-9a-fA-F]{1,16}$/.test(hex)) return null;
+  return BigInt(`0x${hex}`);
+}
+
+function expandBitmap(parkingId, slots, occ, mask, msg) {
+  const events = [];
+  for (let i = 0; i < slots.length; i++) {
+    const bit = 1n << BigInt(i);
+    if (!(mask & bit)) continue;
+    const ev = { parking_id: parkingId, slot_id: slots[i], occupied: (occ & bit) !== 0n };
+    if (Number.isInteger(msg.battery_mv) && msg.battery_mv >= 0) ev.battery_mv = msg.battery_mv;
+    events.push(copyDeviceTime(ev, msg));
+  }
+  return events;
+}
+
+/**
+ * Returns the per-slot events implied by a snapshot/delta message, or null if it must be dropped.
+ */
+function expandSpotAggregate(parkingId, kind, msg) {
+  const occ = parseBitmap(msg?.occ);
+  if (occ === null || !Number.isInteger(msg?.seq)) return null;
+
+  const prev = spotState.get(parkingId);
+
+  if (kind === "snapshot") {
+    if (!Array.isArray(msg.slots) || !msg.slots.every((s) => typeof s === "string")) return null;
+    // Only forward what differs from what we already know (everything on first sight).
+    const sameSlots = prev && prev.slots.join(",") === msg.slots.join(",");
+    const mask = sameSlots ? occ ^ prev.occ : (1n << BigInt(msg.slots.length)) - 1n;
+    spotState.set(parkingId, { slots: msg.slots, occ, seq: msg.seq });
+    return expandBitmap(parkingId, msg.slots, occ, mask, msg);
+  }
+
+  // delta
+  if (!prev) {
+    console.warn(`[bridge] Delta for ${parkingId} before any snapshot. Dropping.`);
+    return [];
+  }
+  const chg = parseBitmap(msg.chg) ?? 0n;
+  let mask = chg;
+  if (msg.seq !== prev.seq + 1) {
+    // Missed deltas: occ is authoritative, resync every slot that differs.
+    console.warn(`[bridge] ${parkingId} delta seq gap ${prev.seq} -> ${msg.seq}, resyncing from bitmap`);
+    mask |= occ ^ prev.occ;
+  }
+  spotState.set(parkingId, { slots: prev.slots, occ, seq: msg.seq });
+  return expandBitmap(parkingId, prev.slots, occ, mask, msg);
+}
+
+/**
+ * A per-slot event from a snapshot-mode board (outbox backfill) updates the cached bitmap,
+ * so the next snapshot does not emit the same change again.
+ */
+function noteSpotEvent(parkingId, slotId, occupied) {
+  const st = spotState.get(parkingId);
+  const i = st ? st.slots.indexOf(slotId) : -1;
+  if (i < 0) return;
+  const bit = 1n << BigInt(i);
+  st.occ = occupied ? st.occ | bit : st.occ & ~bit;
+}
+
+/**
+ * Encode a normalized event for Kafka according to KAFKA_VALUE_FORMAT.
+ */
+function kafkaValue(type, obj) {
+  if (kafkaValueFormat === "binary") {
+    return type === "rain" ? wire.encodeRain(obj) : wire.encodeSpot(obj);
+  }
+  return JSON.stringify(obj);
+}
+
 async function connectProducerWithRetry() {
   let attempt = 0;
   while (true) {
@@ -110,12 +237,13 @@ async function run() {
     if (subscribed || !producerReady) return;
     subscribed = true;
 
-    client.subscribe(["parking/+/status", "parking/rain"], { qos: 1 }, (err) => {
+    const topics = ["parking/+/status", "parking/+/snapshot", "parking/+/delta", "parking/rain"];
+    client.subscribe(topics, { qos: 1 }, (err) => {
       if (err) {
         subscribed = false;
         console.error("[bridge] MQTT subscribe error:", err?.message || err);
       } else {
-        console.log("[bridge] MQTT subscribed to parking/+/status and parking/rain");
+        console.log(`[bridge] MQTT subscribed to ${topics.join(", ")}`);
       }
     });
   }
@@ -128,9 +256,18 @@ async function run() {
   client.on("reconnect", () => console.log("[bridge] MQTT reconnecting..."));
   client.on("error", (e) => console.error("[bridge] MQTT error:", e?.message || e));
 
-  client.on("message", async (topic, payload) => {
-    const value = payload.toString();
-    console.log("[bridge] MQTT", topic, value);
+  client.on("message", (topic, payload) => {
+    const receivedAt = Date.now();
+    // Binary payloads (wire format v1) are decoded once here; JSON goes through the legacy path.
+    const binary = wire.isBinary(payload);
+    const decoded = binary ? wire.decode(payload) : null;
+    const value = binary ? "" : payload.toString();
+    if (logMessages) console.log("[bridge] MQTT", topic, binary ? `<binary ${payload.length}B>` : value);
+
+    if (binary && !decoded) {
+      console.warn("[bridge] Unknown binary payload version/type. Dropping.");
+      return;
+    }
 
     if (!producerReady) {
       console.warn("[bridge] Kafka producer not ready yet. Dropping message.");
@@ -141,7 +278,7 @@ async function run() {
     // RAIN TOPIC
     // --------------------------
     if (topic === "parking/rain") {
-      const parsed = parseRainPayload(value);
+      const parsed = decoded ? decoded.value : parseRainPayload(value);
 
       // Empty retained (-r -n) or invalid => ignore (no error spam)
       if (!parsed) {
@@ -149,30 +286,58 @@ async function run() {
         return;
       }
 
-      // Validate fields
-      const sensorIdOk = typeof parsed.sensor_id === "string" && parsed.sensor_id.length > 0;
-      const rainPctOk = typeof parsed.rain_pct === "number" && Number.isFinite(parsed.rain_pct);
+      // Normalize (legacy payloads may send a fractional rain_pct), then check against rain-event.json
+      const pct = parsed.rain_pct;
+      const rain = copyDeviceTime(
+        {
+          sensor_id: parsed.sensor_id,
+          rain_pct: Number.isFinite(pct) ? Math.max(0, Math.min(100, Math.trunc(pct))) : pct,
+          raw: parsed.raw,
+        },
+        parsed
+      );
+      rain.received_at = new Date(receivedAt).toISOString();
+      const err = validateRainEvent(rain);
+      if (err) {
+        console.warn(`[bridge] Invalid rain event (${err}). Dropping.`);
+        return;
+      }
+
+      latency.record(rain, receivedAt);
+      batcher.push("rain.global", "rain", kafkaValue("rain", rain));
+      return;
+    }
 
-      if (!sensorIdOk || !rainPctOk) {
-        console.warn("[bridge] Invalid rain fields. Dropping.", parsed);
+    // --------------------------
+    // SPOT SNAPSHOT / DELTA TOPICS
+    // --------------------------
+    const kind = topic.endsWith("/snapshot") ? "snapshot" : topic.endsWith("/delta") ? "delta" : null;
+    if (kind) {
+      const aggParkingId = parkingIdFromTopic(topic);
+      if (!aggParkingId || !ALLOWED_PARKING_IDS.has(aggParkingId)) {
+        console.warn(`[bridge] parking_id=${aggParkingId} not allowed. Dropping ${kind}.`);
         return;
       }
 
-      // Normalize to strict JSON (always)
-      const normalized = JSON.stringify({
-        sensor_id: parsed.sensor_id,
-        rain_pct: Math.max(0, Math.min(100, Math.trunc(parsed.rain_pct))),
-        raw: typeof parsed.raw === "number" ? parsed.raw : undefined,
-      });
-
-      try {
-        console.log("[bridge] Producing rain to Kafka topic=rain.global");
-        await producer.send({
-          topic: "rain.global",
-          messages: [{ key: "rain", value: normalized }],
-        });
-      } catch (e) {
-        console.error("[bridge] Kafka send error (rain):", e?.message || e);
+      const msg = kind === "delta" && decoded ? decoded.value : safeJsonParse(value);
+      const events = expandSpotAggregate(aggParkingId, kind, msg);
+      if (!events) {
+        console.warn(`[bridge] Invalid ${kind} payload. Dropping.`);
+        return;
+      }
+      if (events.length === 0) return;
+      // One sample per message: the expanded events share its timestamp.
+      latency.record(msg, receivedAt);
+
+      const targetTopic = `parking.${aggParkingId}`;
+      const key = `parking/${aggParkingId}/status`;
+      const receivedIso = new Date(receivedAt).toISOString();
+      if (logMessages) console.log(`[bridge] ${events.length} event(s) from ${kind} for ${targetTopic}`);
+      for (const e of events) {
+        e.received_at = receivedIso;
+        const err = validateMagneticRawEvent(e);
+        if (err) console.warn(`[bridge] Invalid event for ${e.slot_id} from ${kind} (${err}). Dropping.`);
+        else batcher.push(targetTopic, key, kafkaValue("spot", e));
       }
       return;
     }
@@ -180,7 +345,11 @@ async function run() {
     // --------------------------
     // SPOT STATUS TOPICS
     // --------------------------
-    const parkingId = deriveParkingId(topic, value);
+    if (payload.length === 0) return; // retained message cleared (snapshot-mode boards do it on connect)
+
+    // Parsed once: the same object gives parking_id and becomes the Kafka event.
+    const spotParsed = decoded ? decoded.value : safeJsonParse(value);
+    const parkingId = decoded ? parkingIdFromTopic(topic) : deriveParkingId(topic, spotParsed);
     if (!parkingId) {
       console.warn("[bridge] Cannot derive parking_id. Dropping message.");
       return;
@@ -191,26 +360,53 @@ async function run() {
       return;
     }
 
-    // Optional: drop non-JSON spot payloads early to avoid downstream parse failures
-    // (You can remove this if you intentionally accept legacy spot payloads)
-    const spotParsed = safeJsonParse(value);
-    if (!spotParsed) {
-      console.warn("[bridge] Spot payload is not valid JSON. Dropping.");
+    // The parsed payload is the Kafka event: completed here, checked against magnetic-raw-event.json
+    // (unknown fields included), then encoded as is.
+    if (!spotParsed || (decoded && decoded.type !== "spot")) {
+      console.warn("[bridge] Spot payload is not valid JSON or binary spot event. Dropping.");
+      return;
+    }
+    if (typeof spotParsed.parking_id !== "string") spotParsed.parking_id = parkingId;
+    spotParsed.received_at = new Date(receivedAt).toISOString();
+    const err = validateMagneticRawEvent(spotParsed);
+    if (err) {
+      console.warn(`[bridge] Invalid spot event (${err}). Dropping.`);
       return;
     }
+    latency.record(spotParsed, receivedAt);
+    noteSpotEvent(parkingId, spotParsed.slot_id, spotParsed.occupied);
 
-    const targetTopic = `parking.${parkingId}`;
+    batcher.push(`parking.${parkingId}`, topic, kafkaValue("spot", spotParsed));
+  });
 
-    try {
-      console.log(`[bridge] Producing to Kafka topic=${targetTopic}`);
-      await producer.send({
-        topic: targetTopic,
-        messages: [{ key: topic, value: JSON.stringify(spotParsed) }],
-      });
-    } catch (e) {
-      console.error("[bridge] Kafka send error:", e?.message || e);
+  if (latencyReportMs > 0) {
+    setInterval(() => {
+      const s = latency.stats();
+      if (s) console.log(`[bridge] sensor->bridge latency ${formatStats(s)}`);
+      latency.reset();
+      const b = batcher.stats();
+      if (b.sent || b.queued || b.dropped || b.failed) {
+        console.log(`[bridge] kafka ${formatBatchStats(b, latencyReportMs)}`);
+      }
+      batcher.resetStats();
+    }, latencyReportMs);
+  }
+
+  // Stop taking MQTT messages, then send what is still queued before exiting.
+  let stopping = false;
+  const shutdown = async (signal) => {
+    if (stopping) return;
+    stopping = true;
+    console.log(`[bridge] ${signal}, flushing ${batcher.stats().queued} queued event(s)`);
+    client.end(true);
+    if (producerReady) {
+      await Promise.race([batcher.drain(), new Promise((r) => setTimeout(r, 10000))]);
+      await producer.disconnect().catch(() => {});
     }
-  });
+    process.exit(0);
+  };
+  process.on("SIGTERM", () => shutdown("SIGTERM"));
+  process.on("SIGINT", () => shutdown("SIGINT"));
 
   // Connect Kafka producer (after handlers are ready)
   await connectProducerWithRetry();
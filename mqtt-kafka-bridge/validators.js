@@ -0,0 +1,98 @@
+/**
+ * Validators for the Kafka event schemas. GENERATED from kafka/schemas/*.json
+ * by kafka/scripts/gen_validators.js: do not edit, re-run the script instead.
+ *
+ * Each function returns null when the object matches its schema, or a short
+ * reason ("slot_id: must be string") when it does not.
+ */
+
+const DATE_TIME = /^\d{4}-\d{2}-\d{2}[Tt]\d{2}:\d{2}:\d{2}(\.\d+)?([Zz]|[+-]\d{2}:\d{2})$/;
+
+function isDateTime(s) {
+  return typeof s === "string" && DATE_TIME.test(s) && Number.isFinite(Date.parse(s));
+}
+
+// MagneticRawEvent (kafka/schemas/magnetic-raw-event.json)
+function validateMagneticRawEvent(v) {
+  if (typeof v !== "object" || v === null || Array.isArray(v)) return "not an object";
+  for (const k in v) {
+    switch (k) {
+      case "parking_id": case "slot_id": case "occupied": case "battery_mv": case "sent_at": case "sync_age_s": case "ts_ms": case "received_at":
+        break;
+      default:
+        return `${k}: not allowed`;
+    }
+  }
+  if (v["parking_id"] === undefined) return "parking_id: required";
+  if (typeof v["parking_id"] !== "string") return "parking_id: must be string";
+  if (v["parking_id"].length < 1) return "parking_id: must not be shorter than 1";
+  if (v["slot_id"] === undefined) return "slot_id: required";
+  if (typeof v["slot_id"] !== "string") return "slot_id: must be string";
+  if (v["slot_id"].length < 1) return "slot_id: must not be shorter than 1";
+  if (v["occupied"] === undefined) return "occupied: required";
+  if (typeof v["occupied"] !== "boolean") return "occupied: must be boolean";
+  if (v["battery_mv"] !== undefined) {
+    if (!Number.isInteger(v["battery_mv"])) return "battery_mv: must be integer";
+    if (v["battery_mv"] < 0) return "battery_mv: must be >= 0";
+  }
+  if (v["sent_at"] !== undefined) {
+    if (typeof v["sent_at"] !== "string") return "sent_at: must be string";
+    if (!isDateTime(v["sent_at"])) return "sent_at: must be a date-time";
+  }
+  if (v["sync_age_s"] !== undefined) {
+    if (!Number.isInteger(v["sync_age_s"])) return "sync_age_s: must be integer";
+    if (v["sync_age_s"] < 0) return "sync_age_s: must be >= 0";
+  }
+  if (v["ts_ms"] !== undefined) {
+    if (!Number.isInteger(v["ts_ms"])) return "ts_ms: must be integer";
+    if (v["ts_ms"] < 0) return "ts_ms: must be >= 0";
+  }
+  if (v["received_at"] !== undefined) {
+    if (typeof v["received_at"] !== "string") return "received_at: must be string";
+    if (!isDateTime(v["received_at"])) return "received_at: must be a date-time";
+  }
+  return null;
+}
+
+// RainEvent (kafka/schemas/rain-event.json)
+function validateRainEvent(v) {
+  if (typeof v !== "object" || v === null || Array.isArray(v)) return "not an object";
+  for (const k in v) {
+    switch (k) {
+      case "sensor_id": case "rain_pct": case "raw": case "sent_at": case "sync_age_s": case "ts_ms": case "received_at":
+        break;
+      default:
+        return `${k}: not allowed`;
+    }
+  }
+  if (v["sensor_id"] === undefined) return "sensor_id: required";
+  if (typeof v["sensor_id"] !== "string") return "sensor_id: must be string";
+  if (v["sensor_id"].length < 1) return "sensor_id: must not be shorter than 1";
+  if (v["rain_pct"] === undefined) return "rain_pct: required";
+  if (!Number.isInteger(v["rain_pct"])) return "rain_pct: must be integer";
+  if (v["rain_pct"] < 0) return "rain_pct: must be >= 0";
+  if (v["rain_pct"] > 100) return "rain_pct: must be <= 100";
+  if (v["raw"] !== undefined) {
+    if (!Number.isInteger(v["raw"])) return "raw: must be integer";
+    if (v["raw"] < 0) return "raw: must be >= 0";
+  }
+  if (v["sent_at"] !== undefined) {
+    if (typeof v["sent_at"] !== "string") return "sent_at: must be string";
+    if (!isDateTime(v["sent_at"])) return "sent_at: must be a date-time";
+  }
+  if (v["sync_age_s"] !== undefined) {
+    if (!Number.isInteger(v["sync_age_s"])) return "sync_age_s: must be integer";
+    if (v["sync_age_s"] < 0) return "sync_age_s: must be >= 0";
+  }
+  if (v["ts_ms"] !== undefined) {
+    if (!Number.isInteger(v["ts_ms"])) return "ts_ms: must be integer";
+    if (v["ts_ms"] < 0) return "ts_ms: must be >= 0";
+  }
+  if (v["received_at"] !== undefined) {
+    if (typeof v["received_at"] !== "string") return "received_at: must be string";
+    if (!isDateTime(v["received_at"])) return "received_at: must be a date-time";
+  }
+  return null;
+}
+
+module.exports = { validateMagneticRawEvent, validateRainEvent };
@@ -1,17 +1,25 @@
 const { Kafka } = require('kafkajs');
 const Redis = require('ioredis');
+const wire = require('@optipark/shared/wire');
+const { LatencyWindow, formatStats } = require('@optipark/shared/latency');
 
 // ----- Config via environment variables -----
 const KAFKA_BROKERS = process.env.KAFKA_BROKERS || 'kafka:9092';
 const KAFKA_GROUP_ID = process.env.KAFKA_GROUP_ID || 'parking-redis-writer';
 const REDIS_HOST = process.env.REDIS_HOST || 'redis';
 const REDIS_PORT = parseInt(process.env.REDIS_PORT || '6379', 10);
+// Sensor -> Redis latency percentiles, written to the hash latency:sensor_to_redis (0 = off)
+const LATENCY_REPORT_MS = parseInt(process.env.LATENCY_REPORT_MS || '60000', 10);
+const LATENCY_MAX_SYNC_AGE_S = parseInt(process.env.LATENCY_MAX_SYNC_AGE_S || '3600', 10);
+const LATENCY_KEY = 'latency:sensor_to_redis';
 
 // IMPORTANT: Choose the Kafka topics you want to consume.
+// EXTRA_PARKING_IDS (comma-separated) adds parking.<id> topics, e.g. the fleet simulator's.
 const topics = [
   'parking.nice_sophia.A',
   'parking.nice_sophia.B',
   'parking.nice_sophia.C',
+  ...(process.env.EXTRA_PARKING_IDS || '').split(',').map((p) => p.trim()).filter(Boolean).map((p) => `parking.${p}`),
   'rain.global',
 ];
 
@@ -34,6 +42,34 @@ const redis = new Redis({
   lazyConnect: true,
 });
 
+const latency = new LatencyWindow({ maxSyncAgeS: LATENCY_MAX_SYNC_AGE_S });
+
+// slot_id -> sent_at (ms) of the last event applied. Events from different
+// devices (or a backfill racing a live event) can reach Kafka out of order;
+// with synced clocks the older one is dropped instead of overwriting Redis.
+const lastSentMs = new Map();
+
+function isStale(slotId, sentAt) {
+  const ms = typeof sentAt === 'string' ? Date.parse(sentAt) : NaN;
+  if (!Number.isFinite(ms)) return false;
+  const last = lastSentMs.get(slotId);
+  if (last !== undefined && ms < last) return true;
+  lastSentMs.set(slotId, ms);
+  return false;
+}
+
+async function reportLatency() {
+  const s = latency.stats();
+  latency.reset();
+  if (!s) return;
+  console.log(`Sensor->Redis latency ${formatStats(s)}`);
+  try {
+    await redis.hset(LATENCY_KEY, { ...s, updated_at: new Date().toISOString() });
+  } catch (err) {
+    console.error('Failed to store latency stats:', err.message);
+  }
+}
+
 async function run() {
   console.log('Connecting to Redis...');
   await redis.connect();
@@ -55,22 +91,34 @@ async function run() {
   await consumer.subscribe({ topics, fromBeginning: false });
   console.log('Kafka consumer subscribed to topics:', topics);
 
+  if (LATENCY_REPORT_MS > 0) setInterval(reportLatency, LATENCY_REPORT_MS);
+
   await consumer.run({
     autoCommit: true,
     eachMessage: async ({ topic, message }) => {
       try {
-        const valueStr = message.value?.toString();
-        if (!valueStr) {
+        if (!message.value || message.value.length === 0) {
           console.warn('Received message without value, skipping');
           return;
         }
 
+        // Binary wire format v1 or JSON, told apart by the first byte
         let event;
-        try {
-          event = JSON.parse(valueStr);
-        } catch (err) {
-          console.error('Failed to parse JSON value:', valueStr);
-          return;
+        if (wire.isBinary(message.value)) {
+          const decoded = wire.decode(message.value);
+          if (!decoded) {
+            console.error('Failed to decode binary value:', message.value.toString('hex'));
+            return;
+          }
+          event = decoded.value;
+        } else {
+          const valueStr = message.value.toString();
+          try {
+            event = JSON.parse(valueStr);
+          } catch (err) {
+            console.error('Failed to parse JSON value:', valueStr);
+            return;
+          }
         }
 
         // -----------------------------
@@ -89,6 +137,7 @@ async function run() {
           const rain01 = rain_pct >= THRESHOLD ? 1 : 0;
 
           await redis.set('weather:rain', String(rain01));
+          latency.record(event);
           console.log(`Redis updated: weather:rain=${rain01} (rain_pct=${rain_pct}, sensor_id=${sensor_id})`);
           return;
         }
@@ -96,7 +145,7 @@ async function run() {
         // -----------------------------
         // Handle parking topics
         // -----------------------------
-        const { parking_id, slot_id, occupied, battery_mv, sent_at, received_at } = event;
+        const { parking_id, slot_id, occupied, battery_mv, sent_at, sync_age_s, received_at } = event;
 
         // Validate required schema fields
         if (!parking_id || !slot_id || typeof occupied !== 'boolean') {
@@ -104,6 +153,11 @@ async function run() {
           return;
         }
 
+        if (isStale(slot_id, sent_at)) {
+          console.warn(`Stale event for ${slot_id} (sent_at=${sent_at}), skipping`);
+          return;
+        }
+
         // Keep your redis key format: parking:<A|B|C>:free and spot:<slot>
         const shortParkingId = parking_id.includes('.') ? parking_id.split('.').pop() : parking_id;
 
@@ -130,9 +184,11 @@ async function run() {
 
         if (typeof battery_mv === 'number') hashFields.battery_mv = battery_mv.toString();
         if (sent_at) hashFields.sent_at = sent_at;
+        if (typeof sync_age_s === 'number') hashFields.sync_age_s = sync_age_s.toString();
         if (received_at) hashFields.received_at = received_at;
 
         await redis.hset(spotKey, hashFields);
+        latency.record(event);
 
         console.log(
           `Redis updated: topic=${topic} parking_id=${parking_id} short=${shortParkingId} slot_id=${slot_id} status=${status}`
@@ -0,0 +1,71 @@
+/**
+ * Sensor -> service latency from the device timestamp (`sent_at`, SNTP wall clock).
+ *
+ * Used by mqtt-kafka-bridge and parking-redis-writer (@optipark/shared).
+ *
+ * Only events whose clock was synced recently enough count: `sync_age_s`
+ * missing (older firmware, hand-written test messages) or above maxSyncAgeS
+ * means the device clock may have drifted by more than the latency itself.
+ */
+
+class LatencyWindow {
+  /**
+   * @param {object} [opts]
+   * @param {number} [opts.size]         samples kept, the oldest are overwritten
+   * @param {number} [opts.maxSyncAgeS]  older syncs are not trusted
+   */
+  constructor(opts = {}) {
+    this.size = opts.size || 2048;
+    this.maxSyncAgeS = opts.maxSyncAgeS ?? 3600;
+    this.reset();
+  }
+
+  reset() {
+    this.samples = [];
+    this.next = 0;
+    this.skipped = 0;
+  }
+
+  /**
+   * Record one event seen at nowMs. Returns its latency in ms, or null if it does not count.
+   */
+  record(ev, nowMs = Date.now()) {
+    const sentMs = typeof ev?.sent_at === "string" ? Date.parse(ev.sent_at) : NaN;
+    if (!Number.isFinite(sentMs)) return null;
+    if (typeof ev.sync_age_s !== "number" || ev.sync_age_s > this.maxSyncAgeS) {
+      this.skipped++;
+      return null;
+    }
+
+    const ms = nowMs - sentMs;
+    if (this.samples.length < this.size) this.samples.push(ms);
+    else this.samples[this.next] = ms;
+    this.next = (this.next + 1) % this.size;
+    return ms;
+  }
+
+  /**
+   * { n, skipped, p50_ms, p90_ms, p99_ms, max_ms } over the window, or null when empty.
+   * Negative values mean the device clock is ahead of this host.
+   */
+  stats() {
+    const n = this.samples.length;
+    if (n === 0) return null;
+    const sorted = [...this.samples].sort((a, b) => a - b);
+    const pct = (p) => sorted[Math.min(n - 1, Math.ceil((p / 100) * n) - 1)];
+    return {
+      n,
+      skipped: this.skipped,
+      p50_ms: pct(50),
+      p90_ms: pct(90),
+      p99_ms: pct(99),
+      max_ms: sorted[n - 1],
+    };
+  }
+}
+
+function formatStats(s) {
+  return `n=${s.n} p50=${s.p50_ms}ms p90=${s.p90_ms}ms p99=${s.p99_ms}ms max=${s.max_ms}ms (skipped ${s.skipped})`;
+}
+
+module.exports = { LatencyWindow, formatStats };
@@ -0,0 +1,217 @@
+/**
+ * OptiPark compact binary wire format (see kafka/schemas/wire-format-v2.md).
+ * Encodes v2; decodes v2 and the older v1 layout.
+ *
+ * Used by mqtt-kafka-bridge, parking-redis-writer, controle-reservation and
+ * fleet-sim through the local package @optipark/shared.
+ */
+
+const MARKER_V1 = 0xb1; // no sync age, delta without flags
+const MARKER_V2 = 0xb2;
+
+const TYPE_SPOT = 0x01;
+const TYPE_RAIN = 0x02;
+const TYPE_DELTA = 0x03;
+
+const SPOT_OCCUPIED = 0x01;
+const SPOT_HAS_BATTERY = 0x02;
+const SPOT_HAS_TS = 0x04;
+const SPOT_HAS_PARKING = 0x08;
+const SPOT_TS_EPOCH = 0x10;
+const SPOT_HAS_SYNC = 0x20;
+
+const RAIN_HAS_RAW = 0x01;
+const RAIN_HAS_TS = 0x02;
+const RAIN_TS_EPOCH = 0x04;
+const RAIN_HAS_SYNC = 0x08;
+
+const DELTA_HAS_TS = 0x01;
+const DELTA_TS_EPOCH = 0x02;
+const DELTA_HAS_SYNC = 0x04;
+
+const SYNC_UNKNOWN = 0xffff;
+
+/**
+ * True if the buffer holds a binary message (JSON always starts with '{').
+ */
+function isBinary(buf) {
+  return Buffer.isBuffer(buf) && buf.length >= 2 && (buf[0] & 0xf0) === 0xb0;
+}
+
+class Reader {
+  constructor(buf) {
+    this.buf = buf;
+    this.off = 0;
+  }
+  need(n) {
+    if (this.off + n > this.buf.length) throw new Error("truncated");
+  }
+  u8() {
+    this.need(1);
+    return this.buf[this.off++];
+  }
+  u16() {
+    this.need(2);
+    const v = this.buf.readUInt16LE(this.off);
+    this.off += 2;
+    return v;
+  }
+  u32() {
+    this.need(4);
+    const v = this.buf.readUInt32LE(this.off);
+    this.off += 4;
+    return v;
+  }
+  u64() {
+    this.need(8);
+    const v = this.buf.readBigUInt64LE(this.off);
+    this.off += 8;
+    return v;
+  }
+  str() {
+    const len = this.u8();
+    this.need(len);
+    const s = this.buf.toString("latin1", this.off, this.off + len);
+    this.off += len;
+    return s;
+  }
+}
+
+function putTimestamp(obj, ms, epoch) {
+  if (epoch) obj.sent_at = new Date(Number(ms)).toISOString();
+  else obj.ts_ms = Number(ms);
+}
+
+function putSyncAge(obj, age) {
+  if (age !== SYNC_UNKNOWN) obj.sync_age_s = age;
+}
+
+/**
+ * Decode a binary message into the same object shape as its JSON counterpart.
+ * Returns { type: "spot" | "rain" | "delta", value } or null if the buffer is not valid v1 / v2.
+ */
+function decode(buf) {
+  if (!isBinary(buf) || (buf[0] !== MARKER_V1 && buf[0] !== MARKER_V2)) return null;
+  const v2 = buf[0] === MARKER_V2;
+
+  try {
+    const r = new Reader(buf);
+    r.u8(); // marker
+    const type = r.u8();
+
+    if (type === TYPE_SPOT) {
+      const flags = r.u8();
+      const value = { slot_id: r.str() };
+      if (flags & SPOT_HAS_PARKING) value.parking_id = r.str();
+      value.occupied = (flags & SPOT_OCCUPIED) !== 0;
+      if (flags & SPOT_HAS_BATTERY) value.battery_mv = r.u16();
+      if (flags & SPOT_HAS_TS) putTimestamp(value, r.u64(), flags & SPOT_TS_EPOCH);
+      if (v2 && flags & SPOT_HAS_SYNC) putSyncAge(value, r.u16());
+      return { type: "spot", value };
+    }
+
+    if (type === TYPE_RAIN) {
+      const flags = r.u8();
+      const value = { sensor_id: r.str(), rain_pct: r.u8() };
+      if (flags & RAIN_HAS_RAW) value.raw = r.u16();
+      if (flags & RAIN_HAS_TS) putTimestamp(value, r.u64(), flags & RAIN_TS_EPOCH);
+      if (v2 && flags & RAIN_HAS_SYNC) putSyncAge(value, r.u16());
+      return { type: "rain", value };
+    }
+
+    if (type === TYPE_DELTA) {
+      // v1 has no flags byte and always an uptime timestamp
+      const flags = v2 ? r.u8() : DELTA_HAS_TS;
+      const seq = r.u32();
+      const occ = r.u64();
+      const chg = r.u64();
+      const value = { seq, occ: occ.toString(16), chg: chg.toString(16) };
+      if (flags & DELTA_HAS_TS) putTimestamp(value, r.u64(), flags & DELTA_TS_EPOCH);
+      if (flags & DELTA_HAS_SYNC) putSyncAge(value, r.u16());
+      return { type: "delta", value };
+    }
+  } catch {
+    return null;
+  }
+  return null;
+}
+
+function strBytes(s) {
+  const b = Buffer.from(String(s), "latin1");
+  if (b.length > 255) throw new Error("string too long for wire format");
+  return Buffer.concat([Buffer.from([b.length]), b]);
+}
+
+function u16(v) {
+  const b = Buffer.alloc(2);
+  b.writeUInt16LE(Math.max(0, Math.min(0xffff, v)));
+  return b;
+}
+
+function syncAge(v) {
+  return u16(Math.min(SYNC_UNKNOWN - 1, v));
+}
+
+function u64(v) {
+  const b = Buffer.alloc(8);
+  b.writeBigUInt64LE(BigInt(v));
+  return b;
+}
+
+/**
+ * Encode a MagneticRawEvent ({parking_id, slot_id, occupied, battery_mv?, sent_at? | ts_ms?, sync_age_s?}).
+ */
+function encodeSpot(ev) {
+  let flags = 0;
+  const parts = [];
+  if (ev.occupied) flags |= SPOT_OCCUPIED;
+  parts.push(strBytes(ev.slot_id));
+  if (typeof ev.parking_id === "string") {
+    flags |= SPOT_HAS_PARKING;
+    parts.push(strBytes(ev.parking_id));
+  }
+  if (typeof ev.battery_mv === "number") {
+    flags |= SPOT_HAS_BATTERY;
+    parts.push(u16(ev.battery_mv));
+  }
+  const sentMs = ev.sent_at ? Date.parse(ev.sent_at) : NaN;
+  if (Number.isFinite(sentMs)) {
+    flags |= SPOT_HAS_TS | SPOT_TS_EPOCH;
+    parts.push(u64(sentMs));
+    if (typeof ev.sync_age_s === "number") {
+      flags |= SPOT_HAS_SYNC;
+      parts.push(syncAge(ev.sync_age_s));
+    }
+  } else if (typeof ev.ts_ms === "number") {
+    flags |= SPOT_HAS_TS;
+    parts.push(u64(ev.ts_ms));
+  }
+  return Buffer.concat([Buffer.from([MARKER_V2, TYPE_SPOT, flags]), ...parts]);
+}
+
+/**
+ * Encode a RainEvent ({sensor_id, rain_pct, raw?, sent_at? | ts_ms?, sync_age_s?}).
+ */
+function encodeRain(ev) {
+  let flags = 0;
+  const parts = [strBytes(ev.sensor_id), Buffer.from([Math.max(0, Math.min(100, ev.rain_pct | 0))])];
+  if (typeof ev.raw === "number") {
+    flags |= RAIN_HAS_RAW;
+    parts.push(u16(ev.raw));
+  }
+  const sentMs = ev.sent_at ? Date.parse(ev.sent_at) : NaN;
+  if (Number.isFinite(sentMs)) {
+    flags |= RAIN_HAS_TS | RAIN_TS_EPOCH;
+    parts.push(u64(sentMs));
+    if (typeof ev.sync_age_s === "number") {
+      flags |= RAIN_HAS_SYNC;
+      parts.push(syncAge(ev.sync_age_s));
+    }
+  } else if (typeof ev.ts_ms === "number") {
+    flags |= RAIN_HAS_TS;
+    parts.push(u64(ev.ts_ms));
+  }
+  return Buffer.concat([Buffer.from([MARKER_V2, TYPE_RAIN, flags]), ...parts]);
+}
+
+module.exports = { isBinary, decode, encodeSpot, encodeRain };